@@ -0,0 +1,247 @@
+#include "accountSnapshot.h"
+#include "metrics.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+namespace {
+
+const uint32_t SNAPSHOT_MAGIC = 0x50414E53; // "SNAP"
+const uint32_t SNAPSHOT_VERSION = 1;
+const char SNAPSHOT_SUFFIX[] = ".snap";
+
+struct SnapshotHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t height;
+    Digest blockID;
+    uint64_t accountCount;
+    uint64_t bodyLength;
+    uint64_t checksum;
+};
+
+// FNV-1a, as used by the block store records
+uint64_t checksum(const uint8_t* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void appendBytes(std::vector<uint8_t>& out, const void* data, size_t length) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    out.insert(out.end(), bytes, bytes + length);
+}
+
+} // namespace
+
+AccountSnapshots::AccountSnapshots(const std::string& prefix, size_t interval, size_t keep)
+    : prefix(prefix), interval(interval), keep(keep > 0 ? keep : 1), hasPending(false), running(false), written(0) {}
+
+AccountSnapshots::~AccountSnapshots() {
+    stop();
+}
+
+void AccountSnapshots::start() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (running) {
+        return;
+    }
+    running = true;
+    worker = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [this] { return hasPending || !running; });
+            if (!hasPending) {
+                break; // Stopped with nothing left to write
+            }
+            Job job = std::move(pending);
+            hasPending = false;
+            lock.unlock();
+            bool ok = write(job);
+            if (ok) {
+                prune();
+            }
+            lock.lock();
+            written += ok;
+        }
+    });
+}
+
+void AccountSnapshots::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    worker.join();
+}
+
+void AccountSnapshots::submit(uint64_t height, const Digest& blockID, const AccountState& accounts,
+                              std::vector<int64_t> balances) {
+    Job job;
+    job.info.height = height;
+    job.info.blockID = blockID;
+    job.publicKeys.reserve(accounts.size());
+    job.names.reserve(accounts.size());
+    for (size_t account = 0; account < accounts.size(); ++account) {
+        job.publicKeys.push_back(accounts.getPublicKey(account));
+        job.names.push_back(accounts.getName(account));
+    }
+    job.balances = std::move(balances);
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = std::move(job); // A snapshot still waiting is superseded by this newer one
+    hasPending = true;
+    wake.notify_one();
+}
+
+size_t AccountSnapshots::writtenCount() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return written;
+}
+
+std::string AccountSnapshots::pathFor(uint64_t height) const {
+    return prefix + "." + std::to_string(height) + SNAPSHOT_SUFFIX;
+}
+
+std::vector<uint64_t> AccountSnapshots::listHeights() const {
+    namespace fs = std::filesystem;
+    fs::path base(prefix);
+    fs::path directory = base.has_parent_path() ? base.parent_path() : fs::path(".");
+    std::string stem = base.filename().string() + ".";
+    std::string suffix = SNAPSHOT_SUFFIX;
+
+    std::vector<uint64_t> heights;
+    std::error_code error;
+    for (fs::directory_iterator it(directory, error), end; !error && it != end; it.increment(error)) {
+        std::string name = it->path().filename().string();
+        if (name.size() <= stem.size() + suffix.size() || name.compare(0, stem.size(), stem) != 0 ||
+            name.compare(name.size() - suffix.size(), suffix.size(), suffix) != 0) {
+            continue;
+        }
+        std::string digits = name.substr(stem.size(), name.size() - stem.size() - suffix.size());
+        if (digits.find_first_not_of("0123456789") == std::string::npos) {
+            heights.push_back(std::stoull(digits));
+        }
+    }
+    std::sort(heights.rbegin(), heights.rend());
+    return heights;
+}
+
+bool AccountSnapshots::write(const Job& job) const {
+    static Metrics::Histogram& latency = Metrics::instance().histogram(
+        "account_snapshot_seconds", "Time to encode and write one account snapshot", Metrics::latencyBuckets());
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<uint8_t> body;
+    body.reserve(job.balances.size() * (sizeof(Digest) + sizeof(int64_t) + sizeof(uint32_t) + 8));
+    for (size_t account = 0; account < job.balances.size(); ++account) {
+        uint32_t nameLength = static_cast<uint32_t>(job.names[account].size());
+        appendBytes(body, job.publicKeys[account].bytes.data(), sizeof(Digest));
+        appendBytes(body, &job.balances[account], sizeof(int64_t));
+        appendBytes(body, &nameLength, sizeof(nameLength));
+        appendBytes(body, job.names[account].data(), nameLength);
+    }
+
+    SnapshotHeader header;
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.height = job.info.height;
+    header.blockID = job.info.blockID;
+    header.accountCount = job.balances.size();
+    header.bodyLength = body.size();
+    header.checksum = checksum(body.data(), body.size());
+
+    std::string path = pathFor(job.info.height);
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(body.data()), static_cast<std::streamsize>(body.size()));
+        if (!out) {
+            std::remove(temporary.c_str());
+            return false;
+        }
+    }
+    bool renamed = std::rename(temporary.c_str(), path.c_str()) == 0;
+    latency.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return renamed;
+}
+
+bool AccountSnapshots::read(const std::string& path, AccountState& accounts, Info& info) const {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    uint64_t bytes = in ? static_cast<uint64_t>(in.tellg()) : 0;
+    in.seekg(0);
+    SnapshotHeader header;
+    if (bytes < sizeof(header) || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION ||
+        header.bodyLength != bytes - sizeof(header) ||
+        header.accountCount > header.bodyLength / (sizeof(Digest) + sizeof(int64_t) + sizeof(uint32_t))) {
+        return false;
+    }
+    std::vector<uint8_t> body(static_cast<size_t>(header.bodyLength));
+    if (!in.read(reinterpret_cast<char*>(body.data()), static_cast<std::streamsize>(body.size())) ||
+        checksum(body.data(), body.size()) != header.checksum) {
+        return false;
+    }
+
+    AccountState loaded(static_cast<size_t>(header.accountCount));
+    size_t offset = 0;
+    for (uint64_t account = 0; account < header.accountCount; ++account) {
+        Digest publicKey;
+        int64_t balance;
+        uint32_t nameLength;
+        if (body.size() - offset < sizeof(Digest) + sizeof(balance) + sizeof(nameLength)) {
+            return false;
+        }
+        std::memcpy(publicKey.bytes.data(), &body[offset], sizeof(Digest));
+        std::memcpy(&balance, &body[offset + sizeof(Digest)], sizeof(balance));
+        std::memcpy(&nameLength, &body[offset + sizeof(Digest) + sizeof(balance)], sizeof(nameLength));
+        offset += sizeof(Digest) + sizeof(balance) + sizeof(nameLength);
+        if (body.size() - offset < nameLength) {
+            return false;
+        }
+        loaded.addAccount(std::string(reinterpret_cast<const char*>(&body[offset]), nameLength), publicKey, balance);
+        offset += nameLength;
+    }
+    if (offset != body.size()) {
+        return false;
+    }
+    accounts = std::move(loaded);
+    info.height = header.height;
+    info.blockID = header.blockID;
+    return true;
+}
+
+bool AccountSnapshots::loadLatest(const BlockStore& store, AccountState& accounts, Info& info) const {
+    for (uint64_t height : listHeights()) {
+        if (height >= store.size()) {
+            continue; // Written for blocks the store no longer has
+        }
+        AccountState loaded;
+        Info candidate;
+        if (read(pathFor(height), loaded, candidate) && candidate.height == height &&
+            store.view(height).header().blockID == candidate.blockID) {
+            accounts = std::move(loaded);
+            info = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AccountSnapshots::prune() const {
+    std::vector<uint64_t> heights = listHeights();
+    for (size_t i = keep; i < heights.size(); ++i) {
+        std::remove(pathFor(heights[i]).c_str());
+    }
+}
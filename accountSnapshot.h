@@ -0,0 +1,80 @@
+#ifndef ACCOUNTSNAPSHOT_H
+#define ACCOUNTSNAPSHOT_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "digest.h"
+#include "accountState.h"
+#include "blockStore.h"
+
+// Periodic binary snapshots of the account state, so a restart only replays the blocks
+// mined after the newest snapshot instead of the whole chain.
+//
+// A snapshot is one file "<prefix>.<height>.snap": a header with the block height and ID
+// it belongs to, the account count and an FNV-1a checksum of the body, then every
+// account in account order as [public key][i64 balance][u32 name length][name]. Files are
+// written aside and renamed into place, and only the newest `keep` are left on disk.
+//
+// submit() only hands the state to a background writer and returns; if the writer is
+// still busy with an earlier snapshot, a newer pending one replaces the older, so the
+// caller never waits on disk. A snapshot is only loaded when its checksum holds and the
+// store still has its block at that height.
+class AccountSnapshots {
+public:
+    struct Info {
+        uint64_t height = 0;
+        Digest blockID;
+    };
+
+    AccountSnapshots(const std::string& prefix, size_t interval, size_t keep = 2);
+    ~AccountSnapshots();
+
+    AccountSnapshots(const AccountSnapshots&) = delete;
+    AccountSnapshots& operator=(const AccountSnapshots&) = delete;
+
+    void start();
+    void stop(); // Writes whatever is still pending
+
+    // True every `interval` blocks
+    bool due(uint64_t height) const { return interval > 0 && height > 0 && height % interval == 0; }
+
+    // Queues the state as of block `height`. Keys and names are copied from `accounts`,
+    // balances are taken over from `balances` (e.g. a copy made when the block was built).
+    void submit(uint64_t height, const Digest& blockID, const AccountState& accounts, std::vector<int64_t> balances);
+
+    // Newest usable snapshot for `store`; false if there is none
+    bool loadLatest(const BlockStore& store, AccountState& accounts, Info& info) const;
+
+    size_t writtenCount() const;
+
+private:
+    struct Job {
+        Info info;
+        std::vector<Digest> publicKeys;
+        std::vector<std::string> names;
+        std::vector<int64_t> balances;
+    };
+
+    std::string prefix;
+    size_t interval;
+    size_t keep;
+    std::thread worker;
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    Job pending;
+    bool hasPending;
+    bool running;
+    size_t written;
+
+    std::string pathFor(uint64_t height) const;
+    std::vector<uint64_t> listHeights() const; // Newest first
+    bool write(const Job& job) const;
+    bool read(const std::string& path, AccountState& accounts, Info& info) const;
+    void prune() const;
+};
+
+#endif // ACCOUNTSNAPSHOT_H
@@ -0,0 +1,121 @@
+#include "accountState.h"
+
+namespace {
+
+const size_t MIN_SLOTS = 16;
+
+size_t slotCountFor(size_t accounts) {
+    size_t slots = MIN_SLOTS;
+    while (slots < accounts * 2) {
+        slots *= 2;
+    }
+    return slots;
+}
+
+} // namespace
+
+AccountState::AccountState(size_t expectedAccounts)
+    : keySlots(slotCountFor(expectedAccounts)), nameSlots(slotCountFor(expectedAccounts)) {
+    balances.reserve(expectedAccounts);
+    publicKeys.reserve(expectedAccounts);
+    names.reserve(expectedAccounts);
+}
+
+AccountState AccountState::fromUsers(const std::vector<User>& users) {
+    AccountState state(users.size());
+    for (const auto& user : users) {
+        state.addAccount(user.getName(), user.getPublicKey(), user.getBalance());
+    }
+    return state;
+}
+
+uint64_t AccountState::hashKey(const Digest& publicKey) {
+    return DigestHasher()(publicKey);
+}
+
+// FNV-1a
+uint64_t AccountState::hashName(const std::string& name) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char c : name) {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+void AccountState::insertSlot(std::vector<Slot>& slots, uint64_t hash, uint32_t account) {
+    size_t mask = slots.size() - 1;
+    size_t index = hash & mask;
+    while (slots[index].account != 0) {
+        index = (index + 1) & mask;
+    }
+    slots[index].fingerprint = static_cast<uint32_t>(hash >> 32);
+    slots[index].account = account + 1;
+}
+
+void AccountState::grow() {
+    size_t slotCount = keySlots.size() * 2;
+    keySlots.assign(slotCount, Slot());
+    nameSlots.assign(slotCount, Slot());
+    for (size_t account = 0; account < balances.size(); ++account) {
+        insertSlot(keySlots, hashKey(publicKeys[account]), account);
+        insertSlot(nameSlots, hashName(names[account]), account);
+    }
+}
+
+int64_t AccountState::addAccount(const std::string& name, const Digest& publicKey, int64_t balance) {
+    int64_t existing = findAccount(publicKey);
+    if (existing != NOT_FOUND) {
+        return existing;
+    }
+    if ((balances.size() + 1) * 2 > keySlots.size()) {
+        grow();
+    }
+
+    uint32_t account = static_cast<uint32_t>(balances.size());
+    balances.push_back(balance);
+    publicKeys.push_back(publicKey);
+    names.push_back(name);
+    insertSlot(keySlots, hashKey(publicKey), account);
+    insertSlot(nameSlots, hashName(name), account);
+    return account;
+}
+
+int64_t AccountState::findAccount(const Digest& publicKey) const {
+    uint64_t hash = hashKey(publicKey);
+    uint32_t fingerprint = static_cast<uint32_t>(hash >> 32);
+    size_t mask = keySlots.size() - 1;
+    for (size_t index = hash & mask; keySlots[index].account != 0; index = (index + 1) & mask) {
+        const Slot& slot = keySlots[index];
+        if (slot.fingerprint == fingerprint && publicKeys[slot.account - 1] == publicKey) {
+            return slot.account - 1;
+        }
+    }
+    return NOT_FOUND;
+}
+
+int64_t AccountState::findAccountByName(const std::string& name) const {
+    uint64_t hash = hashName(name);
+    uint32_t fingerprint = static_cast<uint32_t>(hash >> 32);
+    size_t mask = nameSlots.size() - 1;
+    for (size_t index = hash & mask; nameSlots[index].account != 0; index = (index + 1) & mask) {
+        const Slot& slot = nameSlots[index];
+        if (slot.fingerprint == fingerprint && names[slot.account - 1] == name) {
+            return slot.account - 1;
+        }
+    }
+    return NOT_FOUND;
+}
+
+void AccountState::writeBalancesTo(std::vector<User>& users) const {
+    writeBalancesTo(users, balances);
+}
+
+void AccountState::writeBalancesTo(std::vector<User>& users, const std::vector<int64_t>& balanceSnapshot) const {
+    for (auto& user : users) {
+        int64_t account = findAccount(user.getPublicKey());
+        if (account != NOT_FOUND) {
+            user.updateBalance(balanceSnapshot[account] - user.getBalance());
+        }
+    }
+}
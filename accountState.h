@@ -0,0 +1,68 @@
+#ifndef ACCOUNTSTATE_H
+#define ACCOUNTSTATE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "digest.h"
+#include "user.h"
+
+// Account balances keyed by the binary public key.
+//
+// Accounts live in dense columns (balances, keys, names) indexed by account number, and
+// two open-addressing tables with linear probing map a public key or a user name to that
+// number. Each slot is 8 bytes: a 32-bit fingerprint of the key and the account number,
+// so a probe only reads the slot array until the fingerprint matches. Tables are kept at
+// most half full and doubled when they would pass that.
+//
+// Memory per account: 8 (balance) + 32 (public key) + 32 (std::string name, short names
+// stay inline) + 2 tables * 8 bytes * 2..4 slots = about 104-136 bytes, i.e. roughly
+// 130 MB for a million accounts.
+class AccountState {
+public:
+    static const int64_t NOT_FOUND = -1;
+
+    explicit AccountState(size_t expectedAccounts = 0);
+    static AccountState fromUsers(const std::vector<User>& users);
+
+    // Returns the account number, or the existing one if the key is already known
+    int64_t addAccount(const std::string& name, const Digest& publicKey, int64_t balance);
+
+    int64_t findAccount(const Digest& publicKey) const;
+    int64_t findAccountByName(const std::string& name) const;
+
+    int64_t getBalance(size_t account) const { return balances[account]; }
+    void updateBalance(size_t account, int64_t amount) { balances[account] += amount; }
+    const Digest& getPublicKey(size_t account) const { return publicKeys[account]; }
+    const std::string& getName(size_t account) const { return names[account]; }
+    size_t size() const { return balances.size(); }
+
+    const std::vector<int64_t>& getBalances() const { return balances; }
+    // Same public keys in the same account order (balances may differ)
+    bool sameAccounts(const AccountState& other) const { return publicKeys == other.publicKeys; }
+
+    // Copies balances back into the User list (matched by public key)
+    void writeBalancesTo(std::vector<User>& users) const;
+    // Same from a copy of getBalances() taken earlier; only reads the key table, so it may
+    // run while another thread keeps updating balances
+    void writeBalancesTo(std::vector<User>& users, const std::vector<int64_t>& balanceSnapshot) const;
+
+private:
+    struct Slot {
+        uint32_t fingerprint;
+        uint32_t account; // Account number + 1, 0 marks an empty slot
+    };
+
+    std::vector<int64_t> balances;
+    std::vector<Digest> publicKeys;
+    std::vector<std::string> names;
+    std::vector<Slot> keySlots;
+    std::vector<Slot> nameSlots;
+
+    static uint64_t hashKey(const Digest& publicKey);
+    static uint64_t hashName(const std::string& name);
+    static void insertSlot(std::vector<Slot>& slots, uint64_t hash, uint32_t account);
+    void grow();
+};
+
+#endif // ACCOUNTSTATE_H
@@ -0,0 +1,287 @@
+#include "addressIndex.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+// A filter record: [u32 probes][u32 keys][u64 bit words...]
+struct FilterHeader {
+    uint32_t probes;
+    uint32_t keys;
+};
+
+} // namespace
+
+// Blocks one catchUp() has indexed that are not in the runs yet
+struct AddressIndex::Batch {
+    size_t firstHeight;
+    std::vector<std::vector<uint8_t>> filters;
+    std::vector<IndexEntry> entries;
+    std::unordered_map<Digest, size_t, DigestHasher> counts; // Cold transactions per address
+    std::unordered_set<Digest, DigestHasher> hot;            // Promoted
+
+    const uint8_t* filter(const IndexRuns::View& indexed, size_t height, size_t& bytes) const {
+        if (height < firstHeight) {
+            return indexed.record(height, bytes);
+        }
+        bytes = filters[height - firstHeight].size();
+        return filters[height - firstHeight].data();
+    }
+};
+
+AddressIndex::AddressIndex(double falsePositiveRate, size_t hotThreshold)
+    : falsePositiveRate(std::min(std::max(falsePositiveRate, 1e-9), 0.5)), hotThreshold(hotThreshold),
+      queries(0), scannedTotal(0), falsePositiveTotal(0), negativeTotal(0) {}
+
+// Two independent 64-bit hashes of the key; probe i is h1 + i * h2
+void AddressIndex::probePair(const Digest& key, uint64_t& h1, uint64_t& h2) {
+    h1 = static_cast<uint64_t>(DigestHasher()(key));
+    h2 = DigestHasher::mix(h1 ^ 0x9E3779B97F4A7C15ULL) | 1;
+}
+
+std::vector<uint8_t> AddressIndex::buildFilter(const std::vector<Digest>& keys) const {
+    FilterHeader header;
+    header.keys = static_cast<uint32_t>(keys.size());
+    double n = std::max<double>(1.0, static_cast<double>(keys.size()));
+    double ln2 = std::log(2.0);
+    size_t bitCount = static_cast<size_t>(std::ceil(-n * std::log(falsePositiveRate) / (ln2 * ln2)));
+    size_t words = std::max<size_t>(1, (bitCount + 63) / 64);
+    std::vector<uint64_t> bits(words, 0);
+    double optimalProbes = static_cast<double>(words * 64) / n * ln2;
+    header.probes = static_cast<uint32_t>(std::min(16.0, std::max(1.0, std::round(optimalProbes))));
+
+    uint64_t size = words * 64;
+    for (const Digest& key : keys) {
+        uint64_t h1, h2;
+        probePair(key, h1, h2);
+        for (uint32_t i = 0; i < header.probes; ++i) {
+            uint64_t bit = (h1 + i * h2) % size;
+            bits[bit / 64] |= 1ULL << (bit % 64);
+        }
+    }
+    std::vector<uint8_t> filter(sizeof(header) + words * sizeof(uint64_t));
+    std::memcpy(filter.data(), &header, sizeof(header));
+    std::memcpy(filter.data() + sizeof(header), bits.data(), words * sizeof(uint64_t));
+    return filter;
+}
+
+// A missing or damaged filter lets everything through, so it never hides a transaction
+bool AddressIndex::mayContain(const uint8_t* filter, size_t bytes, const Digest& address) {
+    if (filter == nullptr || bytes < sizeof(FilterHeader) + sizeof(uint64_t)) {
+        return true;
+    }
+    FilterHeader header;
+    std::memcpy(&header, filter, sizeof(header));
+    const uint64_t* bits = reinterpret_cast<const uint64_t*>(filter + sizeof(header));
+    uint64_t size = (bytes - sizeof(header)) / sizeof(uint64_t) * 64;
+    uint64_t h1, h2;
+    probePair(address, h1, h2);
+    for (uint32_t i = 0; i < header.probes; ++i) {
+        uint64_t bit = (h1 + i * h2) % size;
+        if (!(bits[bit / 64] & (1ULL << (bit % 64)))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Filters and promotions depend on the rate and threshold, so they are part of the tag
+uint64_t AddressIndex::runsTag() const {
+    uint64_t rateBits;
+    std::memcpy(&rateBits, &falsePositiveRate, sizeof(rateBits));
+    return DigestHasher::mix(rateBits ^ DigestHasher::mix(static_cast<uint64_t>(hotThreshold) + RUNS_VERSION));
+}
+
+bool AddressIndex::open(const std::string& path, const BlockStore& store) {
+    BlockSource blocks = [&store](size_t height) { return store.view(height); };
+    if (runs.open(path, runsTag())) {
+        // The runs describe a prefix of this store if their last block is in it
+        std::shared_ptr<const IndexRuns::View> opened = runs.view();
+        size_t indexed = opened->blockCount();
+        if (indexed <= store.size() && (indexed == 0 || store.view(indexed - 1).header().blockID == opened->tip())) {
+            return catchUp(blocks, store.size());
+        }
+    }
+    runs.clear();
+    return catchUp(blocks, store.size());
+}
+
+bool AddressIndex::catchUp(const BlockSource& blocks, size_t endHeight) {
+    std::shared_ptr<const IndexRuns::View> indexed = runs.view();
+    if (endHeight <= indexed->blockCount()) {
+        return true;
+    }
+    Batch batch;
+    batch.firstHeight = indexed->blockCount();
+    for (size_t height = batch.firstHeight; height < endHeight; ++height) {
+        addBlock(blocks, height, *indexed, batch);
+    }
+    return runs.add(batch.entries, &batch.filters, endHeight, blocks(endHeight - 1).header().blockID);
+}
+
+void AddressIndex::addBlock(const BlockSource& blocks, size_t height, const IndexRuns::View& indexed,
+                            Batch& batch) const {
+    BlockView block = blocks(height);
+    std::vector<Digest> keys;
+    keys.reserve(block.transactionCount() * 2);
+    std::vector<std::pair<Digest, uint32_t>> touched; // (party, position), a self-transfer counted once
+    touched.reserve(block.transactionCount() * 2);
+    for (size_t i = 0; i < block.transactionCount(); ++i) {
+        const Digest& sender = block.transaction(i).sender;
+        const Digest& receiver = block.transaction(i).receiver;
+        keys.push_back(sender);
+        touched.emplace_back(sender, static_cast<uint32_t>(i));
+        if (receiver != sender) {
+            keys.push_back(receiver);
+            touched.emplace_back(receiver, static_cast<uint32_t>(i));
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    batch.filters.push_back(buildFilter(keys));
+
+    if (hotThreshold == 0) {
+        return;
+    }
+    uint32_t blockHeight = static_cast<uint32_t>(height);
+    std::sort(touched.begin(), touched.end());
+    for (size_t first = 0, end = 0; first < touched.size(); first = end) {
+        const Digest& address = touched[first].first;
+        for (end = first; end < touched.size() && touched[end].first == address; ++end) {
+        }
+        IndexEntry found;
+        if (batch.hot.count(address) > 0 || indexed.findFirst(HOT, address, found)) {
+            for (size_t i = first; i < end; ++i) {
+                batch.entries.push_back(IndexRuns::makeEntry(address, POSTING, blockHeight, touched[i].second));
+            }
+            continue;
+        }
+
+        std::vector<IndexEntry> counts;
+        indexed.findAll(COUNT, address, counts);
+        size_t total = end - first;
+        for (const IndexEntry& count : counts) {
+            total += count.position;
+        }
+        auto pending = batch.counts.find(address);
+        if (pending != batch.counts.end()) {
+            total += pending->second;
+        }
+        if (total < hotThreshold) {
+            batch.counts[address] += end - first;
+            batch.entries.push_back(IndexRuns::makeEntry(address, COUNT, blockHeight, static_cast<uint32_t>(end - first)));
+            continue;
+        }
+
+        // One filtered pass over the chain so far (this block included), exact from here on
+        std::vector<TransactionRef> refs;
+        QueryStats ignored;
+        scanBlocks(address, blocks, height + 1, indexed, &batch, refs, ignored);
+        batch.entries.push_back(IndexRuns::makeEntry(address, HOT, blockHeight, 0));
+        for (const TransactionRef& ref : refs) {
+            batch.entries.push_back(IndexRuns::makeEntry(address, POSTING, ref.height, ref.position));
+        }
+        batch.hot.insert(address);
+        batch.counts.erase(address);
+    }
+}
+
+void AddressIndex::scanBlocks(const Digest& address, const BlockSource& blockAt, size_t endHeight,
+                              const IndexRuns::View& indexed, const Batch* batch, std::vector<TransactionRef>& out,
+                              QueryStats& queryStats) {
+    for (size_t height = 0; height < endHeight; ++height) {
+        size_t bytes;
+        const uint8_t* filter = batch != nullptr ? batch->filter(indexed, height, bytes) : indexed.record(height, bytes);
+        if (!mayContain(filter, bytes, address)) {
+            continue;
+        }
+        queryStats.blocksScanned++;
+        size_t before = out.size();
+        BlockView block = blockAt(height);
+        for (size_t i = 0; i < block.transactionCount(); ++i) {
+            if (block.transaction(i).sender == address || block.transaction(i).receiver == address) {
+                out.push_back(TransactionRef{static_cast<uint32_t>(height), static_cast<uint32_t>(i)});
+            }
+        }
+        if (out.size() == before) {
+            queryStats.falsePositives++;
+        }
+    }
+}
+
+AddressIndex::View AddressIndex::view() const {
+    View current;
+    current.runs = runs.view();
+    current.index = this;
+    return current;
+}
+
+std::vector<AddressIndex::TransactionRef> AddressIndex::View::history(const Digest& address, size_t endHeight,
+                                                                      const BlockSource& blockAt,
+                                                                      QueryStats* queryStats) const {
+    QueryStats local;
+    std::vector<TransactionRef> refs;
+    if (!runs) {
+        return refs;
+    }
+    endHeight = std::min(endHeight, runs->blockCount());
+    IndexEntry found;
+    if (runs->findFirst(HOT, address, found)) {
+        // Postings come in chain order and may run past the caller's view of the chain
+        local.fromPostings = true;
+        std::vector<IndexEntry> postings;
+        runs->findAll(POSTING, address, postings);
+        for (const IndexEntry& posting : postings) {
+            if (posting.height >= endHeight) {
+                break;
+            }
+            refs.push_back(TransactionRef{posting.height, posting.position});
+        }
+    } else {
+        scanBlocks(address, blockAt, endHeight, *runs, nullptr, refs, local);
+        index->negativeTotal += endHeight - (local.blocksScanned - local.falsePositives);
+    }
+    index->queries++;
+    index->scannedTotal += local.blocksScanned;
+    index->falsePositiveTotal += local.falsePositives;
+    if (queryStats != nullptr) {
+        *queryStats = local;
+    }
+    return refs;
+}
+
+AddressIndex::Stats AddressIndex::stats() const {
+    std::shared_ptr<const IndexRuns::View> indexed = runs.view();
+    Stats result;
+    result.blocks = indexed->blockCount();
+    result.filterBytes = indexed->recordBytes();
+    result.targetFalsePositiveRate = falsePositiveRate;
+    for (size_t height = 0; height < result.blocks; ++height) {
+        size_t bytes;
+        const uint8_t* filter = indexed->record(height, bytes);
+        if (filter == nullptr || bytes < sizeof(FilterHeader) + sizeof(uint64_t)) {
+            continue;
+        }
+        FilterHeader header;
+        std::memcpy(&header, filter, sizeof(header));
+        double m = static_cast<double>((bytes - sizeof(header)) / sizeof(uint64_t) * 64);
+        double k = header.probes;
+        result.expectedFalsePositiveRate += std::pow(1.0 - std::exp(-k * header.keys / m), k);
+    }
+    if (result.blocks > 0) {
+        result.expectedFalsePositiveRate /= static_cast<double>(result.blocks);
+    }
+    result.hotAddresses = indexed->count(HOT);
+    result.postingsBytes = indexed->count(POSTING) * sizeof(IndexEntry);
+    result.queries = queries.load();
+    result.blocksScanned = scannedTotal.load();
+    result.falsePositives = falsePositiveTotal.load();
+    size_t negatives = negativeTotal.load();
+    if (negatives > 0) {
+        result.observedFalsePositiveRate = static_cast<double>(result.falsePositives) / static_cast<double>(negatives);
+    }
+    return result;
+}
@@ -0,0 +1,126 @@
+#ifndef ADDRESSINDEX_H
+#define ADDRESSINDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "digest.h"
+#include "blockStore.h"
+#include "indexRuns.h"
+
+// Per-address transaction history.
+//
+// Every block gets a Bloom filter over the sender and receiver keys of its transactions,
+// sized for the configured false-positive rate (m = -n ln p / ln^2 2 bits, k = m/n ln 2
+// probes, double hashing). A history query only opens blocks whose filter says "maybe".
+// Addresses that reach `hotThreshold` transactions are promoted to an exact postings
+// list of (height, position), backfilled once through the filters and then extended
+// directly, so busy addresses never touch the filters again. A threshold of 0 disables
+// postings.
+//
+// Filters, per-block transaction counts of cold addresses, promotions and postings are
+// kept in IndexRuns, the filters as per-block records. catchUp() adds one run for all the
+// blocks it indexes and publishes a new View; queries run on a View, so any number of
+// threads query while one thread adds blocks, without locks. Blocks are read through a
+// BlockSource, the writer's (e.g. the store) when indexing and the caller's (e.g. a
+// ChainSnapshot) when querying. An index opened at a path is persisted next to the
+// store, so a restart indexes only the blocks stored since; without open() it is kept
+// in memory.
+class AddressIndex {
+public:
+    struct TransactionRef {
+        uint32_t height;
+        uint32_t position;
+    };
+
+    struct QueryStats {
+        size_t blocksScanned = 0;
+        size_t falsePositives = 0; // Blocks the filter let through without a match
+        bool fromPostings = false;
+    };
+
+    struct Stats {
+        size_t blocks = 0;
+        size_t filterBytes = 0;
+        size_t postingsBytes = 0;
+        size_t hotAddresses = 0;
+        double targetFalsePositiveRate = 0;
+        double expectedFalsePositiveRate = 0; // Mean of the per-block theoretical rates
+        size_t queries = 0;
+        size_t blocksScanned = 0;
+        size_t falsePositives = 0;
+        double observedFalsePositiveRate = 0; // False positives per queried block without a match
+    };
+
+    // The index as of one catchUp(); cheap to copy, and valid as long as its AddressIndex
+    class View {
+    public:
+        size_t blockCount() const { return runs ? runs->blockCount() : 0; }
+
+        // Transactions of `address` in blocks below endHeight, in chain order; blockAt must
+        // serve every one of those blocks
+        std::vector<TransactionRef> history(const Digest& address, size_t endHeight, const BlockSource& blockAt,
+                                            QueryStats* queryStats = nullptr) const;
+
+    private:
+        std::shared_ptr<const IndexRuns::View> runs;
+        const AddressIndex* index = nullptr; // Keeps the query totals
+
+        friend class AddressIndex;
+    };
+
+    explicit AddressIndex(double falsePositiveRate = 0.01, size_t hotThreshold = 64);
+
+    // Opens the index persisted at `path` and indexes what `store` holds beyond it; one
+    // written with another rate or threshold, or for another chain, is rebuilt. False if
+    // it cannot be written, in which case it is kept in memory.
+    bool open(const std::string& path, const BlockStore& store);
+    // Indexes blocks [blockCount(), endHeight), read in chain order through `blocks`;
+    // false if the index could not be written
+    bool catchUp(const BlockSource& blocks, size_t endHeight);
+    // Stops writing the index files; queries keep working on what was indexed
+    void close() { runs.close(); }
+    // Syncing the runs (the default) keeps a crash from costing a rebuild
+    void setSyncWrites(bool sync) { runs.setSyncWrites(sync); }
+
+    View view() const;
+    // History in the newest view
+    std::vector<TransactionRef> history(const Digest& address, size_t endHeight, const BlockSource& blockAt,
+                                        QueryStats* queryStats = nullptr) const {
+        return view().history(address, endHeight, blockAt, queryStats);
+    }
+
+    size_t blockCount() const { return runs.blockCount(); }
+    Stats stats() const;
+
+private:
+    // COUNT: a cold address's transactions in one block (as the position), HOT: promoted
+    // at that height, POSTING: one transaction of a hot address
+    enum Kind : uint32_t { COUNT = 0, HOT = 1, POSTING = 2 };
+
+    struct Batch;
+
+    static const uint64_t RUNS_VERSION = 1; // Changes whenever the entries or filters change meaning
+
+    double falsePositiveRate;
+    size_t hotThreshold;
+    IndexRuns runs;
+    // Query totals, bumped by concurrent readers
+    mutable std::atomic<size_t> queries;
+    mutable std::atomic<size_t> scannedTotal;
+    mutable std::atomic<size_t> falsePositiveTotal;
+    mutable std::atomic<size_t> negativeTotal;
+
+    uint64_t runsTag() const;
+    static void probePair(const Digest& key, uint64_t& h1, uint64_t& h2);
+    std::vector<uint8_t> buildFilter(const std::vector<Digest>& keys) const;
+    static bool mayContain(const uint8_t* filter, size_t bytes, const Digest& address);
+    void addBlock(const BlockSource& blocks, size_t height, const IndexRuns::View& indexed, Batch& batch) const;
+    static void scanBlocks(const Digest& address, const BlockSource& blockAt, size_t endHeight,
+                           const IndexRuns::View& indexed, const Batch* batch, std::vector<TransactionRef>& out,
+                           QueryStats& queryStats);
+};
+
+#endif // ADDRESSINDEX_H
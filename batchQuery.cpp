@@ -0,0 +1,402 @@
+#include "batchQuery.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <unordered_map>
+
+namespace {
+
+const size_t OUTPUT_BUFFER_BYTES = 1 << 20;
+
+const char* kindName(BatchQuery::Kind kind) {
+    switch (kind) {
+        case BatchQuery::BLOCK: return "block";
+        case BatchQuery::TRANSACTION: return "tx";
+        case BatchQuery::USER: return "user";
+        case BatchQuery::BALANCE: return "balance";
+        case BatchQuery::INVALID: break;
+    }
+    return "invalid";
+}
+
+const char* statusName(BatchQuery::Status status) {
+    switch (status) {
+        case BatchQuery::FOUND: return "found";
+        case BatchQuery::NOT_FOUND: return "not_found";
+        case BatchQuery::MALFORMED: break;
+    }
+    return "malformed";
+}
+
+void appendHex(std::string& out, const Digest& digest) {
+    char hex[Digest::HEX_LENGTH];
+    digest.writeHex(hex);
+    out.append(hex, sizeof(hex));
+}
+
+void appendCsvText(std::string& out, const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) {
+        out += text;
+        return;
+    }
+    out += '"';
+    for (char c : text) {
+        if (c == '"') {
+            out += '"';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+void appendJsonText(std::string& out, const std::string& text) {
+    out += '"';
+    for (unsigned char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += static_cast<char>(c);
+        } else if (c < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += static_cast<char>(c);
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+BatchQuery::BatchQuery(const BlockStore& store, const ChainIndex* index, const AccountState& accounts)
+    : store(store), index(index), accounts(accounts) {}
+
+std::vector<BatchQuery::Query> BatchQuery::parse(std::istream& in) {
+    std::vector<Query> queries;
+    std::string line;
+    size_t number = 0;
+    while (std::getline(in, line)) {
+        ++number;
+        size_t begin = line.find_first_not_of(" \t\r");
+        if (begin == std::string::npos || line[begin] == '#') {
+            continue;
+        }
+        size_t end = line.find_last_not_of(" \t\r") + 1;
+        Query query;
+        query.line = number;
+        query.text = line.substr(begin, end - begin);
+
+        size_t split = query.text.find_first_of(" \t");
+        std::string command = query.text.substr(0, split);
+        std::string argument;
+        if (split != std::string::npos) {
+            argument = query.text.substr(query.text.find_first_not_of(" \t", split));
+        }
+        std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+        if (split == std::string::npos && Digest::parseHex(command, query.key)) {
+            query.kind = TRANSACTION;
+        } else if (argument.empty() || argument.find_first_of(" \t") != std::string::npos) {
+            query.kind = INVALID;
+        } else if (command == "USER") {
+            query.kind = USER;
+            query.name = argument;
+        } else if ((command == "BLOCK" || command == "TX" || command == "BALANCE") &&
+                   Digest::parseHex(argument, query.key)) {
+            query.kind = command == "BLOCK" ? BLOCK : command == "TX" ? TRANSACTION : BALANCE;
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+
+BatchQuery::Format BatchQuery::formatFor(const std::string& path) {
+    std::string extension = path.size() >= 4 ? path.substr(path.size() - 4) : "";
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+    return extension == ".csv" ? CSV : JSONL;
+}
+
+void BatchQuery::resolveAccount(const Query& query, Row& row) const {
+    row.account = query.kind == USER ? accounts.findAccountByName(query.name) : accounts.findAccount(query.key);
+    if (row.account != AccountState::NOT_FOUND) {
+        row.status = FOUND;
+        row.balance = accounts.getBalance(static_cast<size_t>(row.account));
+    }
+}
+
+void BatchQuery::fill(const BlockView& block, uint32_t height, const Query& query, Row& row) const {
+    const StoredBlockHeader& header = block.header();
+    row.status = FOUND;
+    row.height = height;
+    row.blockID = header.blockID;
+    if (query.kind == BLOCK) {
+        row.merkleRoot = header.merkleRoot;
+        row.transactionCount = header.transactionCount;
+    } else {
+        row.transaction = block.transaction(row.position);
+    }
+}
+
+std::vector<BatchQuery::Row> BatchQuery::resolve(const std::vector<Query>& queries, Stats* stats) const {
+    std::vector<Row> rows(queries.size());
+    Stats local;
+
+    // (height << 32 | position, query) for every query that names a place in the chain
+    std::vector<std::pair<uint64_t, size_t>> located;
+    located.reserve(queries.size());
+    std::unordered_map<Digest, std::vector<size_t>, DigestHasher> blockKeys, transactionKeys;
+    for (size_t i = 0; i < queries.size(); ++i) {
+        const Query& query = queries[i];
+        if (query.kind == INVALID) {
+            rows[i].status = MALFORMED;
+        } else if (query.kind == USER || query.kind == BALANCE) {
+            resolveAccount(query, rows[i]);
+        } else if (index == nullptr) {
+            (query.kind == BLOCK ? blockKeys : transactionKeys)[query.key].push_back(i);
+        } else if (query.kind == BLOCK) {
+            int64_t height = index->findBlock(query.key);
+            if (height == ChainIndex::NOT_FOUND) {
+                height = index->findBlockByMerkleRoot(query.key);
+            }
+            if (height != ChainIndex::NOT_FOUND) {
+                located.emplace_back(static_cast<uint64_t>(height) << 32, i);
+            }
+        } else {
+            ChainIndex::TransactionLocation location;
+            if (index->findTransaction(query.key, location)) {
+                located.emplace_back(static_cast<uint64_t>(location.height) << 32 | location.position, i);
+            }
+        }
+    }
+
+    // Without an index, one front-to-back scan; a key is dropped at its first (lowest) height
+    if (index == nullptr && (!blockKeys.empty() || !transactionKeys.empty())) {
+        local.scanned = true;
+        for (size_t height = 0; height < store.size() && (!blockKeys.empty() || !transactionKeys.empty()); ++height) {
+            BlockView block = store.view(height);
+            for (const Digest* key : {&block.header().blockID, &block.header().merkleRoot}) {
+                auto found = blockKeys.find(*key);
+                if (found != blockKeys.end()) {
+                    for (size_t i : found->second) {
+                        located.emplace_back(static_cast<uint64_t>(height) << 32, i);
+                    }
+                    blockKeys.erase(found);
+                }
+            }
+            for (size_t t = 0; t < block.transactionCount() && !transactionKeys.empty(); ++t) {
+                auto found = transactionKeys.find(block.transaction(t).transactionID);
+                if (found != transactionKeys.end()) {
+                    for (size_t i : found->second) {
+                        located.emplace_back(static_cast<uint64_t>(height) << 32 | t, i);
+                    }
+                    transactionKeys.erase(found);
+                }
+            }
+        }
+    }
+
+    // Grouped by block and read in chain order, so the mapped file is walked once
+    std::sort(located.begin(), located.end());
+    size_t currentHeight = SIZE_MAX;
+    BlockView block(nullptr, nullptr);
+    for (const auto& entry : located) {
+        uint32_t height = static_cast<uint32_t>(entry.first >> 32);
+        if (height != currentHeight) {
+            block = store.view(height);
+            currentHeight = height;
+            local.blocksRead++;
+        }
+        Row& row = rows[entry.second];
+        row.position = static_cast<uint32_t>(entry.first);
+        fill(block, height, queries[entry.second], row);
+    }
+
+    for (const Row& row : rows) {
+        local.found += row.status == FOUND;
+        local.notFound += row.status == NOT_FOUND;
+        local.malformed += row.status == MALFORMED;
+    }
+    if (stats != nullptr) {
+        *stats = local;
+    }
+    return rows;
+}
+
+BatchQuery::Row BatchQuery::resolveOne(const Query& query) const {
+    Row row;
+    if (query.kind == INVALID) {
+        row.status = MALFORMED;
+        return row;
+    }
+    if (query.kind == USER || query.kind == BALANCE) {
+        resolveAccount(query, row);
+        return row;
+    }
+
+    int64_t height = ChainIndex::NOT_FOUND;
+    if (index != nullptr && query.kind == BLOCK) {
+        height = index->findBlock(query.key);
+        if (height == ChainIndex::NOT_FOUND) {
+            height = index->findBlockByMerkleRoot(query.key);
+        }
+    } else if (index != nullptr) {
+        ChainIndex::TransactionLocation location;
+        if (index->findTransaction(query.key, location)) {
+            height = location.height;
+            row.position = location.position;
+        }
+    } else {
+        for (size_t h = 0; h < store.size() && height == ChainIndex::NOT_FOUND; ++h) {
+            BlockView block = store.view(h);
+            if (query.kind == BLOCK) {
+                if (block.header().blockID == query.key || block.header().merkleRoot == query.key) {
+                    height = static_cast<int64_t>(h);
+                }
+                continue;
+            }
+            for (size_t t = 0; t < block.transactionCount(); ++t) {
+                if (block.transaction(t).transactionID == query.key) {
+                    height = static_cast<int64_t>(h);
+                    row.position = static_cast<uint32_t>(t);
+                    break;
+                }
+            }
+        }
+    }
+    if (height == ChainIndex::NOT_FOUND) {
+        return row;
+    }
+
+    Block block = store.load(static_cast<size_t>(height));
+    row.status = FOUND;
+    row.height = static_cast<uint32_t>(height);
+    row.blockID = block.getBlockID();
+    if (query.kind == BLOCK) {
+        row.merkleRoot = block.getMerkleRootHash();
+        row.transactionCount = static_cast<uint32_t>(block.getNumTransactions());
+    } else {
+        const Transaction& tx = block.getTransactions()[row.position];
+        row.transaction.transactionID = tx.getTransactionID();
+        row.transaction.sender = tx.getSenderPublicKey();
+        row.transaction.receiver = tx.getReceiverPublicKey();
+        row.transaction.amount = tx.getAmount();
+    }
+    return row;
+}
+
+void BatchQuery::appendRow(std::string& out, Format format, const Query& query, const Row& row) const {
+    bool found = row.status == FOUND;
+    bool chain = found && (query.kind == BLOCK || query.kind == TRANSACTION);
+    bool account = found && (query.kind == USER || query.kind == BALANCE);
+    size_t accountNumber = account ? static_cast<size_t>(row.account) : 0;
+
+    if (format == CSV) {
+        out += std::to_string(query.line);
+        out += ',';
+        appendCsvText(out, query.text);
+        out += ',';
+        out += kindName(query.kind);
+        out += ',';
+        out += statusName(row.status);
+        out += ',';
+        if (chain) {
+            out += std::to_string(row.height);
+        }
+        out += ',';
+        if (found && query.kind == TRANSACTION) {
+            out += std::to_string(row.position);
+        }
+        out += ',';
+        if (chain) {
+            appendHex(out, row.blockID);
+        }
+        out += ',';
+        if (found && query.kind == BLOCK) {
+            appendHex(out, row.merkleRoot);
+            out += ',';
+            out += std::to_string(row.transactionCount);
+        } else {
+            out += ',';
+        }
+        out += ',';
+        if (found && query.kind == TRANSACTION) {
+            appendHex(out, row.transaction.transactionID);
+            out += ',';
+            appendHex(out, row.transaction.sender);
+            out += ',';
+            appendHex(out, row.transaction.receiver);
+            out += ',';
+            out += std::to_string(row.transaction.amount);
+        } else {
+            out += ",,,";
+        }
+        out += ',';
+        if (account) {
+            appendCsvText(out, accounts.getName(accountNumber));
+            out += ',';
+            appendHex(out, accounts.getPublicKey(accountNumber));
+            out += ',';
+            out += std::to_string(row.balance);
+        } else {
+            out += ",,";
+        }
+        out += '\n';
+        return;
+    }
+
+    out += "{\"line\":" + std::to_string(query.line) + ",\"query\":";
+    appendJsonText(out, query.text);
+    out += ",\"kind\":\"";
+    out += kindName(query.kind);
+    out += "\",\"status\":\"";
+    out += statusName(row.status);
+    out += '"';
+    if (chain) {
+        out += ",\"height\":" + std::to_string(row.height) + ",\"block_id\":\"";
+        appendHex(out, row.blockID);
+        out += '"';
+    }
+    if (found && query.kind == BLOCK) {
+        out += ",\"merkle_root\":\"";
+        appendHex(out, row.merkleRoot);
+        out += "\",\"transactions\":" + std::to_string(row.transactionCount);
+    } else if (found && query.kind == TRANSACTION) {
+        out += ",\"position\":" + std::to_string(row.position) + ",\"transaction_id\":\"";
+        appendHex(out, row.transaction.transactionID);
+        out += "\",\"sender\":\"";
+        appendHex(out, row.transaction.sender);
+        out += "\",\"receiver\":\"";
+        appendHex(out, row.transaction.receiver);
+        out += "\",\"amount\":" + std::to_string(row.transaction.amount);
+    } else if (account) {
+        out += ",\"name\":";
+        appendJsonText(out, accounts.getName(accountNumber));
+        out += ",\"public_key\":\"";
+        appendHex(out, accounts.getPublicKey(accountNumber));
+        out += "\",\"balance\":" + std::to_string(row.balance);
+    }
+    out += "}\n";
+}
+
+bool BatchQuery::write(const std::string& path, Format format, const std::vector<Query>& queries,
+                       const std::vector<Row>& rows) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file) {
+        return false;
+    }
+    std::string buffer;
+    buffer.reserve(OUTPUT_BUFFER_BYTES + 1024);
+    if (format == CSV) {
+        buffer += "line,query,kind,status,height,position,block_id,merkle_root,transactions,"
+                  "transaction_id,sender,receiver,amount,name,public_key,balance\n";
+    }
+    for (size_t i = 0; i < queries.size(); ++i) {
+        appendRow(buffer, format, queries[i], rows[i]);
+        if (buffer.size() >= OUTPUT_BUFFER_BYTES) {
+            file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+            buffer.clear();
+        }
+    }
+    file.write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    return static_cast<bool>(file);
+}
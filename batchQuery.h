@@ -0,0 +1,81 @@
+#ifndef BATCHQUERY_H
+#define BATCHQUERY_H
+
+#include <string>
+#include <vector>
+#include <istream>
+#include <cstdint>
+#include "digest.h"
+#include "blockStore.h"
+#include "chainIndex.h"
+#include "accountState.h"
+
+// Non-interactive lookups for many queries at once, e.g. reconciling a list of
+// transaction IDs against the stored chain.
+//
+// A query file has one query per line in the query server's syntax: "BLOCK <id or Merkle
+// root>", "TX <id>", "USER <name>" or "BALANCE <public key>"; a line holding only a
+// 64 character hex string is a TX query, empty lines and lines starting with '#' are
+// skipped. resolve() looks every query up in the ChainIndex, or with no index collects
+// the keys into hash sets and matches them in one scan of the store, then sorts the hits
+// by (height, position) and reads each referenced block once, front to back. Results are
+// written in the order of the file as CSV or JSONL through one large output buffer.
+class BatchQuery {
+public:
+    enum Kind : uint8_t { BLOCK, TRANSACTION, USER, BALANCE, INVALID };
+    enum Status : uint8_t { FOUND, NOT_FOUND, MALFORMED };
+    enum Format { CSV, JSONL };
+
+    struct Query {
+        size_t line = 0;
+        Kind kind = INVALID;
+        std::string text; // The line as read
+        std::string name; // USER
+        Digest key;       // BLOCK, TX, BALANCE
+    };
+
+    struct Row {
+        Status status = NOT_FOUND;
+        uint32_t height = 0;
+        uint32_t position = 0;
+        uint32_t transactionCount = 0; // BLOCK
+        Digest blockID;
+        Digest merkleRoot;             // BLOCK
+        StoredTransaction transaction; // TX
+        int64_t account = AccountState::NOT_FOUND; // USER, BALANCE
+        int64_t balance = 0;
+    };
+
+    struct Stats {
+        size_t found = 0;
+        size_t notFound = 0;
+        size_t malformed = 0;
+        size_t blocksRead = 0; // Distinct blocks visited by the ordered pass
+        bool scanned = false;  // Resolved by a full store scan instead of the index
+    };
+
+    // `index` may be null; `accounts` supplies names, keys and current balances
+    BatchQuery(const BlockStore& store, const ChainIndex* index, const AccountState& accounts);
+
+    static std::vector<Query> parse(std::istream& in);
+    static Format formatFor(const std::string& path); // ".csv" -> CSV, anything else JSONL
+
+    std::vector<Row> resolve(const std::vector<Query>& queries, Stats* stats = nullptr) const;
+    // The same answer for a single query the way the interactive lookups did it: index
+    // (or scan) and a full Block load per query
+    Row resolveOne(const Query& query) const;
+
+    bool write(const std::string& path, Format format, const std::vector<Query>& queries,
+               const std::vector<Row>& rows) const;
+    void appendRow(std::string& out, Format format, const Query& query, const Row& row) const;
+
+private:
+    const BlockStore& store;
+    const ChainIndex* index;
+    const AccountState& accounts;
+
+    void resolveAccount(const Query& query, Row& row) const;
+    void fill(const BlockView& block, uint32_t height, const Query& query, Row& row) const;
+};
+
+#endif // BATCHQUERY_H
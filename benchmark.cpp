@@ -0,0 +1,459 @@
+// benchmark.cpp
+#include <iostream>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <cstdio>
+#include <cmath>
+#include <omp.h>
+#include "hash.h"
+#include "blockHeader.h"
+#include "merkleRootHash.h"
+#include "accountState.h"
+#include "mempool.h"
+#include "blockStore.h"
+#include "chainIndex.h"
+#include "workloadGenerator.h"
+#include "mainFunctions.h"
+
+namespace {
+
+const std::string PREVIOUS_HASH = "0000000000000000000000000000000000000000000000000000000000000000";
+const std::string TIMESTAMP = "1729000000";
+const std::string MERKLE_ROOT = "6b1f0a93c2d44e57a8b90c1d2e3f405162738495a6b7c8d9eaf0b1c2d3e4f506";
+const int DIFFICULTY = 1;
+const uint64_t SEED = 20241015;
+
+struct Result {
+    std::string name;
+    double value;
+    std::string unit;
+    bool higherIsBetter;
+};
+
+std::vector<Result> results;
+
+// Keeps results alive so the optimizer cannot drop the measured work
+volatile uint64_t sink = 0;
+
+template <typename Work>
+double seconds(Work work) {
+    auto start = std::chrono::steady_clock::now();
+    work();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& name, double value, const std::string& unit, bool higherIsBetter) {
+    results.push_back(Result{name, value, unit, higherIsBetter});
+    std::cout << std::left << std::setw(48) << name << std::right << std::setw(16) << std::fixed
+              << std::setprecision(value < 10 ? 4 : 0) << value << " " << unit << std::endl;
+}
+
+// Runs `attempt` the given number of times and records hashes per second; each call
+// evaluates `hashesPerCall` nonces
+template <typename Attempt>
+double measure(const std::string& name, uint64_t iterations, Attempt attempt, uint64_t hashesPerCall = 1) {
+    uint64_t checksum = 0;
+    double elapsed = seconds([&] {
+        for (uint64_t nonce = 0; nonce < iterations; ++nonce) {
+            checksum += attempt(nonce);
+        }
+    });
+    sink = sink + checksum;
+    double hashesPerSecond = iterations * hashesPerCall / elapsed;
+    report(name, hashesPerSecond, "hashes/sec", true);
+    return hashesPerSecond;
+}
+
+Digest randomDigest(CounterRng& rng) {
+    Digest digest;
+    for (size_t i = 0; i < digest.bytes.size(); i += 8) {
+        uint64_t word = rng.next();
+        for (size_t b = 0; b < 8; ++b) {
+            digest.bytes[i + b] = static_cast<uint8_t>(word >> (8 * b));
+        }
+    }
+    return digest;
+}
+
+void benchmarkHashSizes(uint64_t iterations) {
+    std::cout << "\nHash throughput by input size" << std::endl;
+    for (size_t size : {16, 64, 256, 1024, 4096}) {
+        std::string input(size, 'x');
+        for (size_t i = 0; i < size; ++i) {
+            input[i] = static_cast<char>('a' + (i * 7) % 26);
+        }
+        uint64_t rounds = std::max<uint64_t>(1, iterations * 64 / (size + 64));
+        measure("hash " + std::to_string(size) + " bytes", rounds, [&input](uint64_t round) {
+            input[0] = static_cast<char>('a' + round % 26);
+            return static_cast<uint64_t>(HashUtils::hash(input).bytes[0]);
+        });
+    }
+}
+
+void benchmarkHeaders(uint64_t iterations) {
+    std::cout << "\nBlock header hashing" << std::endl;
+    measure("header: stringstream + reference hash", iterations / 10, [](uint64_t nonce) {
+        std::stringstream ss;
+        ss << PREVIOUS_HASH << TIMESTAMP << MERKLE_ROOT << nonce << DIFFICULTY;
+        return static_cast<uint64_t>(HashUtils::processHashInputReference(ss.str())[0]);
+    });
+
+    measure("header: stringstream + packed hash", iterations, [](uint64_t nonce) {
+        std::stringstream ss;
+        ss << PREVIOUS_HASH << TIMESTAMP << MERKLE_ROOT << nonce << DIFFICULTY;
+        return static_cast<uint64_t>(HashUtils::hash(ss.str()).bytes[0]);
+    });
+
+    BlockHeader header(Digest::fromHex(PREVIOUS_HASH), TIMESTAMP, Digest::fromHex(MERKLE_ROOT), 0, DIFFICULTY * 4);
+    measure("header: precomputed prefix", iterations, [&header](uint64_t nonce) {
+        return static_cast<uint64_t>(header.hash(nonce).bytes[0]);
+    });
+
+    BlockHeader target(Digest::fromHex(PREVIOUS_HASH), TIMESTAMP, Digest::fromHex(MERKLE_ROOT), 0, 8);
+    measure("header: early-abort check (8 bits)", iterations, [&target](uint64_t nonce) {
+        return static_cast<uint64_t>(target.meetsDifficulty(nonce));
+    });
+
+    measure(std::string("header: batched check (") + HashUtils::batchKernelName() + ")",
+            iterations / BlockHeader::BATCH_SIZE, [&target](uint64_t group) {
+        bool results[BlockHeader::BATCH_SIZE];
+        target.meetsDifficultyBatch(group * BlockHeader::BATCH_SIZE, BlockHeader::BATCH_SIZE, results);
+        return static_cast<uint64_t>(results[0]);
+    }, BlockHeader::BATCH_SIZE);
+}
+
+// The mining inner loop (early-abort checks over disjoint nonces) at each thread count
+void benchmarkMiningThreads(uint64_t iterations) {
+    std::cout << "\nMining hashes/sec by thread count" << std::endl;
+    BlockHeader target(Digest::fromHex(PREVIOUS_HASH), TIMESTAMP, Digest::fromHex(MERKLE_ROOT), 0, 8);
+    int maxThreads = omp_get_max_threads();
+    std::vector<int> counts;
+    for (int threads = 1; threads < maxThreads; threads *= 2) {
+        counts.push_back(threads);
+    }
+    counts.push_back(maxThreads);
+
+    long nonces = static_cast<long>(iterations);
+    for (int threads : counts) {
+        long long found = 0;
+        double elapsed = seconds([&] {
+            #pragma omp parallel for schedule(static) num_threads(threads) reduction(+:found)
+            for (long nonce = 0; nonce < nonces; ++nonce) {
+                found += target.meetsDifficulty(static_cast<uint64_t>(nonce));
+            }
+        });
+        sink = sink + static_cast<uint64_t>(found);
+        report("mining " + std::to_string(threads) + " threads", nonces / elapsed, "hashes/sec", true);
+    }
+}
+
+void benchmarkMerkle(bool quick) {
+    std::cout << "\nMerkle root by block size" << std::endl;
+    CounterRng rng(SEED, 1);
+    for (size_t size : {1, 10, 100, 1000, 10000}) {
+        std::vector<Digest> leaves(size);
+        for (auto& leaf : leaves) {
+            leaf = randomDigest(rng);
+        }
+        int rounds = static_cast<int>(std::max<size_t>(20, (quick ? 200000 : 2000000) / size));
+        double elapsed = seconds([&] {
+            for (int r = 0; r < rounds; ++r) {
+                leaves[0].bytes[0] = static_cast<uint8_t>(r);
+                sink = sink + MerkleTree(leaves).root().bytes[0];
+            }
+        });
+        report("merkle root " + std::to_string(size) + " tx", elapsed / rounds * 1e3, "ms", false);
+    }
+}
+
+void benchmarkLedger(bool quick) {
+    std::cout << "\nAccount lookups and updates" << std::endl;
+    size_t accountCount = quick ? 100000 : 1000000;
+    CounterRng rng(SEED, 2);
+    std::vector<Digest> keys(accountCount);
+    AccountState accounts(accountCount);
+    for (size_t i = 0; i < accountCount; ++i) {
+        keys[i] = randomDigest(rng);
+        accounts.addAccount("User" + std::to_string(i + 1), keys[i], 1000);
+    }
+    size_t operations = quick ? 500000 : 5000000;
+    double elapsed = seconds([&] {
+        for (size_t i = 0; i < operations; ++i) {
+            int64_t account = accounts.findAccount(keys[rng.below(accountCount)]);
+            accounts.updateBalance(static_cast<size_t>(account), 1);
+        }
+    });
+    report("AccountState lookup+update (" + std::to_string(accountCount) + " accounts)", operations / elapsed,
+           "ops/sec", true);
+
+    // The linear lookup it replaced, on a user list small enough to finish
+    size_t userCount = 1000;
+    std::vector<User> users;
+    for (size_t i = 0; i < userCount; ++i) {
+        users.emplace_back("User" + std::to_string(i + 1), keys[i], 1000);
+    }
+    size_t scans = quick ? 2000 : 20000;
+    elapsed = seconds([&] {
+        for (size_t i = 0; i < scans; ++i) {
+            sink = sink + static_cast<uint64_t>(findUserIndex(users, users[rng.below(userCount)].getPublicKey()));
+        }
+    });
+    report("findUserIndex (" + std::to_string(userCount) + " users)", scans / elapsed, "ops/sec", true);
+}
+
+void benchmarkMempool(bool quick) {
+    std::cout << "\nMempool drain" << std::endl;
+    WorkloadGenerator generator(SEED);
+    std::vector<User> users = generator.generateUsers(quick ? 1000 : 10000);
+    size_t transactionCount = quick ? 20000 : 200000;
+    std::vector<Transaction> transactions;
+    transactions.reserve(transactionCount);
+    generator.generateTransactions(users, transactionCount, [&](std::vector<Transaction>& chunk) {
+        transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+    });
+
+    AccountState accounts = AccountState::fromUsers(users);
+    Mempool mempool;
+    double fill = seconds([&] {
+        for (const auto& transaction : transactions) {
+            mempool.add(transaction);
+        }
+    });
+    size_t blocks = 0;
+    double drain = seconds([&] {
+        while (!mempool.empty()) {
+            std::vector<Transaction> rejected;
+            if (mempool.selectForBlock(accounts, 100, rejected).empty()) {
+                break;
+            }
+            blocks++;
+        }
+    });
+    sink = sink + blocks;
+    report("mempool add (" + std::to_string(transactionCount) + " tx)", transactionCount / fill, "tx/sec", true);
+    report("mempool drain (" + std::to_string(transactionCount) + " tx)", drain, "s", false);
+}
+
+void benchmarkChainIo(bool quick) {
+    std::cout << "\nChain I/O" << std::endl;
+    const std::string path = "benchmark_chain.dat";
+    const std::string indexPath = "benchmark_chain.lookup";
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    IndexRuns::removeFiles(indexPath);
+
+    size_t blockCount = quick ? 1000 : 10000;
+    CounterRng rng(SEED, 3);
+    std::vector<Block> blocks;
+    blocks.reserve(blockCount);
+    for (size_t b = 0; b < blockCount; ++b) {
+        std::vector<Transaction> transactions;
+        for (int t = 0; t < 100; ++t) {
+            transactions.emplace_back(randomDigest(rng), randomDigest(rng), randomDigest(rng), 1);
+        }
+        blocks.push_back(Block::restore(randomDigest(rng), randomDigest(rng), randomDigest(rng),
+                                        TIMESTAMP, b, 0, 4, "1.0", transactions));
+    }
+
+    {
+        // Unsynced, so this measures the store itself rather than the disk's flush latency
+        BlockStore store;
+        store.open(path);
+        store.setSyncWrites(false);
+        double elapsed = seconds([&] {
+            for (const Block& block : blocks) {
+                store.append(block);
+            }
+        });
+        report("block store append", blockCount / elapsed, "blocks/sec", true);
+    }
+
+    // Opening and scanning are quick, so both are repeated to get above timer noise
+    const int repeats = 50;
+    BlockStore store;
+    double reopen = seconds([&] {
+        for (int r = 0; r < repeats; ++r) {
+            store.open(path);
+        }
+    });
+    report("block store open (" + std::to_string(blockCount) + " blocks)", reopen / repeats * 1e3, "ms", false);
+
+    double scan = seconds([&] {
+        for (int r = 0; r < repeats; ++r) {
+            for (size_t h = 0; h < store.size(); ++h) {
+                BlockView view = store.view(h);
+                for (size_t t = 0; t < view.transactionCount(); ++t) {
+                    sink = sink + static_cast<uint64_t>(view.transaction(t).amount);
+                }
+            }
+        }
+    });
+    report("block store mmap scan", store.size() * repeats / scan, "blocks/sec", true);
+
+    double load = seconds([&] {
+        for (size_t h = 0; h < store.size(); ++h) {
+            sink = sink + static_cast<uint64_t>(store.load(h).getNumTransactions());
+        }
+    });
+    report("block store load", store.size() / load, "blocks/sec", true);
+
+    ChainIndex index;
+    index.setSyncWrites(false);
+    double rebuild = seconds([&] { index.open(indexPath, store); });
+    report("chain index rebuild", rebuild * 1e3, "ms", false);
+
+    std::remove(path.c_str());
+    std::remove((path + ".idx").c_str());
+    index.close();
+    IndexRuns::removeFiles(indexPath);
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string escaped;
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            escaped += '\\';
+        }
+        escaped += c;
+    }
+    return escaped;
+}
+
+bool writeJson(const std::string& path) {
+    std::ofstream out(path);
+    out << "{\n  \"kernel\": \"" << HashUtils::batchKernelName() << "\",\n"
+        << "  \"threads\": " << omp_get_max_threads() << ",\n  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        out << "    {\"name\": \"" << jsonEscape(results[i].name) << "\", \"value\": " << std::setprecision(9)
+            << results[i].value << ", \"unit\": \"" << jsonEscape(results[i].unit) << "\", \"higher_is_better\": "
+            << (results[i].higherIsBetter ? "true" : "false") << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Reads back the name/value pairs of a file written by writeJson
+bool readBaseline(const std::string& path, std::vector<std::pair<std::string, double>>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::stringstream buffer;
+    buffer << in.rdbuf();
+    std::string text = buffer.str();
+    const std::string nameKey = "\"name\": \"";
+    const std::string valueKey = "\"value\": ";
+    for (size_t pos = text.find(nameKey); pos != std::string::npos; pos = text.find(nameKey, pos)) {
+        size_t start = pos + nameKey.size();
+        size_t end = start;
+        while (end < text.size() && text[end] != '"') {
+            end += text[end] == '\\' ? 2 : 1;
+        }
+        std::string name;
+        for (size_t i = start; i < end && i < text.size(); ++i) {
+            if (text[i] == '\\') {
+                ++i;
+            }
+            name += text[i];
+        }
+        size_t value = text.find(valueKey, end);
+        if (value == std::string::npos) {
+            break;
+        }
+        baseline.emplace_back(name, std::strtod(text.c_str() + value + valueKey.size(), nullptr));
+        pos = value;
+    }
+    return true;
+}
+
+// Prints the relative change of every benchmark present in both runs; returns the number
+// of regressions beyond `tolerance`
+int compareWithBaseline(const std::vector<std::pair<std::string, double>>& baseline, double tolerance) {
+    std::cout << "\nComparison with baseline (tolerance " << tolerance * 100 << "%)" << std::endl;
+    int regressions = 0;
+    for (const Result& result : results) {
+        auto it = std::find_if(baseline.begin(), baseline.end(),
+                               [&result](const std::pair<std::string, double>& entry) { return entry.first == result.name; });
+        if (it == baseline.end() || it->second <= 0) {
+            std::cout << std::left << std::setw(48) << result.name << "  (no baseline)" << std::endl;
+            continue;
+        }
+        // Positive is better in either direction
+        double change = result.higherIsBetter ? result.value / it->second - 1 : it->second / result.value - 1;
+        bool regressed = change < -tolerance;
+        regressions += regressed;
+        std::cout << std::left << std::setw(48) << result.name << std::right << std::setw(9) << std::fixed
+                  << std::setprecision(1) << std::showpos << change * 100 << "%" << std::noshowpos
+                  << (regressed ? "  REGRESSION" : "") << std::endl;
+    }
+    return regressions;
+}
+
+void usage() {
+    std::cout << "Usage: benchmark [iterations] [--quick] [--json out.json] [--baseline old.json] [--tolerance 0.10]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    uint64_t iterations = 200000;
+    bool quick = false;
+    std::string jsonPath, baselinePath;
+    double tolerance = 0.10;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--quick") {
+            quick = true;
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--baseline" && i + 1 < argc) {
+            baselinePath = argv[++i];
+        } else if (arg == "--tolerance" && i + 1 < argc) {
+            tolerance = std::strtod(argv[++i], nullptr);
+        } else if (!arg.empty() && arg.find_first_not_of("0123456789") == std::string::npos) {
+            iterations = std::strtoull(arg.c_str(), nullptr, 10);
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (quick) {
+        iterations = std::min<uint64_t>(iterations, 20000);
+    }
+
+    std::cout << "Benchmarks, " << iterations << " iterations, " << omp_get_max_threads() << " threads, "
+              << HashUtils::batchKernelName() << " hash kernel" << std::endl;
+    benchmarkHashSizes(iterations);
+    benchmarkHeaders(iterations);
+    benchmarkMiningThreads(iterations);
+    benchmarkMerkle(quick);
+    benchmarkLedger(quick);
+    benchmarkMempool(quick);
+    benchmarkChainIo(quick);
+
+    if (!jsonPath.empty()) {
+        if (!writeJson(jsonPath)) {
+            std::cout << "Could not write " << jsonPath << std::endl;
+            return 2;
+        }
+        std::cout << "\nResults written to " << jsonPath << std::endl;
+    }
+    if (!baselinePath.empty()) {
+        std::vector<std::pair<std::string, double>> baseline;
+        if (!readBaseline(baselinePath, baseline)) {
+            std::cout << "Could not read baseline " << baselinePath << std::endl;
+            return 2;
+        }
+        int regressions = compareWithBaseline(baseline, tolerance);
+        std::cout << regressions << " regression(s)" << std::endl;
+        return regressions > 0 ? 1 : 0;
+    }
+    return 0;
+}
@@ -1,58 +1,151 @@
 #include "block.h"
 #include "hash.h" // Include for `processHashInput`
+#include "blockHeader.h"
+#include "metrics.h"
 #include <iostream>
 #include <sstream>
 #include <ctime>
+#include <atomic>
+#include <chrono>
+#include <limits>
 #include <omp.h>
 
-Block::Block(const std::string& previousHash, const std::vector<Transaction>& transactions, int difficultyTarget)
-    : previousHash(previousHash), transactions(transactions), difficultyTarget(difficultyTarget) {
+namespace {
+// Nonces handed to a worker at a time; each chunk is a disjoint range owned by one thread
+const uint64_t NONCE_CHUNK = 4096;
+const uint64_t NONCE_LIMIT = std::numeric_limits<uint64_t>::max();
+}
+
+Block::Block(const Digest& previousHash, const std::vector<Transaction>& transactions, int difficultyTarget)
+    : transactions(transactions), previousHash(previousHash), difficultyTarget(difficultyTarget),
+      difficultyBits(difficultyTarget * 4) {
     this->timestamp = std::to_string(std::time(0)); // Initialize timestamp with current Unix time
     this->nonce = 0;
-    MerkleTree merkleTree(transactions);
-    this->merkleRootHash = merkleTree.createMerkleRootHash(); // Use existing MerkleTree class
+    this->extraNonce = 0;
+    this->merkleTree = MerkleTree(transactions);
+    this->merkleAccumulator = MerkleAccumulator::fromTree(merkleTree);
+    this->merkleTreeStale = false;
+    this->merkleRootHash = merkleTree.root();
     this->version = "1.0"; // Example version, change as needed
 }
 
-std::string Block::calculateBlockHash() const {
-    std::stringstream ss;
-    ss << previousHash << timestamp << merkleRootHash << nonce << difficultyTarget;
-    return HashUtils::processHashInput(ss.str());
+void Block::addTransaction(const Transaction& transaction) {
+    transactions.push_back(transaction);
+    merkleAccumulator.append(transaction.getTransactionID());
+    merkleRootHash = merkleAccumulator.root();
+    merkleTreeStale = true;
+}
+
+Digest Block::calculateBlockHash() const {
+    return calculateBlockHash(nonce, extraNonce);
+}
+
+Digest Block::calculateBlockHash(uint64_t nonce, uint64_t extraNonce) const {
+    return createHeader(extraNonce).hash(nonce);
+}
+
+BlockHeader Block::createHeader(uint64_t extraNonce) const {
+    return BlockHeader(previousHash, timestamp, merkleRootHash, extraNonce, difficultyBits);
+}
+
+bool Block::meetsDifficulty(const Digest& hash) const {
+    return hash.leadingZeroBits() >= difficultyBits;
+}
+
+void Block::mineBlock(int threadCount) {
+    if (threadCount <= 0) {
+        threadCount = omp_get_max_threads();
+    }
+
+    static Metrics::Histogram& latency = Metrics::instance().histogram(
+        "block_mining_seconds", "Time to find a nonce for one block", Metrics::latencyBuckets());
+    static Metrics::Counter& blocksMined = Metrics::instance().counter("blocks_mined_total", "Blocks mined");
+    auto start = std::chrono::steady_clock::now();
+
+    buildMerkleTree(); // Keep proofs available for the mined block
+
+    extraNonce = 0;
+    while (!searchNonceRange(extraNonce, threadCount)) {
+        extraNonce++; // Whole nonce space tried without success, roll over into a new one
+    }
+    latency.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    blocksMined.add();
 }
 
-void Block::mineBlock() {
-    std::string target(difficultyTarget, '0'); // Create a string with 'difficultyTarget' number of leading zeros
+bool Block::applyProofOfWork(uint64_t nonce, uint64_t extraNonce) {
+    Digest hash = calculateBlockHash(nonce, extraNonce);
+    if (!meetsDifficulty(hash)) {
+        return false;
+    }
+    buildMerkleTree();
+    this->nonce = nonce;
+    this->extraNonce = extraNonce;
+    blockID = hash;
+    return true;
+}
 
-    bool found = false;
-    #pragma omp parallel num_threads(4)
+// Searches the full nonce space for one extra nonce. Workers claim disjoint chunks and
+// hash their own candidates without any shared state besides two atomics: the next
+// unclaimed chunk and the lowest winning nonce found so far, which doubles as the
+// cancellation token. Chunks below the winner are always finished, so the result is
+// the same lowest nonce a single thread would find.
+bool Block::searchNonceRange(uint64_t extraNonce, int threadCount) {
+    static Metrics::Counter& hashes = Metrics::instance().counter(
+        "mining_hashes_total", "Nonces evaluated by the miners, per thread slot");
+    std::atomic<uint64_t> nextChunk(0);
+    std::atomic<uint64_t> bestNonce(NONCE_LIMIT);
+
+    #pragma omp parallel num_threads(threadCount)
     {
-        while (!found) {
-            #pragma omp critical
-            {
-                nonce++;
-                currentHash = calculateBlockHash();
-                if (currentHash.substr(0, difficultyTarget) == target) {
-                    blockID = currentHash;
-                    found = true;
+        const BlockHeader header = createHeader(extraNonce); // Private copy per worker
+        while (true) {
+            uint64_t chunk = nextChunk.fetch_add(1, std::memory_order_relaxed);
+            if (chunk > (NONCE_LIMIT - 1) / NONCE_CHUNK) {
+                break; // Nonce space exhausted
+            }
+            uint64_t begin = chunk * NONCE_CHUNK;
+            if (begin >= bestNonce.load(std::memory_order_relaxed)) {
+                break;
+            }
+            uint64_t end = (begin > NONCE_LIMIT - NONCE_CHUNK) ? NONCE_LIMIT : begin + NONCE_CHUNK;
+            uint64_t candidate = begin;
+            for (; candidate < end; ++candidate) {
+                // Only the leading nibbles are evaluated here; the full digest is computed once for the winner
+                if (header.meetsDifficulty(candidate)) {
+                    uint64_t current = bestNonce.load(std::memory_order_relaxed);
+                    while (candidate < current &&
+                           !bestNonce.compare_exchange_weak(current, candidate, std::memory_order_relaxed)) {
+                    }
+                    break;
                 }
-                if (nonce % 100000 == 0) {
-                    std::cout << "Still mining... Current Nonce: " << nonce << ", Current Hash: " << currentHash << std::endl;
+                if ((candidate & 63) == 0 && candidate >= bestNonce.load(std::memory_order_relaxed)) {
+                    break; // Someone found a lower winner
                 }
             }
+            // A break leaves candidate on the last nonce evaluated; running off the end leaves it at
+            // end, which may be NONCE_LIMIT, so nothing is added to it. One uncontended add per chunk.
+            hashes.add((candidate < end ? candidate + 1 : end) - begin);
         }
     }
+
+    uint64_t winner = bestNonce.load();
+    if (winner == NONCE_LIMIT) {
+        return false;
+    }
+    nonce = winner;
+    blockID = calculateBlockHash(nonce, extraNonce);
+    return true;
 }
 
 
 Block Block::createGenesisBlock() {
     std::vector<Transaction> emptyTransactions;
-    std::string genesisPreviousHash = "0000000000000000000000000000000000000000000000000000000000000000";
-    Block genesisBlock(genesisPreviousHash, emptyTransactions, 1); // Set minimal difficulty for the genesis block
+    Block genesisBlock(Digest(), emptyTransactions, CHAIN_DIFFICULTY);
 
     genesisBlock.mineBlock(); // Mine the genesis block
 
     // Print details
-    std::cout << "Genesis Block created: " << genesisBlock.getBlockID() << std::endl;
+    std::cout << "Genesis Block created: " << genesisBlock.getBlockID().toHex() << std::endl;
     std::cout << "Timestamp: " << genesisBlock.getTimestamp() << std::endl;
     std::cout << "Version: 2.0" << std::endl;
     std::cout << "Difficulty Target: " << genesisBlock.getDifficulty() << std::endl;
@@ -61,26 +154,81 @@ Block Block::createGenesisBlock() {
     return genesisBlock;
 }
 
-std::string Block::getBlockID() const {
+const Digest& Block::getBlockID() const {
     return blockID;
 }
 
-std::string Block::getTimestamp() const {
+const std::string& Block::getTimestamp() const {
     return timestamp;
 }
 
+const std::string& Block::getVersion() const {
+    return version;
+}
+
+const Digest& Block::getPreviousHash() const {
+    return previousHash;
+}
+
+void Block::setPreviousHash(const Digest& previousHash) {
+    this->previousHash = previousHash;
+}
+
+void Block::buildMerkleTree() {
+    if (merkleTreeStale) {
+        merkleTree = MerkleTree(transactions);
+        merkleTreeStale = false;
+    }
+}
+
+Block Block::restore(const Digest& blockID, const Digest& previousHash, const Digest& merkleRootHash,
+                     const std::string& timestamp, uint64_t nonce, uint64_t extraNonce, int difficultyBits,
+                     const std::string& version, const std::vector<Transaction>& transactions) {
+    Block block(previousHash, std::vector<Transaction>(), difficultyBits / 4);
+    block.setDifficultyBits(difficultyBits);
+    block.blockID = blockID;
+    block.merkleRootHash = merkleRootHash;
+    block.timestamp = timestamp;
+    block.nonce = nonce;
+    block.extraNonce = extraNonce;
+    block.version = version;
+    block.transactions = transactions;
+    block.merkleTreeStale = !transactions.empty();
+    return block;
+}
+
 int Block::getDifficulty() const {
     return difficultyTarget;
 }
 
- std::string Block::getMerkleRootHash() const { 
+int Block::getDifficultyBits() const {
+    return difficultyBits;
+}
+
+void Block::setDifficultyBits(int bits) {
+    difficultyBits = bits;
+    difficultyTarget = bits / 4;
+}
+
+ const Digest& Block::getMerkleRootHash() const { 
     return merkleRootHash; 
     }
 
-int Block::getNonce() const {
+MerkleTree::Proof Block::getMerkleProof(size_t txIndex) const {
+    if (merkleTreeStale) {
+        return MerkleTree(transactions).proof(txIndex);
+    }
+    return merkleTree.proof(txIndex);
+}
+
+uint64_t Block::getNonce() const {
     return nonce;
 }
 
+uint64_t Block::getExtraNonce() const {
+    return extraNonce;
+}
+
 int Block::getNumTransactions() const {
     return transactions.size();
 }
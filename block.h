@@ -3,35 +3,73 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 #include "transactions.h"
 #include "merkleRootHash.h"
+#include "blockHeader.h"
 
 class Block {
 private:
-    std::string blockID;
+    Digest blockID;
     std::vector<Transaction> transactions;
-    std::string currentHash;
-    std::string previousHash;
-    std::string merkleRootHash;
-    int nonce;
-    int difficultyTarget;
+    MerkleTree merkleTree; // All levels kept so inclusion proofs can be served
+    MerkleAccumulator merkleAccumulator; // Keeps the root current as transactions are added
+    bool merkleTreeStale;  // Transactions were added since merkleTree was built
+    Digest previousHash;
+    Digest merkleRootHash;
+    uint64_t nonce;
+    uint64_t extraNonce; // Bumped whenever the 64-bit nonce space is exhausted
+    int difficultyTarget; // Leading zero hex characters
+    int difficultyBits;   // Leading zero bits, 4 * difficultyTarget unless set explicitly
     std::string timestamp; // Stores the timestamp
     std::string version; // Stores the version of the blockchain
 
 public:
-    Block(const std::string& previousHash, const std::vector<Transaction>& transactions, int difficultyTarget);
+    // Leading zero hex characters every block of the chain is mined to; verification and
+    // sync reject headers that claim less
+    static const int CHAIN_DIFFICULTY = 1;
 
-    std::string calculateBlockHash() const;
-    std::string getBlockID() const;
+    Block(const Digest& previousHash, const std::vector<Transaction>& transactions, int difficultyTarget);
+
+    // Adds a transaction to a block template, updating the Merkle root in O(log n) hashes.
+    // Mining picks up the new root; the full tree is rebuilt only when mining starts.
+    void addTransaction(const Transaction& transaction);
+
+    Digest calculateBlockHash() const;
+    Digest calculateBlockHash(uint64_t nonce, uint64_t extraNonce) const;
+    BlockHeader createHeader(uint64_t extraNonce) const;
+    bool meetsDifficulty(const Digest& hash) const;
+    const Digest& getBlockID() const;
     int getDifficulty() const;
-    int getNonce() const;
+    int getDifficultyBits() const;
+    void setDifficultyBits(int bits); // Finer than 16x steps; call before mining
+    uint64_t getNonce() const;
+    uint64_t getExtraNonce() const;
     int getNumTransactions() const;
-    std::string getMerkleRootHash() const;
+    const Digest& getMerkleRootHash() const;
+    MerkleTree::Proof getMerkleProof(size_t txIndex) const;
     const std::vector<Transaction>& getTransactions() const;
-    std::string getTimestamp() const; // Getter for timestamp
-    std::string getVersion() const; // Getter for version
-    void mineBlock();
+    const std::string& getTimestamp() const; // Getter for timestamp
+    const std::string& getVersion() const; // Getter for version
+    const Digest& getPreviousHash() const;
+    // Templates can be assembled before their parent is mined; the parent's hash is patched in last
+    void setPreviousHash(const Digest& previousHash);
+    // Builds the full Merkle tree for proofs ahead of time; mineBlock does it otherwise
+    void buildMerkleTree();
+    // threadCount 0 uses all available OpenMP threads
+    void mineBlock(int threadCount = 0);
+    // Takes a nonce found outside this process, e.g. by a pool worker; returns false and
+    // leaves the block unchanged if the header does not meet the difficulty with it
+    bool applyProofOfWork(uint64_t nonce, uint64_t extraNonce);
     static Block createGenesisBlock();
+    // Rebuilds an already mined block (e.g. read back from the block store) without
+    // rehashing anything; the Merkle tree for proofs is built on first use
+    static Block restore(const Digest& blockID, const Digest& previousHash, const Digest& merkleRootHash,
+                         const std::string& timestamp, uint64_t nonce, uint64_t extraNonce, int difficultyBits,
+                         const std::string& version, const std::vector<Transaction>& transactions);
+
+private:
+    bool searchNonceRange(uint64_t extraNonce, int threadCount);
 };
 
 #endif // BLOCK_H
\ No newline at end of file
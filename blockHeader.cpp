@@ -0,0 +1,73 @@
+#include "blockHeader.h"
+#include <cstdio>
+
+BlockHeader::BlockHeader(const Digest& previousHash, const std::string& timestamp,
+                         const Digest& merkleRootHash, uint64_t extraNonce, int difficultyBits)
+    : difficultyBits(difficultyBits) {
+    // The header hashes the hex form of both digests
+    char hex[Digest::HEX_LENGTH];
+    prefix.reserve(2 * Digest::HEX_LENGTH + timestamp.size() + 24);
+    previousHash.writeHex(hex);
+    prefix.append(hex, sizeof(hex));
+    prefix += timestamp;
+    merkleRootHash.writeHex(hex);
+    prefix.append(hex, sizeof(hex));
+    if (extraNonce > 0) {
+        prefix += std::to_string(extraNonce); // Omitted for the first nonce space so older blocks hash the same
+        prefix += ':';
+    }
+    prefixState.update(prefix);
+    if (difficultyBits % 4 == 0) {
+        difficultyLength = snprintf(difficultyDigits, sizeof(difficultyDigits), "%d", difficultyBits / 4);
+    } else {
+        difficultyLength = snprintf(difficultyDigits, sizeof(difficultyDigits), "%db", difficultyBits);
+    }
+}
+
+const char* BlockHeader::formatNonce(uint64_t nonce, char* buffer) {
+    char* digit = buffer + MAX_NONCE_DIGITS;
+    do {
+        *--digit = static_cast<char>('0' + nonce % 10);
+        nonce /= 10;
+    } while (nonce > 0);
+    return digit;
+}
+
+HashState BlockHeader::stateFor(uint64_t nonce) const {
+    char buffer[MAX_NONCE_DIGITS];
+    const char* digits = formatNonce(nonce, buffer);
+
+    HashState state = prefixState;
+    state.update(digits, buffer + MAX_NONCE_DIGITS - digits);
+    state.update(difficultyDigits, difficultyLength);
+    return state;
+}
+
+Digest BlockHeader::hash(uint64_t nonce) const {
+    return stateFor(nonce).finalize();
+}
+
+bool BlockHeader::meetsDifficulty(uint64_t nonce) const {
+    return stateFor(nonce).meetsDifficulty(difficultyBits);
+}
+
+bool BlockHeader::meetsDifficulty(uint64_t nonce, int leadingZeroBits) const {
+    return stateFor(nonce).meetsDifficulty(leadingZeroBits);
+}
+
+std::string BlockHeader::serialize(uint64_t nonce) const {
+    char buffer[MAX_NONCE_DIGITS];
+    const char* digits = formatNonce(nonce, buffer);
+    return prefix + std::string(digits, static_cast<const char*>(buffer + MAX_NONCE_DIGITS)) + std::string(difficultyDigits, difficultyLength);
+}
+
+void BlockHeader::meetsDifficultyBatch(uint64_t firstNonce, size_t count, bool* results) const {
+    HashState states[BATCH_SIZE];
+    for (size_t base = 0; base < count; base += BATCH_SIZE) {
+        size_t lanes = count - base < BATCH_SIZE ? count - base : BATCH_SIZE;
+        for (size_t k = 0; k < lanes; ++k) {
+            states[k] = stateFor(firstNonce + base + k);
+        }
+        HashUtils::meetsDifficultyBatch(states, lanes, difficultyBits, results + base);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef BLOCKHEADER_H
+#define BLOCKHEADER_H
+
+#include <string>
+#include <cstdint>
+#include "hash.h"
+
+// Serialized block header used for proof-of-work. The layout is
+// previousHash | timestamp | merkleRootHash | [extraNonce ':'] | nonce | difficulty
+// and only the nonce digits change between mining attempts, so the fixed prefix is laid
+// out and absorbed into a HashState once; hash(nonce) then only feeds the nonce and
+// difficulty digits and never allocates. The difficulty field is the number of leading
+// zero hex characters, or "<bits>b" when the target is not a whole number of characters.
+class BlockHeader {
+public:
+    BlockHeader(const Digest& previousHash, const std::string& timestamp,
+                const Digest& merkleRootHash, uint64_t extraNonce, int difficultyBits);
+
+    Digest hash(uint64_t nonce) const;
+    // Early-abort proof-of-work check, see HashState::meetsDifficulty
+    bool meetsDifficulty(uint64_t nonce) const;
+    // The same check against another target, e.g. an easier pool share target
+    bool meetsDifficulty(uint64_t nonce, int leadingZeroBits) const;
+    // Checks nonces firstNonce .. firstNonce + count - 1 with the multi-buffer kernel
+    void meetsDifficultyBatch(uint64_t firstNonce, size_t count, bool* results) const;
+
+    static const size_t BATCH_SIZE = 8;
+    std::string serialize(uint64_t nonce) const; // Full header text, for display and tests
+
+private:
+    static const size_t MAX_NONCE_DIGITS = 20;
+
+    std::string prefix;
+    HashState prefixState;
+    int difficultyBits;
+    char difficultyDigits[16];
+    size_t difficultyLength;
+
+    // Writes the decimal nonce right-aligned into buffer, returns the first digit
+    static const char* formatNonce(uint64_t nonce, char* buffer);
+    HashState stateFor(uint64_t nonce) const;
+};
+
+#endif // BLOCKHEADER_H
@@ -0,0 +1,324 @@
+#include "blockStore.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(StoredBlockHeader) == 152, "StoredBlockHeader layout changed");
+static_assert(sizeof(StoredTransaction) == 104, "StoredTransaction layout changed");
+
+namespace {
+
+// Smallest mapping reserved for either file, so early appends do not remap every time
+const uint64_t MIN_MAPPING = 1 << 20;
+
+bool readAt(int fd, uint64_t offset, void* out, size_t length) {
+    uint8_t* target = static_cast<uint8_t*>(out);
+    while (length > 0) {
+        ssize_t got = pread(fd, target, length, static_cast<off_t>(offset));
+        if (got <= 0) {
+            return false;
+        }
+        target += got;
+        offset += static_cast<uint64_t>(got);
+        length -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeAt(int fd, uint64_t offset, const void* data, size_t length) {
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t written = pwrite(fd, source, length, static_cast<off_t>(offset));
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        source += written;
+        offset += static_cast<uint64_t>(written);
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+} // namespace
+
+StoredBlock::StoredBlock(const Block& block) : header() {
+    const auto& blockTransactions = block.getTransactions();
+    const std::string& version = block.getVersion();
+    header.blockID = block.getBlockID();
+    header.previousHash = block.getPreviousHash();
+    header.merkleRoot = block.getMerkleRootHash();
+    header.timestamp = std::stoll(block.getTimestamp());
+    header.nonce = block.getNonce();
+    header.extraNonce = block.getExtraNonce();
+    header.difficultyTarget = block.getDifficulty();
+    header.difficultyBits = block.getDifficultyBits();
+    header.transactionCount = static_cast<uint32_t>(blockTransactions.size());
+    header.versionLength = static_cast<uint32_t>(std::min(version.size(), sizeof(header.version)));
+    std::memcpy(header.version, version.data(), header.versionLength);
+
+    transactions.resize(blockTransactions.size());
+    for (size_t i = 0; i < blockTransactions.size(); ++i) {
+        transactions[i].transactionID = blockTransactions[i].getTransactionID();
+        transactions[i].sender = blockTransactions[i].getSenderPublicKey();
+        transactions[i].receiver = blockTransactions[i].getReceiverPublicKey();
+        transactions[i].amount = blockTransactions[i].getAmount();
+    }
+}
+
+BlockStore::BlockStore()
+    : dataFd(-1), dataSize(0), indexFd(-1), blockCount(0), discarded(0), syncWrites(true) {}
+
+BlockStore::~BlockStore() {
+    close();
+}
+
+// FNV-1a
+uint64_t BlockStore::checksum(const uint8_t* data, size_t length) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+bool BlockStore::open(const std::string& path) {
+    close();
+    dataPath = path;
+    indexPath = path + ".idx";
+    discarded = 0;
+
+    dataFd = ::open(dataPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (dataFd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(dataFd, &info) != 0) {
+        close();
+        return false;
+    }
+    dataSize = static_cast<uint64_t>(info.st_size);
+
+    uint32_t fileHeader[2] = {FILE_MAGIC, FILE_VERSION};
+    if (dataSize < FILE_HEADER_SIZE) {
+        // New (or torn before the first record) store
+        if (ftruncate(dataFd, 0) != 0 || !writeAt(dataFd, 0, fileHeader, sizeof(fileHeader))) {
+            close();
+            return false;
+        }
+        dataSize = FILE_HEADER_SIZE;
+        std::remove(indexPath.c_str());
+    } else {
+        uint32_t existing[2];
+        if (!readAt(dataFd, 0, existing, sizeof(existing)) ||
+            existing[0] != FILE_MAGIC || existing[1] != FILE_VERSION) {
+            close();
+            return false;
+        }
+    }
+
+    // Trust the index up to its last entry if that record checks out; a torn last entry is dropped
+    indexFd = ::open(indexPath.c_str(), O_RDWR | O_CREAT, 0644);
+    if (indexFd < 0 || fstat(indexFd, &info) != 0) {
+        close();
+        return false;
+    }
+    size_t indexed = static_cast<size_t>(static_cast<uint64_t>(info.st_size) / sizeof(uint64_t));
+    uint64_t end = FILE_HEADER_SIZE;
+    uint64_t last = 0, next = 0;
+    if (indexed > 0) {
+        if (readAt(indexFd, (indexed - 1) * sizeof(uint64_t), &last, sizeof(last)) && recordValid(last, next)) {
+            end = next;
+        } else {
+            indexed = 0;
+        }
+    }
+
+    // Pick up records written after the last index entry, stop at the first torn one
+    std::vector<uint64_t> found;
+    end = scan(end, found);
+    uint64_t indexBytes = indexed * sizeof(uint64_t);
+    if (ftruncate(indexFd, static_cast<off_t>(indexBytes)) != 0 ||
+        !writeAt(indexFd, indexBytes, found.data(), found.size() * sizeof(uint64_t)) ||
+        (!found.empty() && syncWrites && fdatasync(indexFd) != 0)) {
+        close();
+        return false;
+    }
+    blockCount = indexed + found.size();
+
+    if (end < dataSize) {
+        discarded = dataSize - end;
+        if (ftruncate(dataFd, static_cast<off_t>(end)) != 0) {
+            close();
+            return false;
+        }
+        dataSize = end;
+    }
+
+    if (!mapAtLeast(data, dataFd, dataSize) || !mapAtLeast(index, indexFd, blockCount * sizeof(uint64_t))) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void BlockStore::close() {
+    unmap(data);
+    unmap(index);
+    if (indexFd >= 0) {
+        ::close(indexFd);
+        indexFd = -1;
+    }
+    if (dataFd >= 0) {
+        ::close(dataFd);
+        dataFd = -1;
+    }
+    blockCount = 0;
+    dataSize = 0;
+}
+
+bool BlockStore::readRecordHeader(uint64_t offset, RecordHeader& header) const {
+    if (offset + sizeof(RecordHeader) > dataSize || !readAt(dataFd, offset, &header, sizeof(header))) {
+        return false;
+    }
+    return header.magic == RECORD_MAGIC && header.length >= sizeof(StoredBlockHeader) &&
+           offset + sizeof(RecordHeader) + header.length <= dataSize;
+}
+
+bool BlockStore::recordValid(uint64_t offset, uint64_t& next) const {
+    RecordHeader header;
+    if (offset < FILE_HEADER_SIZE || !readRecordHeader(offset, header)) {
+        return false;
+    }
+    std::vector<uint8_t> payload(header.length);
+    if (!readAt(dataFd, offset + sizeof(RecordHeader), payload.data(), payload.size()) ||
+        checksum(payload.data(), payload.size()) != header.checksum) {
+        return false;
+    }
+    StoredBlockHeader stored;
+    std::memcpy(&stored, payload.data(), sizeof(stored));
+    if (header.length != sizeof(StoredBlockHeader) + stored.transactionCount * sizeof(StoredTransaction)) {
+        return false;
+    }
+    next = offset + sizeof(RecordHeader) + header.length;
+    return true;
+}
+
+// Collects the offsets of all consecutive valid records from `offset` on, returns where they end
+uint64_t BlockStore::scan(uint64_t offset, std::vector<uint64_t>& found) const {
+    uint64_t next = 0;
+    while (offset < dataSize && recordValid(offset, next)) {
+        found.push_back(offset);
+        offset = next;
+    }
+    return offset;
+}
+
+bool BlockStore::append(const Block& block) {
+    static Metrics::Histogram& latency = Metrics::instance().histogram(
+        "blockstore_append_seconds", "Time to append one block to the block store", Metrics::latencyBuckets());
+    if (!isOpen()) {
+        return false;
+    }
+    auto start = std::chrono::steady_clock::now();
+    StoredBlock stored(block);
+    const uint8_t* headerBytes = reinterpret_cast<const uint8_t*>(&stored.header);
+    const uint8_t* transactionBytes = reinterpret_cast<const uint8_t*>(stored.transactions.data());
+
+    std::vector<uint8_t> record(sizeof(RecordHeader));
+    record.insert(record.end(), headerBytes, headerBytes + sizeof(stored.header));
+    record.insert(record.end(), transactionBytes,
+                  transactionBytes + stored.transactions.size() * sizeof(StoredTransaction));
+    uint8_t* payload = record.data() + sizeof(RecordHeader);
+
+    RecordHeader header;
+    header.magic = RECORD_MAGIC;
+    header.length = static_cast<uint32_t>(record.size() - sizeof(RecordHeader));
+    header.checksum = checksum(payload, header.length);
+    std::memcpy(record.data(), &header, sizeof(header));
+
+    // Data before index: an index entry never points at a record that is not on disk.
+    // Anything written by a failed append is cut off again, so dataSize, the files and
+    // blockCount stay in step for the next one.
+    uint64_t offset = dataSize;
+    uint64_t indexOffset = blockCount * sizeof(uint64_t);
+    bool written = writeAt(dataFd, offset, record.data(), record.size()) &&
+                   (!syncWrites || fdatasync(dataFd) == 0) && mapAtLeast(data, dataFd, offset + record.size()) &&
+                   writeAt(indexFd, indexOffset, &offset, sizeof(offset)) && (!syncWrites || fdatasync(indexFd) == 0) &&
+                   mapAtLeast(index, indexFd, indexOffset + sizeof(offset));
+    if (!written) {
+        int ignored = ftruncate(dataFd, static_cast<off_t>(offset));
+        ignored = ftruncate(indexFd, static_cast<off_t>(indexOffset));
+        (void)ignored;
+        return false;
+    }
+    dataSize = offset + record.size();
+    blockCount++;
+    latency.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    return true;
+}
+
+// Maps at least `size` bytes of a file. The mapping is reserved with room to grow, so
+// appends rarely replace it; pages past the end of the file are never read. A replaced
+// mapping stays until close(), as readers may still hold pointers into it.
+bool BlockStore::mapAtLeast(Mapping& mapping, int fd, uint64_t size) {
+    if (mapping.base.load(std::memory_order_relaxed) != nullptr && mapping.size >= size) {
+        return true;
+    }
+    uint64_t reserve = std::max(size, std::max<uint64_t>(mapping.size * 2, MIN_MAPPING));
+    void* address = mmap(nullptr, reserve, PROT_READ, MAP_SHARED, fd, 0);
+    if (address == MAP_FAILED) {
+        return false;
+    }
+    const uint8_t* previous = mapping.base.load(std::memory_order_relaxed);
+    if (previous != nullptr) {
+        mapping.retired.emplace_back(const_cast<uint8_t*>(previous), mapping.size);
+    }
+    mapping.base.store(static_cast<const uint8_t*>(address), std::memory_order_release);
+    mapping.size = reserve;
+    return true;
+}
+
+void BlockStore::unmap(Mapping& mapping) {
+    const uint8_t* base = mapping.base.exchange(nullptr);
+    if (base != nullptr) {
+        munmap(const_cast<uint8_t*>(base), mapping.size);
+    }
+    for (const auto& old : mapping.retired) {
+        munmap(old.first, old.second);
+    }
+    mapping.retired.clear();
+    mapping.size = 0;
+}
+
+BlockView BlockStore::view(size_t height) const {
+    const uint64_t* offsets = reinterpret_cast<const uint64_t*>(index.base.load(std::memory_order_acquire));
+    const uint8_t* payload = data.base.load(std::memory_order_acquire) + offsets[height] + sizeof(RecordHeader);
+    return BlockView(reinterpret_cast<const StoredBlockHeader*>(payload),
+                     reinterpret_cast<const StoredTransaction*>(payload + sizeof(StoredBlockHeader)));
+}
+
+Block BlockStore::load(size_t height) const {
+    BlockView stored = view(height);
+    const StoredBlockHeader& header = stored.header();
+
+    std::vector<Transaction> transactions;
+    transactions.reserve(stored.transactionCount());
+    for (size_t i = 0; i < stored.transactionCount(); ++i) {
+        const StoredTransaction& tx = stored.transaction(i);
+        transactions.emplace_back(tx.transactionID, tx.sender, tx.receiver, static_cast<int>(tx.amount));
+    }
+    return Block::restore(header.blockID, header.previousHash, header.merkleRoot,
+                          std::to_string(header.timestamp), header.nonce, header.extraNonce,
+                          header.difficultyBits, std::string(header.version, header.versionLength),
+                          transactions);
+}
@@ -0,0 +1,146 @@
+#ifndef BLOCKSTORE_H
+#define BLOCKSTORE_H
+
+#include <string>
+#include <vector>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+#include "digest.h"
+#include "block.h"
+
+// On-disk layout of one block. Hashes are stored as packed digests and every field is
+// naturally aligned, so a mapped record can be read in place without parsing.
+struct StoredBlockHeader {
+    Digest blockID;
+    Digest previousHash;
+    Digest merkleRoot;
+    int64_t timestamp;
+    uint64_t nonce;
+    uint64_t extraNonce;
+    int32_t difficultyTarget;
+    int32_t difficultyBits;
+    uint32_t transactionCount;
+    uint32_t versionLength;
+    char version[16];
+};
+
+struct StoredTransaction {
+    Digest transactionID;
+    Digest sender;
+    Digest receiver;
+    int64_t amount;
+};
+
+// Zero-copy view of a stored block. It points into the mapped file and stays valid until
+// the store is closed, or into a StoredBlock and stays valid as long as that block.
+class BlockView {
+public:
+    BlockView(const StoredBlockHeader* header, const StoredTransaction* transactions)
+        : head(header), txs(transactions) {}
+
+    const StoredBlockHeader& header() const { return *head; }
+    size_t transactionCount() const { return head->transactionCount; }
+    const StoredTransaction& transaction(size_t index) const { return txs[index]; }
+
+private:
+    const StoredBlockHeader* head;
+    const StoredTransaction* txs;
+};
+
+// A block in the stored layout outside of any store, for chains kept in memory only
+struct StoredBlock {
+    StoredBlockHeader header;
+    std::vector<StoredTransaction> transactions;
+
+    explicit StoredBlock(const Block& block);
+    BlockView view() const { return BlockView(&header, transactions.data()); }
+};
+
+// Serves the blocks of one chain by height, e.g. from a BlockStore or a ChainSnapshot
+typedef std::function<BlockView(size_t height)> BlockSource;
+
+// Append-only binary block log.
+//
+// The data file starts with an 8 byte file header, followed by one record per block:
+// [u32 magic][u32 payload length][u64 FNV-1a checksum][StoredBlockHeader][StoredTransaction...].
+// A companion "<path>.idx" file holds the u64 offset of every record. Records are only
+// ever appended: the record is written at the end of the data and synced to disk before
+// its index entry is written and synced, so a crash can at worst leave a partial record
+// at the end or a record without an index entry. An append that fails part way is cut
+// back off both files. Opening the store maps the index, checks the last indexed record
+// and scans only whatever follows it, so it costs the same at any chain length; a torn
+// tail is truncated away. If the index itself is unusable the data file is scanned once
+// and the index rewritten.
+//
+// Reads go through read-only mmaps of both files. A mapping is reserved ahead of its file
+// and replaced when an append outgrows it, but replaced mappings are only released by
+// close(): views stay valid while the store grows, and other threads may call view() for
+// any height they learned of after it was stored (e.g. through a published ChainSnapshot)
+// while one thread appends. open() and append() fail if a file cannot be mapped, so
+// view() always reads mapped memory.
+class BlockStore {
+public:
+    BlockStore();
+    ~BlockStore();
+
+    BlockStore(const BlockStore&) = delete;
+    BlockStore& operator=(const BlockStore&) = delete;
+
+    // Opens or creates the store, returns false if the files cannot be used
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return dataFd >= 0; }
+
+    bool append(const Block& block);
+    // Syncing every append (the default) is what makes the crash guarantees hold;
+    // benchmarks and throwaway stores can turn it off
+    void setSyncWrites(bool sync) { syncWrites = sync; }
+
+    size_t size() const { return blockCount; }
+    BlockView view(size_t height) const;
+    Block load(size_t height) const;
+
+    // Bytes of a torn tail that were cut off while opening
+    uint64_t discardedBytes() const { return discarded; }
+
+private:
+    static const uint32_t FILE_MAGIC = 0x534B4C42; // "BLKS"
+    static const uint32_t FILE_VERSION = 1;
+    static const uint32_t RECORD_MAGIC = 0x4B434C42; // "BLCK"
+    static const uint64_t FILE_HEADER_SIZE = 8;
+
+    struct RecordHeader {
+        uint32_t magic;
+        uint32_t length;
+        uint64_t checksum;
+    };
+
+    // Read-only mapping of one of the files; readers load `base` while append() may replace it
+    struct Mapping {
+        std::atomic<const uint8_t*> base{nullptr};
+        uint64_t size = 0;                               // Reserved length
+        std::vector<std::pair<void*, uint64_t>> retired; // Replaced mappings, released by close()
+    };
+
+    std::string dataPath;
+    std::string indexPath;
+    int dataFd;
+    uint64_t dataSize;
+    int indexFd;
+    size_t blockCount;
+    uint64_t discarded;
+    bool syncWrites;
+
+    Mapping data;
+    Mapping index; // The u64 record offsets
+
+    static uint64_t checksum(const uint8_t* data, size_t length);
+    bool readRecordHeader(uint64_t offset, RecordHeader& header) const;
+    bool recordValid(uint64_t offset, uint64_t& next) const;
+    uint64_t scan(uint64_t offset, std::vector<uint64_t>& found) const;
+    static bool mapAtLeast(Mapping& mapping, int fd, uint64_t size);
+    static void unmap(Mapping& mapping);
+};
+
+#endif // BLOCKSTORE_H
@@ -0,0 +1,119 @@
+#include "blockValidator.h"
+#include "hash.h"
+#include <algorithm>
+#include <string>
+#include <omp.h>
+
+namespace {
+
+// Transaction IDs handed to the multi-buffer hash at a time
+const size_t HASH_BATCH = 8;
+
+} // namespace
+
+BlockValidator::BlockValidator(int threadCount)
+    : threadCount(threadCount > 0 ? threadCount : omp_get_max_threads()) {}
+
+std::vector<char> BlockValidator::verifyTransactionIds(const std::vector<Transaction>& transactions) const {
+    std::vector<char> valid(transactions.size(), 0);
+    long batches = static_cast<long>((transactions.size() + HASH_BATCH - 1) / HASH_BATCH);
+
+    #pragma omp parallel for schedule(static) num_threads(threadCount)
+    for (long b = 0; b < batches; ++b) {
+        size_t first = static_cast<size_t>(b) * HASH_BATCH;
+        size_t count = std::min(HASH_BATCH, transactions.size() - first);
+        HashState states[HASH_BATCH];
+        Digest digests[HASH_BATCH];
+        char hex[Digest::HEX_LENGTH];
+        for (size_t k = 0; k < count; ++k) {
+            const Transaction& transaction = transactions[first + k];
+            states[k] = HashState();
+            transaction.getSenderPublicKey().writeHex(hex); // IDs hash the hex form of both keys
+            states[k].update(hex, sizeof(hex));
+            transaction.getReceiverPublicKey().writeHex(hex);
+            states[k].update(hex, sizeof(hex));
+            states[k].update(std::to_string(transaction.getAmount()));
+        }
+        HashUtils::processHashBatch(states, count, digests);
+        for (size_t k = 0; k < count; ++k) {
+            valid[first + k] = transactions[first + k].getTransactionID() == digests[k];
+        }
+    }
+    return valid;
+}
+
+BlockValidator::Result BlockValidator::applyTransactions(const std::vector<Transaction>& transactions,
+                                                         AccountState& accounts,
+                                                         const std::vector<char>* idValid) const {
+    Result result;
+    size_t count = transactions.size();
+    result.accepted.assign(count, 0);
+
+    // Account lookups are read-only, so they run in parallel
+    std::vector<int64_t> senders(count), receivers(count);
+    #pragma omp parallel for schedule(static) num_threads(threadCount)
+    for (long i = 0; i < static_cast<long>(count); ++i) {
+        senders[i] = accounts.findAccount(transactions[i].getSenderPublicKey());
+        receivers[i] = accounts.findAccount(transactions[i].getReceiverPublicKey());
+    }
+
+    // Wave of each transaction: one after the last wave that touched either account
+    std::vector<uint32_t> wave(count, 0);
+    std::vector<uint32_t> lastWave(accounts.size(), 0);
+    uint32_t waveCount = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (idValid && !(*idValid)[i]) {
+            result.invalidIds++;
+            continue;
+        }
+        if (senders[i] == AccountState::NOT_FOUND || receivers[i] == AccountState::NOT_FOUND) {
+            result.unknownAccounts++;
+            continue;
+        }
+        uint32_t w = std::max(lastWave[senders[i]], lastWave[receivers[i]]) + 1;
+        wave[i] = w;
+        lastWave[senders[i]] = w;
+        lastWave[receivers[i]] = w;
+        waveCount = std::max(waveCount, w);
+    }
+    result.waves = waveCount;
+
+    // Counting sort into waves, keeping block order within a wave
+    std::vector<size_t> waveStart(waveCount + 2, 0);
+    for (size_t i = 0; i < count; ++i) {
+        if (wave[i] > 0) waveStart[wave[i] + 1]++;
+    }
+    for (uint32_t w = 1; w <= waveCount; ++w) {
+        waveStart[w + 1] += waveStart[w];
+    }
+    std::vector<size_t> order(waveStart[waveCount + 1]);
+    std::vector<size_t> fill(waveStart.begin(), waveStart.end());
+    for (size_t i = 0; i < count; ++i) {
+        if (wave[i] > 0) order[fill[wave[i]]++] = i;
+    }
+
+    size_t insufficient = 0;
+    for (uint32_t w = 1; w <= waveCount; ++w) {
+        long begin = static_cast<long>(waveStart[w]);
+        long end = static_cast<long>(waveStart[w + 1]);
+        #pragma omp parallel for schedule(static) num_threads(threadCount) reduction(+:insufficient) if (end - begin > 64)
+        for (long k = begin; k < end; ++k) {
+            size_t i = order[k];
+            int64_t amount = transactions[i].getAmount();
+            if (accounts.getBalance(senders[i]) >= amount) {
+                accounts.updateBalance(senders[i], -amount);
+                accounts.updateBalance(receivers[i], amount);
+                result.accepted[i] = 1;
+            } else {
+                insufficient++;
+            }
+        }
+    }
+    result.insufficientBalance = insufficient;
+    return result;
+}
+
+BlockValidator::Result BlockValidator::validateBlock(const Block& block, AccountState& accounts) const {
+    std::vector<char> idValid = verifyTransactionIds(block.getTransactions());
+    return applyTransactions(block.getTransactions(), accounts, &idValid);
+}
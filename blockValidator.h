@@ -0,0 +1,46 @@
+#ifndef BLOCKVALIDATOR_H
+#define BLOCKVALIDATOR_H
+
+#include <vector>
+#include <cstdint>
+#include "transactions.h"
+#include "accountState.h"
+#include "block.h"
+
+// Parallel transaction validation, used both while assembling blocks and for blocks
+// received from elsewhere.
+//
+// Transaction IDs are re-derived on all cores. Balance changes are then scheduled in
+// waves: a transaction goes into the wave after the last one that touched its sender
+// or receiver, so no two transactions in a wave share an account and every account
+// still sees its transactions in block order. Waves run one after another, each in
+// parallel, which gives exactly the result of applying the block serially.
+class BlockValidator {
+public:
+    struct Result {
+        std::vector<char> accepted; // Per transaction, in block order
+        size_t invalidIds = 0;
+        size_t unknownAccounts = 0;
+        size_t insufficientBalance = 0;
+        size_t waves = 0;
+    };
+
+    explicit BlockValidator(int threadCount = 0); // 0 uses all available OpenMP threads
+
+    // True where hash(sender + receiver + amount) matches the transaction ID
+    std::vector<char> verifyTransactionIds(const std::vector<Transaction>& transactions) const;
+
+    // Applies the transactions to `accounts` as a serial pass would: a transaction is
+    // accepted when its ID is valid (if idValid is given), both accounts exist and the
+    // sender can pay at that point in the block
+    Result applyTransactions(const std::vector<Transaction>& transactions, AccountState& accounts,
+                             const std::vector<char>* idValid = nullptr) const;
+
+    // Both steps for a whole block
+    Result validateBlock(const Block& block, AccountState& accounts) const;
+
+private:
+    int threadCount;
+};
+
+#endif // BLOCKVALIDATOR_H
@@ -0,0 +1,100 @@
+#include "chainIndex.h"
+#include <omp.h>
+
+ChainIndex::ChainIndex(int threadCount)
+    : threadCount(threadCount > 0 ? threadCount : omp_get_max_threads()), runs(this->threadCount), rebuilt(false) {}
+
+bool ChainIndex::open(const std::string& path, const BlockStore& store) {
+    rebuilt = false;
+    if (runs.open(path, RUNS_TAG)) {
+        // The runs describe a prefix of this store if their last block is in it
+        std::shared_ptr<const IndexRuns::View> opened = runs.view();
+        size_t indexed = opened->blockCount();
+        if (indexed <= store.size() && (indexed == 0 || store.view(indexed - 1).header().blockID == opened->tip())) {
+            return catchUp(store);
+        }
+    }
+
+    // Missing, damaged or belongs to another chain: regenerate from the store
+    rebuilt = true;
+    runs.clear();
+    return catchUp(store);
+}
+
+// Entries for blocks [firstHeight, endHeight), laid out in chain order
+void ChainIndex::collectEntries(const BlockSource& blocks, size_t firstHeight, size_t endHeight,
+                                std::vector<IndexEntry>& entries) const {
+    size_t count = endHeight - firstHeight;
+    std::vector<size_t> start(count + 1, 0);
+    for (size_t i = 0; i < count; ++i) {
+        start[i + 1] = start[i] + 2 + blocks(firstHeight + i).transactionCount();
+    }
+    entries.resize(start[count]);
+
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(threadCount)
+    for (long long i = 0; i < static_cast<long long>(count); ++i) {
+        uint32_t height = static_cast<uint32_t>(firstHeight + i);
+        BlockView block = blocks(height);
+        IndexEntry* target = &entries[start[i]];
+        target[0] = IndexRuns::makeEntry(block.header().blockID, BLOCK_ID, height, 0);
+        target[1] = IndexRuns::makeEntry(block.header().merkleRoot, MERKLE_ROOT, height, 0);
+        for (size_t t = 0; t < block.transactionCount(); ++t) {
+            target[2 + t] = IndexRuns::makeEntry(block.transaction(t).transactionID, TRANSACTION, height,
+                                                 static_cast<uint32_t>(t));
+        }
+    }
+}
+
+bool ChainIndex::catchUp(const BlockStore& store) {
+    return catchUp([&store](size_t height) { return store.view(height); }, store.size());
+}
+
+bool ChainIndex::catchUp(const BlockSource& blocks, size_t endHeight) {
+    size_t firstHeight = runs.blockCount();
+    if (endHeight <= firstHeight) {
+        return true;
+    }
+    std::vector<IndexEntry> entries;
+    collectEntries(blocks, firstHeight, endHeight, entries);
+    return runs.add(entries, nullptr, endHeight, blocks(endHeight - 1).header().blockID);
+}
+
+void ChainIndex::close() {
+    runs.close();
+}
+
+ChainIndex::View ChainIndex::view() const {
+    View current;
+    current.runs = runs.view();
+    return current;
+}
+
+int64_t ChainIndex::View::findHeight(uint32_t kind, const Digest& key) const {
+    IndexEntry entry;
+    if (!runs || !runs->findFirst(kind, key, entry)) {
+        return NOT_FOUND;
+    }
+    return static_cast<int64_t>(entry.height);
+}
+
+int64_t ChainIndex::View::findBlock(const Digest& blockID) const {
+    return findHeight(BLOCK_ID, blockID);
+}
+
+int64_t ChainIndex::View::findBlockByMerkleRoot(const Digest& merkleRoot) const {
+    return findHeight(MERKLE_ROOT, merkleRoot);
+}
+
+bool ChainIndex::View::findTransaction(const Digest& transactionID, TransactionLocation& location) const {
+    IndexEntry entry;
+    if (!runs || !runs->findFirst(TRANSACTION, transactionID, entry)) {
+        return false;
+    }
+    location.height = entry.height;
+    location.position = entry.position;
+    return true;
+}
+
+size_t ChainIndex::View::transactionCount() const {
+    return runs ? runs->count(TRANSACTION) : 0;
+}
@@ -0,0 +1,94 @@
+#ifndef CHAININDEX_H
+#define CHAININDEX_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "digest.h"
+#include "blockStore.h"
+#include "indexRuns.h"
+
+// Lookup indexes over one chain: block ID -> height, Merkle root -> height and
+// transaction ID -> (height, position in block).
+//
+// The entries live in IndexRuns: catchUp() adds the entries of the new blocks as one more
+// immutable run and publishes a View of all runs, so lookups on any number of threads
+// never wait for the thread extending the index, and a View keeps answering for the
+// blocks it was taken at. With a path the runs are files next to the store: open() reads
+// their list and checks that its last block is in the store, which costs the same at any
+// chain length, then indexes whatever the store has beyond it. If the runs are missing,
+// damaged or belong to another chain, all entries are regenerated from the mapped store
+// on all cores. A ChainIndex that is never opened is kept in memory and fed through a
+// BlockSource, e.g. by a ChainPublisher whose chain has no store.
+//
+// When a key occurs more than once (e.g. the Merkle root of empty blocks) the lowest
+// height wins, matching a front-to-back scan of the chain.
+class ChainIndex {
+public:
+    static const int64_t NOT_FOUND = -1;
+
+    struct TransactionLocation {
+        uint32_t height;
+        uint32_t position;
+    };
+
+    // The index as of one catchUp(); cheap to copy
+    class View {
+    public:
+        int64_t findBlock(const Digest& blockID) const;
+        int64_t findBlockByMerkleRoot(const Digest& merkleRoot) const;
+        bool findTransaction(const Digest& transactionID, TransactionLocation& location) const;
+
+        size_t blockCount() const { return runs ? runs->blockCount() : 0; }
+        size_t transactionCount() const;
+
+    private:
+        std::shared_ptr<const IndexRuns::View> runs;
+
+        int64_t findHeight(uint32_t kind, const Digest& key) const;
+
+        friend class ChainIndex;
+    };
+
+    explicit ChainIndex(int threadCount = 0); // 0 uses all available OpenMP threads
+
+    // Opens or rebuilds the indexes for `store`; false if they cannot be written
+    bool open(const std::string& path, const BlockStore& store);
+
+    // Indexes blocks appended to the store since the last call
+    bool catchUp(const BlockStore& store);
+    // Indexes blocks [blockCount(), endHeight), read through `blocks` from any thread
+    bool catchUp(const BlockSource& blocks, size_t endHeight);
+    // Stops writing the index files; lookups keep working on what was indexed
+    void close();
+    // Syncing the runs (the default) keeps a crash from costing a rebuild; benchmarks and
+    // throwaway indexes can turn it off
+    void setSyncWrites(bool sync) { runs.setSyncWrites(sync); }
+
+    View view() const;
+    // Lookups in the newest view
+    int64_t findBlock(const Digest& blockID) const { return view().findBlock(blockID); }
+    int64_t findBlockByMerkleRoot(const Digest& merkleRoot) const { return view().findBlockByMerkleRoot(merkleRoot); }
+    bool findTransaction(const Digest& transactionID, TransactionLocation& location) const {
+        return view().findTransaction(transactionID, location);
+    }
+
+    size_t blockCount() const { return runs.blockCount(); }
+    size_t transactionCount() const { return view().transactionCount(); }
+    bool wasRebuilt() const { return rebuilt; }
+
+private:
+    enum Kind : uint32_t { BLOCK_ID = 0, MERKLE_ROOT = 1, TRANSACTION = 2 };
+
+    static const uint64_t RUNS_TAG = 1; // Changes whenever the entries change meaning
+
+    int threadCount;
+    IndexRuns runs;
+    bool rebuilt;
+
+    void collectEntries(const BlockSource& blocks, size_t firstHeight, size_t endHeight,
+                        std::vector<IndexEntry>& entries) const;
+};
+
+#endif // CHAININDEX_H
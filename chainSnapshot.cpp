@@ -0,0 +1,85 @@
+#include "chainSnapshot.h"
+#include <atomic>
+
+BlockView ChainSnapshot::block(size_t height) const {
+    if (store != nullptr) {
+        return store->view(height);
+    }
+    return (*chunks[height / CHUNK_BLOCKS])[height % CHUNK_BLOCKS]->view();
+}
+
+int64_t ChainSnapshot::findBlock(const Digest& blockID) const {
+    int64_t height = chainView.findBlock(blockID);
+    return height < static_cast<int64_t>(blockCount) ? height : ChainIndex::NOT_FOUND;
+}
+
+int64_t ChainSnapshot::findBlockByMerkleRoot(const Digest& merkleRoot) const {
+    int64_t height = chainView.findBlockByMerkleRoot(merkleRoot);
+    return height < static_cast<int64_t>(blockCount) ? height : ChainIndex::NOT_FOUND;
+}
+
+bool ChainSnapshot::findTransaction(const Digest& transactionID, ChainIndex::TransactionLocation& location) const {
+    return chainView.findTransaction(transactionID, location) && location.height < blockCount;
+}
+
+std::vector<AddressIndex::TransactionRef> ChainSnapshot::history(const Digest& address,
+                                                                 AddressIndex::QueryStats* queryStats) const {
+    return addressView.history(address, blockCount, [this](size_t h) { return block(h); }, queryStats);
+}
+
+ChainPublisher::ChainPublisher(const AccountState& accounts, const BlockStore* store, const ChainIndex* chainIndex,
+                               const AddressIndex* addressIndex)
+    : accountTable(std::make_shared<const AccountState>(accounts)), store(store), chainIndex(chainIndex),
+      addressIndex(addressIndex), appended(0) {
+    if (chainIndex == nullptr) {
+        ownIndex.reset(new ChainIndex());
+    }
+    publish(accounts.getBalances());
+}
+
+void ChainPublisher::append(const Block& block) {
+    if (store != nullptr) {
+        return;
+    }
+    size_t height = appended;
+    if (height % ChainSnapshot::CHUNK_BLOCKS == 0) {
+        chunks.push_back(std::make_shared<ChainSnapshot::Chunk>());
+    }
+    // Slots past a snapshot's block count are never read through it, so filling one in
+    // the shared last chunk does not disturb published snapshots
+    (*chunks.back())[height % ChainSnapshot::CHUNK_BLOCKS] = std::make_shared<const StoredBlock>(block);
+    appended++;
+}
+
+void ChainPublisher::publish(const std::vector<int64_t>& balances) {
+    if (ownIndex) {
+        ownIndex->catchUp([this](size_t height) { return block(height); }, blockCount());
+    }
+    auto snapshot = std::make_shared<ChainSnapshot>();
+    snapshot->blockCount = blockCount();
+    snapshot->store = store;
+    snapshot->chunks = chunks;
+    snapshot->balances = std::make_shared<const std::vector<int64_t>>(balances);
+    snapshot->accountTable = accountTable;
+    snapshot->chainView = ownIndex ? ownIndex->view() : chainIndex->view();
+    if (addressIndex != nullptr) {
+        snapshot->addressView = addressIndex->view();
+        snapshot->addressIndexed = true;
+    }
+    std::atomic_store(&published, std::shared_ptr<const ChainSnapshot>(snapshot));
+}
+
+size_t ChainPublisher::blockCount() const {
+    return store != nullptr ? store->size() : appended;
+}
+
+BlockView ChainPublisher::block(size_t height) const {
+    if (store != nullptr) {
+        return store->view(height);
+    }
+    return (*chunks[height / ChainSnapshot::CHUNK_BLOCKS])[height % ChainSnapshot::CHUNK_BLOCKS]->view();
+}
+
+std::shared_ptr<const ChainSnapshot> ChainPublisher::current() const {
+    return std::atomic_load(&published);
+}
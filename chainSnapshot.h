@@ -0,0 +1,98 @@
+#ifndef CHAINSNAPSHOT_H
+#define CHAINSNAPSHOT_H
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <cstdint>
+#include "block.h"
+#include "blockStore.h"
+#include "accountState.h"
+#include "chainIndex.h"
+#include "addressIndex.h"
+
+// Read-only view of the chain at one height, for query threads.
+//
+// A snapshot is never modified after it is published, so any number of threads can use
+// it without locks while mining goes on. Blocks are read from the BlockStore the chain is
+// persisted in, whose records stay mapped while it grows, so nothing is copied per block
+// and nothing is loaded when a stored chain is resumed. A chain kept in memory only sits
+// in fixed-size chunks of StoredBlocks shared between snapshots: a newer snapshot only
+// adds blocks past the count an older one can see. Balances are the copy made when the
+// newest block was assembled. Account numbers, keys and names come from an AccountState
+// that is fixed for the lifetime of the publisher. Lookups by hash and address run on the
+// ChainIndex and AddressIndex views taken when the snapshot was published, so they need
+// no locks either; anything found at or above height() is not visible in this snapshot.
+class ChainSnapshot {
+public:
+    size_t height() const { return blockCount; } // Number of blocks visible
+    BlockView block(size_t height) const;
+
+    const AccountState& accounts() const { return *accountTable; }
+    int64_t balance(size_t account) const { return (*balances)[account]; }
+
+    // ChainIndex::NOT_FOUND / false for anything not in this snapshot's blocks
+    int64_t findBlock(const Digest& blockID) const;
+    int64_t findBlockByMerkleRoot(const Digest& merkleRoot) const;
+    bool findTransaction(const Digest& transactionID, ChainIndex::TransactionLocation& location) const;
+
+    // Address history needs the publisher to have an AddressIndex
+    bool hasAddressIndex() const { return addressIndexed; }
+    std::vector<AddressIndex::TransactionRef> history(const Digest& address,
+                                                      AddressIndex::QueryStats* queryStats = nullptr) const;
+
+private:
+    static const size_t CHUNK_BLOCKS = 256;
+
+    typedef std::array<std::shared_ptr<const StoredBlock>, CHUNK_BLOCKS> Chunk;
+
+    size_t blockCount = 0;
+    const BlockStore* store = nullptr;          // Serves every block when set
+    std::vector<std::shared_ptr<Chunk>> chunks; // Otherwise
+    std::shared_ptr<const std::vector<int64_t>> balances;
+    std::shared_ptr<const AccountState> accountTable;
+    ChainIndex::View chainView;
+    AddressIndex::View addressView;
+    bool addressIndexed = false;
+
+    friend class ChainPublisher;
+};
+
+// Single writer side of ChainSnapshot: blocks are appended as they are persisted and a new
+// snapshot is published with the balances as of the last one. Readers pick up the newest
+// snapshot with current(), an atomic shared_ptr load that never waits for the writer.
+// Without a ChainIndex of the caller's, the publisher keeps one in memory and extends it
+// on every publish(), so hash lookups work for any chain, stored or not.
+class ChainPublisher {
+public:
+    // Balances passed to publish() must be numbered like `accounts`. With a store, the
+    // chain is whatever the store holds when publish() is called and append() is not
+    // needed. The caller extends `chainIndex` and `addressIndex` to the chain before every
+    // publish(). The store and indexes must outlive the publisher and every snapshot.
+    explicit ChainPublisher(const AccountState& accounts, const BlockStore* store = nullptr,
+                            const ChainIndex* chainIndex = nullptr, const AddressIndex* addressIndex = nullptr);
+
+    ChainPublisher(const ChainPublisher&) = delete;
+    ChainPublisher& operator=(const ChainPublisher&) = delete;
+
+    void append(const Block& block); // Not visible until the next publish()
+    void publish(const std::vector<int64_t>& balances);
+
+    // Writer side: every block so far, published or not
+    size_t blockCount() const;
+    BlockView block(size_t height) const;
+
+    std::shared_ptr<const ChainSnapshot> current() const;
+
+private:
+    std::shared_ptr<const ChainSnapshot> published;
+    std::shared_ptr<const AccountState> accountTable;
+    const BlockStore* store;
+    const ChainIndex* chainIndex;
+    const AddressIndex* addressIndex;
+    std::unique_ptr<ChainIndex> ownIndex; // When the caller has no ChainIndex
+    std::vector<std::shared_ptr<ChainSnapshot::Chunk>> chunks;
+    size_t appended;
+};
+
+#endif // CHAINSNAPSHOT_H
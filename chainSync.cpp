@@ -0,0 +1,573 @@
+#include "chainSync.h"
+#include "blockValidator.h"
+#include "chainVerifier.h"
+#include "metrics.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <omp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t MAX_REQUEST_BYTES = 256;          // A longer line without a newline closes the connection
+const uint64_t MAX_HEADERS_PER_RESPONSE = 65536;
+const uint64_t MAX_BODIES_PER_RESPONSE = 4096;
+const uint32_t MAX_TRANSACTIONS_PER_BLOCK = 1 << 20;
+const int PEER_TIMEOUT_SECONDS = 10;           // A peer that stalls this long is given up on
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+bool readAll(int fd, void* out, size_t length) {
+    uint8_t* target = static_cast<uint8_t*>(out);
+    while (length > 0) {
+        ssize_t got = ::read(fd, target, length);
+        if (got < 0 && errno == EINTR) {
+            continue;
+        }
+        if (got <= 0) {
+            return false;
+        }
+        target += got;
+        length -= static_cast<size_t>(got);
+    }
+    return true;
+}
+
+bool writeAll(int fd, const void* data, size_t length) {
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t written = ::send(fd, source, length, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        source += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+template <typename T>
+void appendRaw(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool unixAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+// Blocking client connection with a receive timeout, -1 on failure
+int connectPeer(const std::string& path) {
+    sockaddr_un address;
+    if (!unixAddress(path, address)) {
+        return -1;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    timeval timeout = {PEER_TIMEOUT_SECONDS, 0};
+    ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+bool request(int fd, const std::string& line) {
+    std::string text = line + "\n";
+    return writeAll(fd, text.data(), text.size());
+}
+
+} // namespace
+
+SyncPeer::SyncPeer(const BlockStore& store) : SyncPeer(store, Config()) {}
+
+SyncPeer::SyncPeer(const BlockStore& store, const Config& config)
+    : store(store), config(config), work(0), listener(-1) {
+    this->config.height = std::min(config.height, store.size());
+    work = ChainVerifier::chainWork(store, this->config.height);
+}
+
+SyncPeer::~SyncPeer() {
+    stop();
+}
+
+bool SyncPeer::listen(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!unixAddress(socketPath, address)) {
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    ::unlink(socketPath.c_str()); // Left behind by a run that did not shut down cleanly
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return false;
+    }
+    listener = fd;
+    path = socketPath;
+    return true;
+}
+
+bool SyncPeer::start() {
+    if (listener < 0 || acceptor.joinable()) {
+        return false;
+    }
+    acceptor = std::thread([this] {
+        while (true) {
+            int fd = ::accept4(listener, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                return; // The listener was shut down
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            connections.emplace_back(fd, std::thread());
+            connections.back().second = std::thread(&SyncPeer::serve, this, fd);
+        }
+    });
+    return true;
+}
+
+void SyncPeer::stop() {
+    if (listener >= 0) {
+        ::shutdown(listener, SHUT_RDWR);
+    }
+    if (acceptor.joinable()) {
+        acceptor.join();
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (auto& connection : connections) {
+            if (connection.first >= 0) {
+                ::shutdown(connection.first, SHUT_RDWR);
+            }
+        }
+    }
+    for (auto& connection : connections) {
+        if (connection.second.joinable()) {
+            connection.second.join();
+        }
+    }
+    connections.clear();
+    if (listener >= 0) {
+        ::close(listener);
+        listener = -1;
+        ::unlink(path.c_str());
+    }
+}
+
+void SyncPeer::throttle(size_t bytes) {
+    Clock::time_point ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Clock::time_point start = std::max(Clock::now(), uploadFreeAt);
+        uploadFreeAt = config.bytesPerSecond > 0
+            ? start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(bytes / config.bytesPerSecond))
+            : start;
+        ready = uploadFreeAt;
+    }
+    ready += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.latencySeconds));
+    std::this_thread::sleep_until(ready);
+}
+
+void SyncPeer::serve(int fd) {
+    static Metrics::Counter& served = Metrics::instance().counter("sync_peer_requests_total",
+                                                                  "Requests answered by sync peers");
+    std::string input, response;
+    char buffer[4096];
+    while (true) {
+        size_t newline = input.find('\n');
+        if (newline == std::string::npos) {
+            if (input.size() > MAX_REQUEST_BYTES) {
+                break;
+            }
+            ssize_t got = ::read(fd, buffer, sizeof(buffer));
+            if (got < 0 && errno == EINTR) {
+                continue;
+            }
+            if (got <= 0) {
+                break;
+            }
+            input.append(buffer, static_cast<size_t>(got));
+            continue;
+        }
+        std::istringstream line(input.substr(0, newline));
+        input.erase(0, newline + 1);
+        std::string command;
+        uint64_t from = 0, count = 0;
+        line >> command;
+        response.clear();
+        if (command == "HEIGHT") {
+            appendRaw(response, static_cast<uint64_t>(config.height));
+        } else if (command == "WORK") {
+            appendRaw(response, static_cast<uint64_t>(config.height));
+            appendRaw(response, work);
+        } else if ((command == "HEADERS" || command == "BODIES") && (line >> from >> count)) {
+            uint64_t limit = command == "HEADERS" ? MAX_HEADERS_PER_RESPONSE : MAX_BODIES_PER_RESPONSE;
+            uint64_t end = from < config.height ? from + std::min({count, limit, config.height - from}) : from;
+            appendRaw(response, static_cast<uint32_t>(end - from));
+            for (uint64_t height = from; height < end; ++height) {
+                BlockView block = store.view(height);
+                if (command == "HEADERS") {
+                    appendRaw(response, block.header());
+                } else {
+                    appendRaw(response, static_cast<uint32_t>(block.transactionCount()));
+                    if (block.transactionCount() > 0) {
+                        response.append(reinterpret_cast<const char*>(&block.transaction(0)),
+                                        block.transactionCount() * sizeof(StoredTransaction));
+                    }
+                }
+            }
+        } else {
+            break;
+        }
+        served.add();
+        throttle(response.size());
+        if (!writeAll(fd, response.data(), response.size())) {
+            break;
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto& connection : connections) {
+        if (connection.first == fd) {
+            connection.first = -1;
+        }
+    }
+    ::close(fd);
+}
+
+ChainSync::ChainSync(const std::vector<std::string>& peerPaths) : ChainSync(peerPaths, Config()) {}
+
+ChainSync::ChainSync(const std::vector<std::string>& peerPaths, const Config& config)
+    : peerPaths(peerPaths), config(config) {
+    this->config.headerBatch = std::max<size_t>(1, config.headerBatch);
+    this->config.bodyBatch = std::max<size_t>(1, config.bodyBatch);
+    this->config.connectionsPerPeer = std::max<size_t>(1, config.connectionsPerPeer);
+    this->config.window = std::max(this->config.bodyBatch, config.window);
+}
+
+const char* ChainSync::failureName(Failure failure) {
+    switch (failure) {
+        case NONE: return "none";
+        case NO_PEERS: return "no reachable peers";
+        case PEERS_FAILED: return "every peer failed before the chain was complete";
+        case BAD_LINK: return "header does not link to the previous block";
+        case BAD_PROOF_OF_WORK: return "header proof of work";
+        case BAD_BALANCE: return "transaction not covered by the sender's balance";
+        case STORE_ERROR: return "could not append to the block store";
+    }
+    return "unknown";
+}
+
+ChainSync::Result ChainSync::sync(BlockStore& store, AccountState& accounts) const {
+    static Metrics::Counter& appliedTotal = Metrics::instance().counter("sync_blocks_total",
+                                                                        "Blocks applied by chain sync");
+    static Metrics::Counter& receivedTotal = Metrics::instance().counter("sync_bytes_received_total",
+                                                                         "Header and body bytes received by chain sync");
+    Result result;
+    Clock::time_point start = Clock::now();
+    size_t first = store.size();
+    result.startHeight = first;
+    result.blocksPerPeer.assign(peerPaths.size(), 0);
+    auto fail = [&result](Failure failure, size_t height) {
+        result.valid = false;
+        result.failure = failure;
+        result.failedHeight = height;
+    };
+
+    // Every peer's height and chain work, asked all at once; an unreachable peer counts as
+    // height 0 and is not used
+    std::vector<uint64_t> heights(peerPaths.size(), 0);
+    std::vector<double> work(peerPaths.size(), 0);
+    std::vector<std::thread> probes;
+    for (size_t p = 0; p < peerPaths.size(); ++p) {
+        probes.emplace_back([&, p] {
+            int fd = connectPeer(peerPaths[p]);
+            if (fd >= 0 && (!request(fd, "WORK") || !readAll(fd, &heights[p], sizeof(heights[p])) ||
+                            !readAll(fd, &work[p], sizeof(work[p])))) {
+                heights[p] = 0;
+                work[p] = 0;
+            }
+            if (fd >= 0) {
+                ::close(fd);
+            }
+        });
+    }
+    for (auto& probe : probes) {
+        probe.join();
+    }
+    // The most work wins, not the most blocks: a longer chain of cheap headers is not the best chain.
+    // The claim only picks the peer; every header it sends is still checked.
+    size_t best = 0;
+    for (size_t p = 1; p < peerPaths.size(); ++p) {
+        if (work[p] > work[best] || (work[p] == work[best] && heights[p] > heights[best])) {
+            best = p;
+        }
+    }
+    if (heights.empty() || heights[best] == 0) {
+        fail(NO_PEERS, first);
+        result.totalSeconds = secondsSince(start);
+        return result;
+    }
+    size_t target = static_cast<size_t>(heights[best]);
+    if (target <= first || work[best] <= ChainVerifier::chainWork(store, first)) {
+        result.totalSeconds = secondsSince(start);
+        return result; // Nothing to fetch
+    }
+
+    // Headers: linkage in order, proof of work on all cores, batch by batch
+    std::vector<StoredBlockHeader> headers;
+    headers.reserve(target - first);
+    Digest previous = first > 0 ? store.view(first - 1).header().blockID : Digest();
+    int fd = connectPeer(peerPaths[best]);
+    int threads = config.threadCount > 0 ? config.threadCount : omp_get_max_threads();
+    while (first + headers.size() < target) {
+        size_t from = first + headers.size();
+        uint32_t count = 0;
+        if (fd < 0 || !request(fd, "HEADERS " + std::to_string(from) + " " +
+                                       std::to_string(std::min(config.headerBatch, target - from))) ||
+            !readAll(fd, &count, sizeof(count)) || count == 0 || count > target - from) {
+            fail(PEERS_FAILED, from);
+            break;
+        }
+        headers.resize(headers.size() + count);
+        StoredBlockHeader* batch = &headers[headers.size() - count];
+        if (!readAll(fd, batch, count * sizeof(StoredBlockHeader))) {
+            fail(PEERS_FAILED, from);
+            break;
+        }
+        result.bytesReceived += sizeof(count) + count * sizeof(StoredBlockHeader);
+        std::vector<uint8_t> failures(count, ChainVerifier::NONE);
+        #pragma omp parallel for schedule(dynamic, 64) num_threads(threads)
+        for (long long i = 0; i < static_cast<long long>(count); ++i) {
+            failures[i] = static_cast<uint8_t>(ChainVerifier::checkProofOfWork(batch[i], config.requiredBits));
+        }
+        for (size_t i = 0; i < count && result.valid; ++i) {
+            if (batch[i].previousHash != previous) {
+                fail(BAD_LINK, from + i);
+            } else if (failures[i] != ChainVerifier::NONE || batch[i].transactionCount > MAX_TRANSACTIONS_PER_BLOCK) {
+                fail(BAD_PROOF_OF_WORK, from + i);
+            }
+            previous = batch[i].blockID;
+        }
+        if (!result.valid) {
+            break;
+        }
+    }
+    if (fd >= 0) {
+        ::close(fd);
+    }
+    result.headerSeconds = secondsSince(start);
+    if (!result.valid) {
+        result.totalSeconds = result.headerSeconds;
+        return result;
+    }
+    result.headers = headers.size();
+    receivedTotal.add(result.bytesReceived);
+
+    // Bodies: ranges go to whichever connection asks first, lowest height first
+    struct Shared {
+        std::mutex mutex;
+        std::condition_variable changed;
+        std::map<size_t, size_t> pending; // First height -> block count
+        std::vector<std::vector<StoredTransaction>> bodies;
+        std::vector<char> arrived;
+        std::vector<char> peerDropped;
+        std::vector<int> fds;             // Per worker, -1 when not connected
+        size_t applied = 0;               // Next height to apply
+        size_t activeWorkers = 0;
+        bool abort = false;
+    } shared;
+    for (size_t height = first; height < target; height += config.bodyBatch) {
+        shared.pending[height] = std::min(config.bodyBatch, target - height);
+    }
+    shared.bodies.resize(target - first);
+    shared.arrived.assign(target - first, 0);
+    shared.peerDropped.assign(peerPaths.size(), 0);
+    shared.applied = first;
+    std::atomic<uint64_t> bytesReceived{0};
+
+    auto worker = [&](size_t peer, size_t slot) {
+        int connection = connectPeer(peerPaths[peer]);
+        std::vector<std::vector<StoredTransaction>> received;
+        while (connection >= 0) {
+            size_t from, count;
+            {
+                std::unique_lock<std::mutex> lock(shared.mutex);
+                shared.fds[slot] = connection;
+                shared.changed.wait(lock, [&] {
+                    return shared.abort || shared.peerDropped[peer] || shared.pending.empty() ||
+                           shared.pending.begin()->first >= heights[peer] ||
+                           shared.pending.begin()->first < shared.applied + config.window;
+                });
+                if (shared.abort || shared.peerDropped[peer] || shared.pending.empty() ||
+                    shared.pending.begin()->first >= heights[peer]) {
+                    break;
+                }
+                from = shared.pending.begin()->first;
+                count = shared.pending.begin()->second;
+                shared.pending.erase(shared.pending.begin());
+                if (from + count > heights[peer]) { // This peer only has part of the range
+                    shared.pending[heights[peer]] = from + count - heights[peer];
+                    count = heights[peer] - from;
+                }
+            }
+
+            bool good = request(connection, "BODIES " + std::to_string(from) + " " + std::to_string(count));
+            uint32_t served = 0;
+            good = good && readAll(connection, &served, sizeof(served)) && served == count;
+            uint64_t bytes = sizeof(served);
+            received.resize(count);
+            for (size_t i = 0; good && i < count; ++i) {
+                const StoredBlockHeader& header = headers[from + i - first];
+                uint32_t transactionCount = 0;
+                good = readAll(connection, &transactionCount, sizeof(transactionCount)) &&
+                       transactionCount == header.transactionCount;
+                if (good) {
+                    received[i].resize(transactionCount);
+                    good = readAll(connection, received[i].data(), transactionCount * sizeof(StoredTransaction)) &&
+                           ChainVerifier::checkContents(BlockView(&header, received[i].data())) == ChainVerifier::NONE;
+                    bytes += sizeof(transactionCount) + transactionCount * sizeof(StoredTransaction);
+                }
+            }
+            bytesReceived += bytes;
+
+            std::lock_guard<std::mutex> lock(shared.mutex);
+            if (!good && shared.abort) {
+                break; // Cut off by the applier, nothing is missing any more
+            }
+            if (!good) {
+                // A bad body or a broken connection: the range goes back and the peer is not asked again
+                shared.pending[from] = count;
+                result.retries++;
+                if (!shared.peerDropped[peer]) {
+                    shared.peerDropped[peer] = 1;
+                    result.peersDropped++;
+                }
+                shared.changed.notify_all();
+                break;
+            }
+            for (size_t i = 0; i < count; ++i) {
+                shared.bodies[from + i - first] = std::move(received[i]);
+                shared.arrived[from + i - first] = 1;
+            }
+            result.blocksPerPeer[peer] += count;
+            shared.changed.notify_all();
+        }
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.fds[slot] = -1;
+        shared.activeWorkers--;
+        shared.changed.notify_all();
+        if (connection >= 0) {
+            ::close(connection);
+        }
+    };
+
+    Clock::time_point bodyStart = Clock::now();
+    std::vector<std::thread> workers;
+    {
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        for (size_t peer = 0; peer < peerPaths.size(); ++peer) {
+            for (size_t c = 0; heights[peer] > first && c < config.connectionsPerPeer; ++c) {
+                shared.fds.push_back(-1);
+                shared.activeWorkers++;
+            }
+        }
+    }
+    for (size_t peer = 0, slot = 0; peer < peerPaths.size(); ++peer) {
+        for (size_t c = 0; heights[peer] > first && c < config.connectionsPerPeer; ++c) {
+            workers.emplace_back(worker, peer, slot++);
+        }
+    }
+
+    // Ordered application on this thread, as soon as the next body is in
+    BlockValidator validator(config.threadCount);
+    std::vector<Transaction> transactions;
+    for (size_t height = first; height < target; ++height) {
+        std::vector<StoredTransaction> body;
+        {
+            std::unique_lock<std::mutex> lock(shared.mutex);
+            shared.changed.wait(lock, [&] { return shared.arrived[height - first] || shared.activeWorkers == 0; });
+            if (!shared.arrived[height - first]) {
+                fail(PEERS_FAILED, height);
+                break;
+            }
+            body = std::move(shared.bodies[height - first]);
+        }
+        const StoredBlockHeader& header = headers[height - first];
+        transactions.clear();
+        for (const StoredTransaction& tx : body) {
+            transactions.emplace_back(tx.transactionID, tx.sender, tx.receiver, static_cast<int>(tx.amount));
+        }
+        // IDs were checked against the body on arrival, only the balance effects are left
+        BlockValidator::Result applied = validator.applyTransactions(transactions, accounts);
+        if (applied.unknownAccounts > 0 || applied.insufficientBalance > 0) {
+            fail(BAD_BALANCE, height);
+            break;
+        }
+        Block block = Block::restore(header.blockID, header.previousHash, header.merkleRoot,
+                                     std::to_string(header.timestamp), header.nonce, header.extraNonce,
+                                     header.difficultyBits,
+                                     std::string(header.version, std::min<size_t>(header.versionLength, sizeof(header.version))),
+                                     transactions);
+        if (!store.append(block)) {
+            fail(STORE_ERROR, height);
+            break;
+        }
+        result.blocksApplied++;
+        result.transactions += transactions.size();
+        appliedTotal.add();
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.applied = height + 1;
+        shared.changed.notify_all();
+    }
+
+    {
+        // Workers still waiting on a peer are cut off rather than left to time out
+        std::lock_guard<std::mutex> lock(shared.mutex);
+        shared.abort = true;
+        for (int workerFd : shared.fds) {
+            if (workerFd >= 0) {
+                ::shutdown(workerFd, SHUT_RDWR);
+            }
+        }
+        shared.changed.notify_all();
+    }
+    for (auto& thread : workers) {
+        thread.join();
+    }
+    result.bytesReceived += bytesReceived.load();
+    receivedTotal.add(bytesReceived.load());
+    result.bodySeconds = secondsSince(bodyStart);
+    result.totalSeconds = secondsSince(start);
+    return result;
+}
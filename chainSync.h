@@ -0,0 +1,122 @@
+#ifndef CHAINSYNC_H
+#define CHAINSYNC_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include "blockStore.h"
+#include "accountState.h"
+#include "chainVerifier.h"
+
+// Serves the blocks of a store to syncing nodes over a Unix domain socket.
+//
+// Requests are text lines; responses are the store's own record layout, copied straight
+// from the mapped file:
+//
+//   HEIGHT                    u64 blocks served
+//   WORK                      u64 blocks served, then f64 their cumulative proof of work
+//   HEADERS <from> <count>    u32 n, then n StoredBlockHeader
+//   BODIES <from> <count>     u32 n, then for each block a u32 transaction count and that
+//                             many StoredTransaction
+//
+// n is cut short at the end of the served chain; a malformed request closes the
+// connection. Each connection has its own thread. A response can be held back by a fixed
+// latency plus its size at the peer's upload rate, shared by all of its connections, so
+// local peers can stand in for remote ones.
+class SyncPeer {
+public:
+    struct Config {
+        size_t height = SIZE_MAX;   // Blocks served, at most the store's size
+        double latencySeconds = 0;
+        double bytesPerSecond = 0;  // Upload rate of the peer, 0 for unlimited
+    };
+
+    explicit SyncPeer(const BlockStore& store);
+    SyncPeer(const BlockStore& store, const Config& config);
+    ~SyncPeer();
+
+    SyncPeer(const SyncPeer&) = delete;
+    SyncPeer& operator=(const SyncPeer&) = delete;
+
+    bool listen(const std::string& path); // Replaces a stale socket file at `path`
+    bool start();
+    void stop();
+
+private:
+    const BlockStore& store;
+    Config config;
+    double work; // Of the served blocks, see ChainVerifier::work
+    int listener;
+    std::string path;
+    std::thread acceptor;
+    std::mutex mutex; // Guards connections and uploadFreeAt
+    std::vector<std::pair<int, std::thread>> connections;
+    std::chrono::steady_clock::time_point uploadFreeAt;
+
+    void serve(int fd);
+    void throttle(size_t bytes);
+};
+
+// Brings a block store up to the chain held by a set of SyncPeers without mining it.
+//
+// Headers come first, in batches from the peer whose chain has the most cumulative work,
+// and only if that is more than the store's own: every header must link to the one below
+// it (the store's tip for the first) and carry a valid proof of work of at least the
+// chain's required difficulty, checked on all cores. That fixes the chain before any body
+// is fetched. Bodies are then
+// requested in ranges over several connections per peer at once and accepted in
+// whatever order they arrive, once each matches its header's Merkle root and its
+// transaction IDs; a peer that sends a bad body or drops the connection is abandoned
+// and its range handed to the others. The calling thread applies bodies in height order
+// as soon as they are contiguous, replaying balances and appending to the store.
+// Downloads stay within a window above the applied height, so memory is bounded by the
+// window rather than the chain.
+class ChainSync {
+public:
+    enum Failure { NONE, NO_PEERS, PEERS_FAILED, BAD_LINK, BAD_PROOF_OF_WORK, BAD_BALANCE, STORE_ERROR };
+
+    struct Config {
+        size_t headerBatch = 2000;     // Headers per request
+        size_t bodyBatch = 16;         // Blocks per body request
+        size_t connectionsPerPeer = 2;
+        size_t window = 4096;          // Blocks that may be downloaded ahead of the applied height
+        int threadCount = 0;           // For the header checks, 0 uses all available OpenMP threads
+        int requiredBits = ChainVerifier::REQUIRED_DIFFICULTY_BITS; // Least difficulty a header may claim
+    };
+
+    struct Result {
+        bool valid = true;
+        Failure failure = NONE;
+        size_t failedHeight = 0;
+        size_t startHeight = 0;        // Store size before syncing
+        size_t headers = 0;
+        size_t blocksApplied = 0;
+        size_t transactions = 0;
+        uint64_t bytesReceived = 0;
+        size_t retries = 0;            // Body ranges requested again
+        size_t peersDropped = 0;
+        std::vector<size_t> blocksPerPeer;
+        double headerSeconds = 0;
+        double bodySeconds = 0;        // Download and ordered apply, which overlap
+        double totalSeconds = 0;
+    };
+
+    explicit ChainSync(const std::vector<std::string>& peerPaths);
+    ChainSync(const std::vector<std::string>& peerPaths, const Config& config);
+
+    // `accounts` holds the balances after the store's current tip and is advanced with
+    // every applied block; on failure the store keeps every block applied before it
+    Result sync(BlockStore& store, AccountState& accounts) const;
+
+    static const char* failureName(Failure failure);
+
+private:
+    std::vector<std::string> peerPaths;
+    Config config;
+};
+
+#endif // CHAINSYNC_H
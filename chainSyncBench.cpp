@@ -0,0 +1,269 @@
+// chainSyncBench.cpp
+// Times headers-first sync from local stand-in peers against chain length and peer count,
+// or serves a stored chain to other nodes (--serve).
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
+#include "chainSync.h"
+#include "mempool.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const size_t USERS = 60;
+const size_t TRANSACTIONS_PER_BLOCK = 100;
+
+struct Run {
+    size_t length = 0;
+    size_t peers = 0;
+    bool ok = false;
+    ChainSync::Result result;
+};
+
+void usage() {
+    std::cout << "Usage: chain_sync [--source blockchain.dat | --blocks 2000] [--lengths 250,500,1000,2000]"
+                 " [--peers 1,4] [--connections 2] [--batch 16] [--latency-ms 2] [--peer-mbps 0] [--seed 1]"
+                 " [--json out.json]\n"
+                 "       chain_sync --serve SOCKET [--source blockchain.dat] [--latency-ms 0] [--peer-mbps 0]\n"
+                 "A --source chain is replayed against the users of --seed, as generated by ./blockchain <seed>\n";
+}
+
+std::vector<size_t> parseList(const std::string& text) {
+    std::vector<size_t> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t value = std::strtoull(item.c_str(), nullptr, 10);
+        if (value > 0) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+// Mines a chain of `blocks` blocks at the usual difficulty from generated transactions;
+// when the pool runs dry another round is drawn from the next seed
+bool generateChain(BlockStore& store, const std::vector<User>& users, size_t blocks, uint64_t seed) {
+    AccountState accounts = AccountState::fromUsers(users);
+    Mempool mempool;
+    Digest previous;
+    for (uint64_t round = 0; store.size() < blocks; ) {
+        std::vector<Transaction> rejected;
+        std::vector<Transaction> selected = mempool.selectForBlock(accounts, TRANSACTIONS_PER_BLOCK, rejected);
+        if (selected.empty()) {
+            if (round == 64) {
+                return false;
+            }
+            WorkloadGenerator(seed + round++).generateTransactions(
+                users, (blocks - store.size()) * TRANSACTIONS_PER_BLOCK, [&](std::vector<Transaction>& chunk) {
+                    for (const auto& transaction : chunk) {
+                        mempool.add(transaction);
+                    }
+                });
+            continue;
+        }
+        Block block(previous, std::vector<Transaction>(), Block::CHAIN_DIFFICULTY);
+        for (const auto& transaction : selected) {
+            block.addTransaction(transaction);
+        }
+        block.mineBlock();
+        if (!store.append(block)) {
+            return false;
+        }
+        previous = block.getBlockID();
+    }
+    return true;
+}
+
+bool writeJson(const std::string& path, const SyncPeer::Config& peer, const std::vector<Run>& runs) {
+    std::ofstream out(path);
+    out << std::setprecision(9);
+    out << "{\n  \"peer_latency_seconds\": " << peer.latencySeconds << ",\n  \"peer_bytes_per_second\": "
+        << peer.bytesPerSecond << ",\n  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const ChainSync::Result& r = runs[i].result;
+        out << "    {\"blocks\": " << runs[i].length << ", \"peers\": " << runs[i].peers << ", \"ok\": "
+            << (runs[i].ok ? "true" : "false") << ", \"header_seconds\": " << r.headerSeconds
+            << ", \"body_seconds\": " << r.bodySeconds << ", \"total_seconds\": " << r.totalSeconds
+            << ", \"transactions\": " << r.transactions << ", \"bytes_received\": " << r.bytesReceived
+            << ", \"retries\": " << r.retries << "}" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+int serve(const std::string& socketPath, const std::string& sourcePath, const SyncPeer::Config& config) {
+    BlockStore store;
+    if (!store.open(sourcePath) || store.size() == 0) {
+        std::cout << "No stored chain in " << sourcePath << "\n";
+        return 1;
+    }
+    SyncPeer peer(store, config);
+    if (!peer.listen(socketPath) || !peer.start()) {
+        std::cout << "Could not listen on " << socketPath << "\n";
+        return 1;
+    }
+    std::cout << "Serving " << store.size() << " blocks of " << sourcePath << " on " << socketPath
+              << " until stdin is closed or Enter is pressed" << std::endl;
+    std::string line;
+    std::getline(std::cin, line);
+    peer.stop();
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string sourcePath, servePath, jsonPath;
+    size_t blocks = 2000, connections = 2, batch = 16;
+    uint64_t seed = 1;
+    std::vector<size_t> lengths, peerCounts = {1, 4};
+    SyncPeer::Config peerConfig;
+    peerConfig.latencySeconds = 0.002;
+    bool latencySet = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--source" && i + 1 < argc) {
+            sourcePath = argv[++i];
+        } else if (arg == "--serve" && i + 1 < argc) {
+            servePath = argv[++i];
+        } else if (arg == "--blocks" && i + 1 < argc) {
+            blocks = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--lengths" && i + 1 < argc) {
+            lengths = parseList(argv[++i]);
+        } else if (arg == "--peers" && i + 1 < argc) {
+            peerCounts = parseList(argv[++i]);
+        } else if (arg == "--connections" && i + 1 < argc) {
+            connections = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batch = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--latency-ms" && i + 1 < argc) {
+            peerConfig.latencySeconds = std::strtod(argv[++i], nullptr) / 1000;
+            latencySet = true;
+        } else if (arg == "--peer-mbps" && i + 1 < argc) {
+            peerConfig.bytesPerSecond = std::strtod(argv[++i], nullptr) * 1e6 / 8;
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!servePath.empty()) {
+        if (!latencySet) {
+            peerConfig.latencySeconds = 0;
+        }
+        return serve(servePath, sourcePath.empty() ? "blockchain.dat" : sourcePath, peerConfig);
+    }
+    if (peerCounts.empty() || (sourcePath.empty() && blocks == 0)) {
+        usage();
+        return 2;
+    }
+
+    fs::path work = fs::temp_directory_path() / ("chain_sync." + std::to_string(::getpid()));
+    std::error_code error;
+    fs::create_directories(work, error);
+    std::vector<User> users = WorkloadGenerator(seed).generateUsers(USERS);
+    BlockStore source;
+    if (!sourcePath.empty()) {
+        if (!source.open(sourcePath) || source.size() == 0) {
+            std::cout << "No stored chain in " << sourcePath << "\n";
+            return 1;
+        }
+    } else {
+        std::cout << "Mining a " << blocks << " block source chain..." << std::flush;
+        if (!source.open((work / "source.dat").string()) || !generateChain(source, users, blocks, seed)) {
+            std::cout << " failed\n";
+            fs::remove_all(work, error);
+            return 1;
+        }
+        std::cout << " done\n";
+    }
+    if (lengths.empty()) {
+        for (size_t length = source.size(); length >= 1 && lengths.size() < 4; length /= 2) {
+            lengths.insert(lengths.begin(), length);
+        }
+    }
+
+    ChainSync::Config syncConfig;
+    syncConfig.connectionsPerPeer = connections;
+    syncConfig.bodyBatch = batch;
+    std::cout << "Sync from local peers: " << peerConfig.latencySeconds * 1000 << " ms per response, ";
+    if (peerConfig.bytesPerSecond > 0) {
+        std::cout << peerConfig.bytesPerSecond * 8 / 1e6 << " Mbit/s";
+    } else {
+        std::cout << "unlimited";
+    }
+    std::cout << " upload per peer, " << syncConfig.connectionsPerPeer << " connections per peer, "
+              << syncConfig.bodyBatch << " bodies per request\n";
+    std::cout << std::setw(8) << "blocks" << std::setw(7) << "peers" << std::setw(11) << "headers s"
+              << std::setw(10) << "bodies s" << std::setw(10) << "total s" << std::setw(11) << "blocks/s"
+              << std::setw(9) << "MB/s" << std::setw(9) << "retries" << std::setw(6) << "ok" << "\n";
+
+    std::vector<Run> runs;
+    bool allOk = true;
+    for (size_t length : lengths) {
+        length = std::min(length, source.size());
+        for (size_t peerCount : peerCounts) {
+            SyncPeer::Config config = peerConfig;
+            config.height = length;
+            std::vector<std::unique_ptr<SyncPeer>> peers;
+            std::vector<std::string> paths;
+            for (size_t p = 0; p < peerCount; ++p) {
+                paths.push_back((work / ("peer" + std::to_string(p) + ".sock")).string());
+                peers.emplace_back(new SyncPeer(source, config));
+                if (!peers.back()->listen(paths.back()) || !peers.back()->start()) {
+                    std::cout << "Could not listen on " << paths.back() << "\n";
+                    fs::remove_all(work, error);
+                    return 1;
+                }
+            }
+            fs::path targetPath = work / "target.dat";
+            fs::remove(targetPath, error);
+            fs::remove(targetPath.string() + ".idx", error);
+            BlockStore target;
+            target.open(targetPath.string());
+            AccountState accounts = AccountState::fromUsers(users);
+
+            Run run;
+            run.length = length;
+            run.peers = peerCount;
+            run.result = ChainSync(paths, syncConfig).sync(target, accounts);
+            for (auto& peer : peers) {
+                peer->stop();
+            }
+            // The synced store must end on the same block as the source
+            run.ok = run.result.valid && target.size() == length &&
+                     target.view(length - 1).header().blockID == source.view(length - 1).header().blockID;
+            allOk = allOk && run.ok;
+            const ChainSync::Result& r = run.result;
+            std::cout << std::fixed << std::setprecision(3) << std::setw(8) << length << std::setw(7) << peerCount
+                      << std::setw(11) << r.headerSeconds << std::setw(10) << r.bodySeconds << std::setw(10)
+                      << r.totalSeconds << std::setprecision(0) << std::setw(11) << length / r.totalSeconds
+                      << std::setprecision(1) << std::setw(9) << r.bytesReceived / 1e6 / r.totalSeconds
+                      << std::setw(9) << r.retries << std::setw(6) << (run.ok ? "yes" : "NO") << std::endl;
+            if (!r.valid) {
+                std::cout << "  failed at height " << r.failedHeight << ": " << ChainSync::failureName(r.failure) << "\n";
+            }
+            runs.push_back(run);
+        }
+    }
+    fs::remove_all(work, error);
+    if (!jsonPath.empty() && !writeJson(jsonPath, peerConfig, runs)) {
+        std::cout << "Could not write " << jsonPath << "\n";
+        return 1;
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,284 @@
+#include "chainVerifier.h"
+#include "blockHeader.h"
+#include "blockValidator.h"
+#include "merkleRootHash.h"
+#include "hash.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <omp.h>
+
+namespace {
+
+const uint32_t CHECKPOINT_MAGIC = 0x54504B43; // "CKPT"
+const uint32_t CHECKPOINT_VERSION = 2; // 1 was keyed with blockchain.key
+
+// Transaction IDs handed to the multi-buffer hash at a time
+const size_t HASH_BATCH = 8;
+
+struct CheckpointRecord {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t height;
+    Digest blockID;
+    Digest stateDigest;
+    Digest checksum;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+ChainVerifier::ChainVerifier(int threadCount, int requiredBits)
+    : threadCount(threadCount > 0 ? threadCount : omp_get_max_threads()), requiredBits(requiredBits) {}
+
+ChainVerifier::Failure ChainVerifier::checkBlock(const BlockStore& store, size_t height) const {
+    BlockView block = store.view(height);
+    Digest expectedPrevious = height > 0 ? store.view(height - 1).header().blockID : Digest();
+    if (block.header().previousHash != expectedPrevious) {
+        return BAD_LINK;
+    }
+    Failure failure = checkContents(block);
+    // The header is rehashed last; it is the one check that is not proportional to the block size
+    return failure != NONE ? failure : checkProofOfWork(block.header(), requiredBits);
+}
+
+ChainVerifier::Failure ChainVerifier::checkContents(const BlockView& block) {
+    const StoredBlockHeader& header = block.header();
+    size_t count = block.transactionCount();
+    std::vector<Digest> leaves(count);
+    for (size_t t = 0; t < count; ++t) {
+        leaves[t] = block.transaction(t).transactionID;
+    }
+    if (MerkleTree(leaves).root() != header.merkleRoot) {
+        return BAD_MERKLE_ROOT;
+    }
+
+    HashState states[HASH_BATCH];
+    Digest digests[HASH_BATCH];
+    char hex[Digest::HEX_LENGTH];
+    for (size_t first = 0; first < count; first += HASH_BATCH) {
+        size_t lanes = std::min(HASH_BATCH, count - first);
+        for (size_t k = 0; k < lanes; ++k) {
+            const StoredTransaction& tx = block.transaction(first + k);
+            states[k] = HashState();
+            tx.sender.writeHex(hex); // IDs hash the hex form of both keys
+            states[k].update(hex, sizeof(hex));
+            tx.receiver.writeHex(hex);
+            states[k].update(hex, sizeof(hex));
+            states[k].update(std::to_string(tx.amount));
+        }
+        HashUtils::processHashBatch(states, lanes, digests);
+        for (size_t k = 0; k < lanes; ++k) {
+            if (digests[k] != block.transaction(first + k).transactionID) {
+                return BAD_TRANSACTION_ID;
+            }
+        }
+    }
+    return NONE;
+}
+
+ChainVerifier::Failure ChainVerifier::checkProofOfWork(const StoredBlockHeader& header, int requiredBits) {
+    if (header.difficultyBits < std::max(requiredBits, 0) || header.difficultyTarget != header.difficultyBits / 4 ||
+        header.blockID.leadingZeroBits() < header.difficultyBits) {
+        return BAD_PROOF_OF_WORK;
+    }
+    BlockHeader serialized(header.previousHash, std::to_string(header.timestamp), header.merkleRoot,
+                           header.extraNonce, header.difficultyBits);
+    if (serialized.hash(header.nonce) != header.blockID) {
+        return BAD_PROOF_OF_WORK;
+    }
+    return NONE;
+}
+
+double ChainVerifier::work(const StoredBlockHeader& header) {
+    return std::ldexp(1.0, std::max(header.difficultyBits, 0));
+}
+
+double ChainVerifier::chainWork(const BlockStore& store, size_t endHeight) {
+    double total = 0;
+    for (size_t height = 0; height < std::min(endHeight, store.size()); ++height) {
+        total += work(store.view(height).header());
+    }
+    return total;
+}
+
+size_t ChainVerifier::checkBlocks(const BlockStore& store, size_t firstHeight, Failure& failure) const {
+    failure = NONE;
+    size_t endHeight = store.size();
+    if (firstHeight >= endHeight) {
+        return endHeight;
+    }
+
+    std::vector<uint8_t> failures(endHeight - firstHeight, NONE);
+    #pragma omp parallel for schedule(dynamic, 16) num_threads(threadCount)
+    for (long long i = 0; i < static_cast<long long>(failures.size()); ++i) {
+        failures[i] = static_cast<uint8_t>(checkBlock(store, firstHeight + i));
+    }
+    for (size_t i = 0; i < failures.size(); ++i) {
+        if (failures[i] != NONE) {
+            failure = static_cast<Failure>(failures[i]);
+            return firstHeight + i;
+        }
+    }
+    return endHeight;
+}
+
+size_t ChainVerifier::replayBalances(const BlockStore& store, size_t firstHeight, size_t endHeight,
+                                     AccountState& accounts, size_t* transactionsReplayed) const {
+    BlockValidator validator(threadCount);
+    std::vector<Transaction> transactions;
+    for (size_t height = firstHeight; height < endHeight; ++height) {
+        BlockView block = store.view(height);
+        transactions.clear();
+        for (size_t t = 0; t < block.transactionCount(); ++t) {
+            const StoredTransaction& tx = block.transaction(t);
+            transactions.emplace_back(tx.transactionID, tx.sender, tx.receiver, static_cast<int>(tx.amount));
+        }
+        // IDs were checked by checkBlocks, only the balance effects are replayed here
+        BlockValidator::Result result = validator.applyTransactions(transactions, accounts);
+        if (result.unknownAccounts > 0 || result.insufficientBalance > 0) {
+            return height;
+        }
+        if (transactionsReplayed != nullptr) {
+            *transactionsReplayed += transactions.size();
+        }
+    }
+    return endHeight;
+}
+
+ChainVerifier::Result ChainVerifier::verifyChain(const BlockStore& store, AccountState& accounts,
+                                                 const std::string& checkpointPath, size_t replayFrom) const {
+    Result result;
+    size_t tip = store.size();
+
+    Checkpoint checkpoint;
+    if (loadCheckpoint(checkpointPath, checkpoint) && checkpoint.height < tip &&
+        store.view(checkpoint.height).header().blockID == checkpoint.blockID) {
+        result.usedCheckpoint = true;
+        result.checkedFrom = checkpoint.height + 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    Failure failure;
+    size_t firstBad = checkBlocks(store, result.checkedFrom, failure);
+    result.blocksChecked = tip - result.checkedFrom;
+    result.checkSeconds = secondsSince(start);
+    if (firstBad < tip) {
+        result.valid = false;
+        result.failure = failure;
+        result.failedHeight = firstBad;
+    }
+
+    // Replay the structurally valid prefix; a balance failure below firstBad takes precedence
+    start = std::chrono::steady_clock::now();
+    result.replayedFrom = replayFrom;
+    bool replayed = true;
+    if (result.usedCheckpoint && replayFrom <= checkpoint.height) {
+        size_t reached = replayBalances(store, replayFrom, checkpoint.height + 1, accounts, &result.transactionsReplayed);
+        if (reached <= checkpoint.height) {
+            result.valid = replayed = false;
+            result.failure = BAD_BALANCE;
+            result.failedHeight = reached;
+        } else if (stateDigest(accounts) != checkpoint.stateDigest) {
+            result.valid = replayed = false;
+            result.failure = BAD_STATE;
+            result.failedHeight = checkpoint.height;
+        }
+        replayFrom = checkpoint.height + 1;
+    }
+    if (replayed && replayFrom < firstBad) {
+        size_t reached = replayBalances(store, replayFrom, firstBad, accounts, &result.transactionsReplayed);
+        if (reached < firstBad) {
+            result.valid = false;
+            result.failure = BAD_BALANCE;
+            result.failedHeight = reached;
+        }
+    }
+    result.replaySeconds = secondsSince(start);
+
+    if (result.valid && tip > 0 && (!result.usedCheckpoint || checkpoint.height + 1 < tip)) {
+        Checkpoint next;
+        next.height = tip - 1;
+        next.blockID = store.view(tip - 1).header().blockID;
+        next.stateDigest = stateDigest(accounts);
+        result.wroteCheckpoint = writeCheckpoint(checkpointPath, next);
+    }
+    return result;
+}
+
+Digest ChainVerifier::stateDigest(const AccountState& accounts) {
+    return stateDigest(accounts, accounts.getBalances());
+}
+
+// Streams "<key hex><balance>;" for every account, in account order
+Digest ChainVerifier::stateDigest(const AccountState& accounts, const std::vector<int64_t>& balances) {
+    HashState state;
+    char hex[Digest::HEX_LENGTH];
+    for (size_t account = 0; account < accounts.size(); ++account) {
+        accounts.getPublicKey(account).writeHex(hex);
+        state.update(hex, sizeof(hex));
+        state.update(std::to_string(balances[account]));
+        state.update(";", 1);
+    }
+    return state.finalize();
+}
+
+Digest ChainVerifier::checksum(const Checkpoint& checkpoint) {
+    HashState state;
+    state.update(std::to_string(checkpoint.height));
+    state.update(checkpoint.blockID.toHex());
+    state.update(checkpoint.stateDigest.toHex());
+    return state.finalize();
+}
+
+bool ChainVerifier::loadCheckpoint(const std::string& path, Checkpoint& checkpoint) {
+    std::ifstream in(path, std::ios::binary);
+    CheckpointRecord record;
+    if (!in.read(reinterpret_cast<char*>(&record), sizeof(record)) || record.magic != CHECKPOINT_MAGIC ||
+        record.version != CHECKPOINT_VERSION) {
+        return false;
+    }
+    checkpoint.height = record.height;
+    checkpoint.blockID = record.blockID;
+    checkpoint.stateDigest = record.stateDigest;
+    return checksum(checkpoint) == record.checksum;
+}
+
+bool ChainVerifier::writeCheckpoint(const std::string& path, const Checkpoint& checkpoint) {
+    CheckpointRecord record;
+    record.magic = CHECKPOINT_MAGIC;
+    record.version = CHECKPOINT_VERSION;
+    record.height = checkpoint.height;
+    record.blockID = checkpoint.blockID;
+    record.stateDigest = checkpoint.stateDigest;
+    record.checksum = checksum(checkpoint);
+
+    // Written aside and renamed, so a crash leaves either the old or the new checkpoint
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+const char* ChainVerifier::failureName(Failure failure) {
+    switch (failure) {
+        case NONE: return "none";
+        case BAD_LINK: return "previous hash does not link to the block below";
+        case BAD_MERKLE_ROOT: return "Merkle root does not match the transactions";
+        case BAD_TRANSACTION_ID: return "transaction ID does not match its contents";
+        case BAD_PROOF_OF_WORK: return "header hash does not match the block ID or misses the difficulty target";
+        case BAD_BALANCE: return "a transaction is not covered by the replayed balances";
+        case BAD_STATE: return "replayed balances differ from the checkpoint";
+    }
+    return "unknown";
+}
@@ -0,0 +1,102 @@
+#ifndef CHAINVERIFIER_H
+#define CHAINVERIFIER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "digest.h"
+#include "block.h"
+#include "blockStore.h"
+#include "accountState.h"
+
+// Full validation of a stored chain.
+//
+// Every block is checked on its own: its previousHash links to the block below (all
+// zero for genesis), its Merkle root matches its transaction IDs, every transaction ID
+// is hash(sender + receiver + amount), and the header hashes to the block ID with at
+// least difficultyBits leading zero bits, where difficultyBits may not be below the
+// chain's required difficulty. None of this depends on other blocks' results,
+// so blocks are spread over all cores straight from the mapped store. Balances are then
+// replayed in a separate, ordered pass: every transaction in a block must still be
+// accepted when the chain is applied from the initial accounts.
+//
+// A verified tip is recorded in a checkpoint file, which the miner also advances as it
+// stores blocks of its own. On the next run blocks up to a valid checkpoint are trusted
+// and only the blocks after it are checked. The replay starts from
+// the initial accounts or from an account snapshot and must reproduce the state digest
+// stored in the checkpoint when it passes its height.
+//
+// The checkpoint carries a HashUtils checksum of its fields. That only catches accidental
+// damage, such as a torn or truncated write or a checkpoint from another chain. It gives
+// no authenticity: the hash is not cryptographic and anyone who can write the data
+// directory can write a matching checkpoint. Trusting the checkpoint means trusting
+// whoever can write the data directory.
+class ChainVerifier {
+public:
+    enum Failure { NONE, BAD_LINK, BAD_MERKLE_ROOT, BAD_TRANSACTION_ID, BAD_PROOF_OF_WORK, BAD_BALANCE, BAD_STATE };
+
+    struct Checkpoint {
+        uint64_t height = 0;  // Highest verified block
+        Digest blockID;       // Its ID, so a checkpoint is only used for the chain it was made on
+        Digest stateDigest;   // Account state after replaying up to and including `height`
+    };
+
+    struct Result {
+        bool valid = true;
+        Failure failure = NONE;
+        size_t failedHeight = 0;      // First bad block when !valid
+        size_t checkedFrom = 0;       // Blocks below were covered by the checkpoint
+        size_t blocksChecked = 0;
+        size_t replayedFrom = 0;
+        size_t transactionsReplayed = 0;
+        bool usedCheckpoint = false;
+        bool wroteCheckpoint = false;
+        double checkSeconds = 0;
+        double replaySeconds = 0;
+    };
+
+    static const int REQUIRED_DIFFICULTY_BITS = Block::CHAIN_DIFFICULTY * 4;
+
+    // 0 uses all available OpenMP threads
+    explicit ChainVerifier(int threadCount = 0, int requiredBits = REQUIRED_DIFFICULTY_BITS);
+
+    // Checks blocks [firstHeight, store.size()) in parallel; returns the lowest failing
+    // height (and why), or store.size() if all of them pass
+    size_t checkBlocks(const BlockStore& store, size_t firstHeight, Failure& failure) const;
+    Failure checkBlock(const BlockStore& store, size_t height) const;
+    // The parts of checkBlock that need nothing but the block itself: Merkle root and
+    // transaction IDs against the header, and the header against its proof of work, which
+    // must be at least `requiredBits` whatever the header itself claims
+    static Failure checkContents(const BlockView& block);
+    static Failure checkProofOfWork(const StoredBlockHeader& header, int requiredBits);
+    // Expected hashes behind a header, 2^difficultyBits; a chain's work is the sum over its blocks
+    static double work(const StoredBlockHeader& header);
+    static double chainWork(const BlockStore& store, size_t endHeight);
+
+    // Applies blocks [firstHeight, endHeight) to `accounts` in order; returns the first
+    // block with a transaction that would not be accepted, or endHeight
+    size_t replayBalances(const BlockStore& store, size_t firstHeight, size_t endHeight, AccountState& accounts,
+                          size_t* transactionsReplayed = nullptr) const;
+
+    // Both passes, using and then advancing the checkpoint at `checkpointPath`. `accounts`
+    // holds the state after blocks [0, replayFrom) (the initial state for 0, or a loaded
+    // snapshot) and is left at the verified tip, or at the first bad block.
+    Result verifyChain(const BlockStore& store, AccountState& accounts, const std::string& checkpointPath,
+                       size_t replayFrom = 0) const;
+
+    static Digest stateDigest(const AccountState& accounts);
+    // The same digest for `balances` numbered like `accounts`, e.g. a block's balances in the miner
+    static Digest stateDigest(const AccountState& accounts, const std::vector<int64_t>& balances);
+    // False when the file is missing, from another format version or fails its checksum
+    static bool loadCheckpoint(const std::string& path, Checkpoint& checkpoint);
+    static bool writeCheckpoint(const std::string& path, const Checkpoint& checkpoint);
+    static const char* failureName(Failure failure);
+
+private:
+    int threadCount;
+    int requiredBits;
+
+    static Digest checksum(const Checkpoint& checkpoint);
+};
+
+#endif // CHAINVERIFIER_H
@@ -0,0 +1,126 @@
+#ifndef DIGEST_H
+#define DIGEST_H
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+// Fixed-size 32-byte hash value. Every hash produced by HashUtils is 64 hex characters,
+// so the digest stores them packed two per byte; hex is only produced at the edges.
+struct Digest {
+    std::array<uint8_t, 32> bytes{};
+
+    static const size_t HEX_LENGTH = 64;
+
+    // Parses exactly 64 hex characters, returns false for anything else
+    static bool parseHex(const char* hex, size_t length, Digest& out) {
+        if (length != HEX_LENGTH) {
+            return false;
+        }
+        for (size_t i = 0; i < 32; ++i) {
+            int high = hexValue(hex[2 * i]);
+            int low = hexValue(hex[2 * i + 1]);
+            if (high < 0 || low < 0) {
+                return false;
+            }
+            out.bytes[i] = static_cast<uint8_t>((high << 4) | low);
+        }
+        return true;
+    }
+
+    static bool parseHex(const std::string& hex, Digest& out) {
+        return parseHex(hex.data(), hex.size(), out);
+    }
+
+    // Returns an all-zero digest if the input is not a valid 64 character hex string
+    static Digest fromHex(const std::string& hex) {
+        Digest digest;
+        if (!parseHex(hex, digest)) {
+            digest = Digest();
+        }
+        return digest;
+    }
+
+    // Writes 64 lowercase hex characters into `out` (no terminator)
+    void writeHex(char* out) const {
+        static const char digits[] = "0123456789abcdef";
+        for (size_t i = 0; i < 32; ++i) {
+            out[2 * i] = digits[bytes[i] >> 4];
+            out[2 * i + 1] = digits[bytes[i] & 0x0F];
+        }
+    }
+
+    std::string toHex() const {
+        std::string hex(HEX_LENGTH, '0');
+        writeHex(&hex[0]);
+        return hex;
+    }
+
+    // Hex character at position `index` as a 0-15 value
+    int nibble(size_t index) const {
+        uint8_t byte = bytes[index / 2];
+        return (index % 2 == 0) ? (byte >> 4) : (byte & 0x0F);
+    }
+
+    // Number of leading zero bits, reading the hex characters as 4-bit values
+    int leadingZeroBits() const {
+        int bits = 0;
+        for (uint8_t byte : bytes) {
+            if (byte == 0) {
+                bits += 8;
+                continue;
+            }
+            for (int b = 7; b >= 0 && !(byte & (1 << b)); --b) {
+                bits++;
+            }
+            break;
+        }
+        return bits;
+    }
+
+    bool operator==(const Digest& other) const { return bytes == other.bytes; }
+    bool operator!=(const Digest& other) const { return bytes != other.bytes; }
+    bool operator<(const Digest& other) const { return bytes < other.bytes; }
+
+private:
+    static int hexValue(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+};
+
+// Streams the 64 hex characters without building a string
+inline std::ostream& operator<<(std::ostream& out, const Digest& digest) {
+    char hex[Digest::HEX_LENGTH];
+    digest.writeHex(hex);
+    return out.write(hex, sizeof(hex));
+}
+
+// Hash functor for unordered containers. Mined block IDs start with zero nibbles, so
+// all four words are mixed in (splitmix64 finalizer) instead of trusting the leading bytes.
+struct DigestHasher {
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+
+    size_t operator()(const Digest& digest) const {
+        uint64_t words[4];
+        std::memcpy(words, digest.bytes.data(), sizeof(words));
+        uint64_t h = 0x243F6A8885A308D3ULL;
+        for (uint64_t word : words) {
+            h = mix(h ^ word);
+        }
+        return static_cast<size_t>(h);
+    }
+};
+
+#endif // DIGEST_H
@@ -6,6 +6,15 @@
 #include <iomanip>
 #include <chrono>
 #include <iostream>
+#include <array>
+#include <cstdint>
+#include <cctype>
+#include <cstdio>
+#include <vector>
+#include <atomic>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
 
 using namespace std;
 using namespace std::chrono;
@@ -166,8 +175,8 @@ std::string HashUtils::applySaltTransformation(std::string& bits, const std::str
     return saltedBits;
 }
 
-// Function to process input and generate the hash
-std::string HashUtils::processHashInput(const std::string& input) {
+// Original string based implementation, kept as the reference for the packed engine
+std::string HashUtils::processHashInputReference(const std::string& input) {
     std::string modifiedInput = input + std::to_string(input.length());
     modifyInput(modifiedInput);
     std::string binaryResult = inputToBits(modifiedInput);
@@ -178,3 +187,438 @@ std::string HashUtils::processHashInput(const std::string& input) {
     // std::cout << "Hashing input: " << input << " -> " << hashResult << std::endl;
     return hashResult;
 }
+
+namespace {
+
+// Every nibble emits at least one hex character and the output is cut at 64 characters,
+// so only the first 64 nibbles (32 bytes) of the bit string can reach the digest. The
+// rolling value additionally reads the first 64 characters of the modified input.
+const size_t HEAD_CHARS = 64;
+const size_t HEAD_WORDS = 4;
+const char PADDING[] = "blockchain";
+const size_t PADDING_LENGTH = 10;
+
+// Same per-character transformation as modifyInput
+inline char modifyChar(char c, size_t i) {
+    if (isupper(c) || c == '!') {
+        c ^= (i % 10);
+        c += 5;
+    } else {
+        c ^= (i + 3);
+        c -= 2;
+    }
+    return c;
+}
+
+inline uint64_t reverseBits(uint64_t x) {
+    x = ((x >> 1) & 0x5555555555555555ULL) | ((x & 0x5555555555555555ULL) << 1);
+    x = ((x >> 2) & 0x3333333333333333ULL) | ((x & 0x3333333333333333ULL) << 2);
+    x = ((x >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((x & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    x = ((x >> 8) & 0x00FF00FF00FF00FFULL) | ((x & 0x00FF00FF00FF00FFULL) << 8);
+    x = ((x >> 16) & 0x0000FFFF0000FFFFULL) | ((x & 0x0000FFFF0000FFFFULL) << 16);
+    return (x >> 32) | (x << 32);
+}
+
+// abs(sin(k)) * 100 exactly as bitsToHex computes it, cached for typical input lengths
+inline double sinScale(size_t k) {
+    static const std::array<double, 1024> table = [] {
+        std::array<double, 1024> values{};
+        for (size_t i = 0; i < values.size(); ++i) {
+            values[i] = abs(sin(i)) * 100;
+        }
+        return values;
+    }();
+    return k < table.size() ? table[k] : abs(sin(k)) * 100;
+}
+
+// incrementHexChar applied to a raw hex digit value
+inline uint8_t incrementNibble(uint32_t digit) {
+    if (digit == 9) return 0;
+    if (digit == 15) return 10;
+    return static_cast<uint8_t>(digit + 1);
+}
+
+} // namespace
+
+// Everything the digest depends on, gathered in one pass over the modified input
+struct HashSummary {
+    char head[HEAD_CHARS];   // First characters of the reversed, padded, modified input
+    size_t length;           // Length after padding
+    int wordSum;
+    unsigned long long salt;
+    bool containsUpper;
+    bool containsExclamation;
+};
+
+namespace {
+
+inline void accumulate(HashSummary& summary, char c, size_t position) {
+    if (position < HEAD_CHARS) {
+        summary.head[position] = c;
+    }
+    if (isalpha(c)) {
+        summary.wordSum += tolower(c) - 'a' + 1;
+    }
+    summary.salt += c * (position + 1);
+    summary.containsUpper |= isupper(c) != 0;
+    summary.containsExclamation |= c == '!';
+}
+
+// Packs the first 256 bits most significant bit first, as inputToBits lays them out, and
+// applies the word sum and salt transformations on whole 64-bit words
+void prepareWords(const HashSummary& summary, uint64_t* words) {
+    for (size_t w = 0; w < HEAD_WORDS; ++w) {
+        uint64_t word = 0;
+        for (size_t b = 0; b < 8; ++b) {
+            word = (word << 8) | static_cast<unsigned char>(summary.head[w * 8 + b]);
+        }
+        words[w] = word;
+    }
+
+    // multiplyBitsByWordSum: bit i is inverted while wordSum's bit i is clear
+    uint64_t flipMask = 0;
+    int wordSum = summary.wordSum;
+    for (int i = 0; i < 64; ++i) {
+        if (!(wordSum % 2)) {
+            flipMask |= 1ULL << (63 - i);
+        }
+        wordSum /= 2;
+        if (wordSum == 0) break;
+    }
+    words[0] ^= flipMask;
+
+    // applySaltTransformation: bit i is xored with salt bit (i % 64)
+    uint64_t saltMask = reverseBits(summary.salt);
+    for (size_t w = 0; w < HEAD_WORDS; ++w) {
+        words[w] ^= saltMask;
+    }
+}
+
+inline int multiplierBaseOf(const HashSummary& summary) {
+    int multiplierBase = 1;
+    if (summary.containsUpper) {
+        multiplierBase = summary.length;
+    } else if (summary.containsExclamation) {
+        multiplierBase = summary.length / 2;
+    }
+    return multiplierBase;
+}
+
+inline int nibbleAt(const uint64_t* words, size_t n) {
+    return static_cast<int>((words[n / 16] >> (60 - 4 * (n % 16))) & 0x0F);
+}
+
+inline int influenceAt(const HashSummary& summary, size_t n) {
+    if (n < summary.length) {
+        int charInfluence = summary.head[n] % 16;
+        return charInfluence + 1;
+    }
+    return 1;
+}
+
+inline size_t digitLimit(int requiredZeroBits) {
+    if (requiredZeroBits > 0) {
+        return std::min<size_t>(Digest::HEX_LENGTH, (requiredZeroBits + 3) / 4);
+    }
+    return Digest::HEX_LENGTH;
+}
+
+// Appends the hex digits of one nibble value (as std::hex prints an int, most significant
+// first) until `limit` digits exist. Returns false at the first digit that breaks the
+// required leading zero bits.
+inline bool emitValue(int value, Digest& digest, size_t& produced, size_t limit, int requiredZeroBits) {
+    uint32_t bits = static_cast<uint32_t>(value);
+    int shift = 28;
+    while (shift > 0 && ((bits >> shift) & 0x0F) == 0) {
+        shift -= 4;
+    }
+    for (; shift >= 0 && produced < limit; shift -= 4, ++produced) {
+        uint8_t digit = incrementNibble((bits >> shift) & 0x0F);
+        if (requiredZeroBits > 0) {
+            int remaining = requiredZeroBits - static_cast<int>(produced) * 4;
+            if (remaining < 4 ? (digit >> (4 - remaining)) != 0 : digit != 0) {
+                return false;
+            }
+        }
+        digest.bytes[produced / 2] |= (produced % 2 == 0) ? (digit << 4) : digit;
+    }
+    return true;
+}
+
+// Produces the digest nibble by nibble. With requiredZeroBits > 0 it only computes the
+// leading nibbles that cover those bits and stops at the first one that is not zero;
+// the return value tells whether the required leading bits were all zero.
+bool finalizeSummary(const HashSummary& summary, Digest& digest, int requiredZeroBits = 0) {
+    uint64_t words[HEAD_WORDS];
+    prepareWords(summary, words);
+    int multiplierBase = multiplierBaseOf(summary);
+    size_t limit = digitLimit(requiredZeroBits);
+
+    size_t produced = 0;
+    int rollingValue = 1;
+    for (size_t n = 0; produced < limit; ++n) {
+        int value = nibbleAt(words, n);
+        rollingValue += influenceAt(summary, n);
+
+        value *= rollingValue;
+        value *= multiplierBase + n;
+        value *= sinScale(summary.length + n);
+
+        if (!emitValue(value, digest, produced, limit, requiredZeroBits)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Batched finalization works on BATCH_LANES hashes in lockstep, one nibble position at a
+// time. A kernel turns the per-lane nibble, influence, multiplier and sin scale into the
+// nibble values; the integer steps wrap at 32 bits and the double conversion truncates
+// exactly like the scalar expressions above, so every kernel gives identical digests.
+const size_t BATCH_LANES = 8;
+
+typedef void (*ValueKernel)(const int32_t* nibbles, const int32_t* influences, const uint32_t* multipliers,
+                            const double* scales, int32_t* rolling, int32_t* values);
+
+void computeValuesScalar(const int32_t* nibbles, const int32_t* influences, const uint32_t* multipliers,
+                         const double* scales, int32_t* rolling, int32_t* values) {
+    for (size_t k = 0; k < BATCH_LANES; ++k) {
+        rolling[k] += influences[k];
+        uint32_t value = static_cast<uint32_t>(nibbles[k]) * static_cast<uint32_t>(rolling[k]);
+        value *= multipliers[k];
+        values[k] = static_cast<int32_t>(static_cast<int32_t>(value) * scales[k]);
+    }
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HASH_HAVE_AVX2 1
+
+__attribute__((target("avx2")))
+void computeValuesAvx2(const int32_t* nibbles, const int32_t* influences, const uint32_t* multipliers,
+                       const double* scales, int32_t* rolling, int32_t* values) {
+    __m256i roll = _mm256_add_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(rolling)),
+                                    _mm256_loadu_si256(reinterpret_cast<const __m256i*>(influences)));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(rolling), roll);
+
+    __m256i value = _mm256_mullo_epi32(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(nibbles)), roll);
+    value = _mm256_mullo_epi32(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(multipliers)));
+
+    // cvttpd truncates and yields INT_MIN when out of range, the same as the scalar conversion
+    __m256d low = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_castsi256_si128(value)), _mm256_loadu_pd(scales));
+    __m256d high = _mm256_mul_pd(_mm256_cvtepi32_pd(_mm256_extracti128_si256(value, 1)), _mm256_loadu_pd(scales + 4));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values), _mm256_cvttpd_epi32(low));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(values + 4), _mm256_cvttpd_epi32(high));
+}
+#endif
+
+std::atomic<bool> forceScalarKernel(false); // Flipped by tests and benchmarks while workers hash
+
+ValueKernel selectKernel() {
+#ifdef HASH_HAVE_AVX2
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    if (hasAvx2 && !forceScalarKernel.load(std::memory_order_relaxed)) {
+        return computeValuesAvx2;
+    }
+#endif
+    return computeValuesScalar;
+}
+
+// Finalizes up to BATCH_LANES summaries; `passed` receives the difficulty result per lane
+void finalizeLanes(const HashSummary* summaries, size_t lanes, Digest* digests, bool* passed, int requiredZeroBits) {
+    ValueKernel kernel = selectKernel();
+    size_t limit = digitLimit(requiredZeroBits);
+
+    uint64_t words[BATCH_LANES][HEAD_WORDS];
+    uint32_t multiplierBase[BATCH_LANES];
+    size_t produced[BATCH_LANES] = {};
+    bool active[BATCH_LANES] = {};
+    alignas(32) int32_t rolling[BATCH_LANES] = {};
+    for (size_t k = 0; k < lanes; ++k) {
+        prepareWords(summaries[k], words[k]);
+        multiplierBase[k] = static_cast<uint32_t>(multiplierBaseOf(summaries[k]));
+        rolling[k] = 1;
+        active[k] = true;
+        passed[k] = true;
+        digests[k] = Digest();
+    }
+
+    alignas(32) int32_t nibbles[BATCH_LANES];
+    alignas(32) int32_t influences[BATCH_LANES];
+    alignas(32) uint32_t multipliers[BATCH_LANES];
+    alignas(32) double scales[BATCH_LANES];
+    alignas(32) int32_t values[BATCH_LANES];
+
+    for (size_t n = 0; n < Digest::HEX_LENGTH; ++n) {
+        bool anyActive = false;
+        for (size_t k = 0; k < BATCH_LANES; ++k) {
+            if (k < lanes && active[k]) {
+                nibbles[k] = nibbleAt(words[k], n);
+                influences[k] = influenceAt(summaries[k], n);
+                multipliers[k] = multiplierBase[k] + static_cast<uint32_t>(n);
+                scales[k] = sinScale(summaries[k].length + n);
+                anyActive = true;
+            } else {
+                nibbles[k] = influences[k] = 0;
+                multipliers[k] = 0;
+                scales[k] = 0.0;
+            }
+        }
+        if (!anyActive) break;
+
+        kernel(nibbles, influences, multipliers, scales, rolling, values);
+
+        for (size_t k = 0; k < lanes; ++k) {
+            if (!active[k]) continue;
+            if (!emitValue(values[k], digests[k], produced[k], limit, requiredZeroBits)) {
+                passed[k] = false;
+                active[k] = false;
+            } else if (produced[k] >= limit) {
+                active[k] = false;
+            }
+        }
+    }
+}
+
+} // namespace
+
+HashState::HashState()
+    : count(0), charSum(0), weightedCharSum(0), wordSum(0), containsUpper(false), containsExclamation(false) {}
+
+void HashState::absorb(char c) {
+    c = modifyChar(c, count);
+    tail[count % TAIL_CHARS] = c;
+    if (isalpha(c)) {
+        wordSum += tolower(c) - 'a' + 1;
+    }
+    charSum += c;
+    weightedCharSum += c * count;
+    containsUpper |= isupper(c) != 0;
+    containsExclamation |= c == '!';
+    count++;
+}
+
+void HashState::update(const char* data, size_t length) {
+    for (size_t i = 0; i < length; ++i) {
+        absorb(data[i]);
+    }
+}
+
+void HashState::summarize(HashSummary& summary) const {
+    // The hashed string is the input followed by its decimal length
+    HashState state = *this;
+    char lengthDigits[24];
+    int digitCount = snprintf(lengthDigits, sizeof(lengthDigits), "%zu", count);
+    for (int d = 0; d < digitCount; ++d) {
+        state.absorb(lengthDigits[d]);
+    }
+
+    // After the reversal character i sits at position total - 1 - i and is salted with
+    // weight total - i, so the salt is total * sum(c) - sum(c * i)
+    size_t total = state.count;
+    summary = HashSummary();
+    summary.length = total;
+    summary.wordSum = state.wordSum;
+    summary.salt = total * state.charSum - state.weightedCharSum;
+    summary.containsUpper = state.containsUpper;
+    summary.containsExclamation = state.containsExclamation;
+    for (size_t r = 0; r < total && r < HEAD_CHARS; ++r) {
+        summary.head[r] = state.tail[(total - 1 - r) % TAIL_CHARS];
+    }
+
+    // inputToBits pads short inputs with whole copies of "blockchain" after the reversal
+    while (summary.length < 32) {
+        for (size_t p = 0; p < PADDING_LENGTH; ++p) {
+            accumulate(summary, PADDING[p], summary.length + p);
+        }
+        summary.length += PADDING_LENGTH;
+    }
+}
+
+Digest HashState::finalize() const {
+    HashSummary summary;
+    summarize(summary);
+    Digest digest;
+    finalizeSummary(summary, digest);
+    return digest;
+}
+
+bool HashState::meetsDifficulty(int leadingZeroBits) const {
+    if (leadingZeroBits <= 0) {
+        return true;
+    }
+    HashSummary summary;
+    summarize(summary);
+    Digest partial;
+    return finalizeSummary(summary, partial, leadingZeroBits);
+}
+
+Digest HashUtils::hash(const char* data, size_t length) {
+    HashState state;
+    state.update(data, length);
+    return state.finalize();
+}
+
+Digest HashUtils::hash(const std::string& input) {
+    return hash(input.data(), input.size());
+}
+
+void HashUtils::processHashBatch(const HashState* states, size_t count, Digest* digests) {
+    HashSummary summaries[BATCH_LANES];
+    bool passed[BATCH_LANES];
+    for (size_t base = 0; base < count; base += BATCH_LANES) {
+        size_t lanes = std::min(BATCH_LANES, count - base);
+        for (size_t k = 0; k < lanes; ++k) {
+            states[base + k].summarize(summaries[k]);
+        }
+        finalizeLanes(summaries, lanes, digests + base, passed, 0);
+    }
+}
+
+void HashUtils::meetsDifficultyBatch(const HashState* states, size_t count, int leadingZeroBits, bool* results) {
+    if (leadingZeroBits <= 0) {
+        std::fill(results, results + count, true);
+        return;
+    }
+    HashSummary summaries[BATCH_LANES];
+    Digest partial[BATCH_LANES];
+    for (size_t base = 0; base < count; base += BATCH_LANES) {
+        size_t lanes = std::min(BATCH_LANES, count - base);
+        for (size_t k = 0; k < lanes; ++k) {
+            states[base + k].summarize(summaries[k]);
+        }
+        finalizeLanes(summaries, lanes, partial, results + base, leadingZeroBits);
+    }
+}
+
+std::vector<Digest> HashUtils::processHashBatch(const std::vector<std::string>& inputs) {
+    std::vector<Digest> digests(inputs.size());
+    HashState states[BATCH_LANES];
+    for (size_t base = 0; base < inputs.size(); base += BATCH_LANES) {
+        size_t lanes = std::min(BATCH_LANES, inputs.size() - base);
+        for (size_t k = 0; k < lanes; ++k) {
+            states[k] = HashState();
+            states[k].update(inputs[base + k]);
+        }
+        processHashBatch(states, lanes, &digests[base]);
+    }
+    return digests;
+}
+
+const char* HashUtils::batchKernelName() {
+#ifdef HASH_HAVE_AVX2
+    if (selectKernel() == computeValuesAvx2) {
+        return "avx2";
+    }
+#endif
+    return "scalar";
+}
+
+void HashUtils::setScalarBatchKernel(bool forceScalar) {
+    forceScalarKernel.store(forceScalar, std::memory_order_relaxed);
+}
+
+// Function to process input and generate the hash
+std::string HashUtils::processHashInput(const std::string& input) {
+    return hash(input).toHex();
+}
@@ -2,10 +2,62 @@
 #define HASHUTILS_H
 
 #include <string>
+#include <vector>
+#include "digest.h"
+
+struct HashSummary;
+
+// Incremental form of HashUtils::hash. The algorithm appends the input length and
+// reverses the string, so the state keeps position-independent sums plus the last 64
+// characters and resolves positions in finalize(). A state that has absorbed a fixed
+// prefix can be copied and finished many times without touching the heap.
+class HashState {
+public:
+    HashState();
+
+    void update(const char* data, size_t length);
+    void update(const std::string& data) { update(data.data(), data.size()); }
+    Digest finalize() const; // Does not modify the state, so it can be reused
+    // True if the digest would start with at least leadingZeroBits zero bits. Only the
+    // leading nibbles covering those bits are computed and it stops at the first miss.
+    bool meetsDifficulty(int leadingZeroBits) const;
+    size_t size() const { return count; }
+
+private:
+    static const size_t TAIL_CHARS = 64;
+
+    char tail[TAIL_CHARS];  // Last modified characters, indexed by position % 64
+    size_t count;
+    unsigned long long charSum;          // Sum of modified characters
+    unsigned long long weightedCharSum;  // Sum of modified character * position
+    int wordSum;
+    bool containsUpper;
+    bool containsExclamation;
+
+    void absorb(char c);
+    void summarize(HashSummary& summary) const;
+
+    friend class HashUtils;
+};
 
 class HashUtils {
 public:
-    static std::string processHashInput(const std::string& input);
+    // Packed engine: bit-identical to the string based algorithm below, but works on
+    // 64-bit words and only touches the part of the input that can reach the output
+    static Digest hash(const char* data, size_t length);
+    static Digest hash(const std::string& input);
+
+    // Multi-buffer hashing: finishes several independent hashes in lockstep across SIMD
+    // lanes (AVX2 when the CPU supports it, a portable scalar kernel otherwise). Results
+    // are identical to hash() / HashState::finalize() for every input.
+    static std::vector<Digest> processHashBatch(const std::vector<std::string>& inputs);
+    static void processHashBatch(const HashState* states, size_t count, Digest* digests);
+    static void meetsDifficultyBatch(const HashState* states, size_t count, int leadingZeroBits, bool* results);
+    static const char* batchKernelName();
+    static void setScalarBatchKernel(bool forceScalar); // For differential checks and benchmarks
+
+    static std::string processHashInput(const std::string& input); // hash(input) as hex
+    static std::string processHashInputReference(const std::string& input); // original string based algorithm
     static std::string modifyInput(std::string& input);
     static std::string inputToBits(std::string& input);
     static char incrementHexChar(char hexChar);
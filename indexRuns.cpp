@@ -0,0 +1,610 @@
+#include "indexRuns.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <omp.h>
+
+static_assert(sizeof(IndexEntry) == 48, "IndexEntry layout changed");
+
+namespace {
+
+const uint32_t RUN_MAGIC = 0x4E555249;  // "IRUN"
+const uint32_t LIST_MAGIC = 0x54534C49; // "ILST"
+const uint32_t FORMAT_VERSION = 1;
+const uint32_t MAX_DIRECTORY_BITS = 24;
+const uint64_t MAX_RUNS = 64;
+const uint64_t NOT_WRITTEN = ~0ULL;
+
+struct ListHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t tag;
+    uint64_t nextFile;
+    uint64_t blocks;
+    Digest tip;
+    uint64_t runCount; // Followed by the run file numbers and a u64 checksum
+};
+
+uint64_t checksum(const void* data, size_t length, uint64_t hash = 14695981039346656037ULL) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < length; ++i) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+// FNV-1a over everything but the checksum field itself
+uint32_t entryChecksum(const IndexEntry& entry) {
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(&entry);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(IndexEntry, checksum); ++i) {
+        hash ^= data[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+uint64_t keyHash(const Digest& key) {
+    return static_cast<uint64_t>(DigestHasher()(key));
+}
+
+uint64_t bucketOf(uint64_t hash, uint32_t bits) {
+    return bits == 0 ? 0 : hash >> (64 - bits);
+}
+
+uint64_t align8(uint64_t bytes) {
+    return (bytes + 7) & ~7ULL;
+}
+
+struct EntryOrder {
+    bool operator()(const IndexEntry& a, const IndexEntry& b) const {
+        uint64_t ha = keyHash(a.key), hb = keyHash(b.key);
+        if (ha != hb) return ha < hb;
+        if (a.kind != b.kind) return a.kind < b.kind;
+        if (a.key != b.key) return a.key < b.key;
+        if (a.height != b.height) return a.height < b.height;
+        return a.position < b.position;
+    }
+};
+
+bool writeAll(int fd, const void* data, size_t length) {
+    const uint8_t* source = static_cast<const uint8_t*>(data);
+    while (length > 0) {
+        ssize_t written = write(fd, source, length);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        source += written;
+        length -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+bool writeFile(const std::string& path, const void* data, size_t length, bool sync) {
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = writeAll(fd, data, length) && (!sync || fdatasync(fd) == 0);
+    return ::close(fd) == 0 && written;
+}
+
+// Reads and checks the list at `path`; `files` is filled in even if the tag differs
+bool readList(const std::string& path, uint64_t tag, ListHeader& header, std::vector<uint64_t>& files) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != LIST_MAGIC ||
+        header.version != FORMAT_VERSION || header.runCount > MAX_RUNS) {
+        return false;
+    }
+    files.assign(header.runCount, 0);
+    uint64_t stored = 0;
+    in.read(reinterpret_cast<char*>(files.data()), static_cast<std::streamsize>(files.size() * sizeof(uint64_t)));
+    in.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+    if (!in || stored != checksum(files.data(), files.size() * sizeof(uint64_t), checksum(&header, sizeof(header)))) {
+        files.clear();
+        return false;
+    }
+    return header.tag == tag;
+}
+
+} // namespace
+
+// One immutable run, either built in memory or mapped from its file:
+// [Header][IndexEntry x entryCount][u32 directory x (2^bits + 1)] padded to 8 bytes,
+// then with records [u64 record offsets x (blocks + 1)][records, each padded to 8 bytes].
+// Directory slot b holds the first entry whose key hash has b as its top bits.
+class IndexRuns::Run {
+public:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t tag;
+        uint64_t firstHeight;
+        uint64_t endHeight;
+        uint64_t entryCount;
+        uint64_t kindCounts[KINDS];
+        uint64_t recordBytes;
+        uint32_t directoryBits;
+        uint32_t hasRecords;
+        uint64_t checksum; // Of everything above
+    };
+
+    Header header;
+    const IndexEntry* entries = nullptr;
+    const uint32_t* directory = nullptr;
+    const uint64_t* recordOffsets = nullptr;
+    const uint8_t* records = nullptr;
+    uint64_t size = 0;
+
+    Run() : header() {}
+    ~Run() {
+        if (mapped != nullptr) {
+            munmap(mapped, size);
+        }
+    }
+
+    Run(const Run&) = delete;
+    Run& operator=(const Run&) = delete;
+
+    size_t blocks() const { return static_cast<size_t>(header.endHeight - header.firstHeight); }
+
+    static std::shared_ptr<Run> build(const std::vector<IndexEntry>& sorted, const std::vector<uint64_t>& offsets,
+                                      const std::vector<uint8_t>& recordData, uint64_t firstHeight, uint64_t endHeight,
+                                      uint64_t tag) {
+        Header header = Header();
+        header.magic = RUN_MAGIC;
+        header.version = FORMAT_VERSION;
+        header.tag = tag;
+        header.firstHeight = firstHeight;
+        header.endHeight = endHeight;
+        header.entryCount = sorted.size();
+        for (const IndexEntry& entry : sorted) {
+            header.kindCounts[entry.kind % KINDS]++;
+        }
+        header.recordBytes = recordData.size();
+        header.hasRecords = !offsets.empty();
+        // About 4 to 8 entries per directory slot
+        while (header.directoryBits < MAX_DIRECTORY_BITS && (8ULL << header.directoryBits) <= sorted.size()) {
+            header.directoryBits++;
+        }
+        header.checksum = checksum(&header, offsetof(Header, checksum));
+
+        auto run = std::make_shared<Run>();
+        uint64_t directoryOffset, recordsOffset;
+        uint64_t total = layout(header, directoryOffset, recordsOffset);
+        run->buffer.assign(static_cast<size_t>(align8(total) / 8), 0);
+        uint8_t* base = reinterpret_cast<uint8_t*>(run->buffer.data());
+        std::memcpy(base, &header, sizeof(header));
+        if (!sorted.empty()) {
+            std::memcpy(base + sizeof(Header), sorted.data(), sorted.size() * sizeof(IndexEntry));
+        }
+        uint32_t* slots = reinterpret_cast<uint32_t*>(base + directoryOffset);
+        size_t next = 0;
+        for (uint64_t slot = 0; slot <= (1ULL << header.directoryBits); ++slot) {
+            while (next < sorted.size() && bucketOf(keyHash(sorted[next].key), header.directoryBits) < slot) {
+                ++next;
+            }
+            slots[slot] = static_cast<uint32_t>(next);
+        }
+        if (header.hasRecords) {
+            std::memcpy(base + recordsOffset - offsets.size() * sizeof(uint64_t), offsets.data(),
+                        offsets.size() * sizeof(uint64_t));
+            if (!recordData.empty()) {
+                std::memcpy(base + recordsOffset, recordData.data(), recordData.size());
+            }
+        }
+        run->attach(base, total, tag);
+        return run;
+    }
+
+    static std::shared_ptr<Run> map(const std::string& path, uint64_t tag) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return nullptr;
+        }
+        struct stat status;
+        void* address = MAP_FAILED;
+        if (fstat(fd, &status) == 0 && status.st_size > 0) {
+            address = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_SHARED, fd, 0);
+        }
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            return nullptr;
+        }
+        auto run = std::make_shared<Run>();
+        run->mapped = address;
+        run->size = static_cast<uint64_t>(status.st_size);
+        if (!run->attach(static_cast<const uint8_t*>(address), run->size, tag)) {
+            return nullptr;
+        }
+        return run;
+    }
+
+    bool writeTo(const std::string& path, bool sync) const {
+        const void* base = mapped != nullptr ? mapped : static_cast<const void*>(buffer.data());
+        return writeFile(path, base, static_cast<size_t>(size), sync);
+    }
+
+    // Calls `visit` on the intact entries of `kind` for `key` in (height, position) order
+    // until it returns false
+    template <typename Visit>
+    void visit(uint32_t kind, const Digest& key, uint64_t hash, Visit visit) const {
+        uint64_t slot = bucketOf(hash, header.directoryBits);
+        const IndexEntry* end = entries + std::min<uint64_t>(directory[slot + 1], header.entryCount);
+        const IndexEntry* entry = std::lower_bound(
+            entries + std::min<uint64_t>(directory[slot], header.entryCount), end, 0,
+            [&](const IndexEntry& candidate, int) {
+                uint64_t candidateHash = keyHash(candidate.key);
+                if (candidateHash != hash) return candidateHash < hash;
+                if (candidate.kind != kind) return candidate.kind < kind;
+                return candidate.key < key;
+            });
+        for (; entry < end && entry->kind == kind && entry->key == key; ++entry) {
+            if (entryChecksum(*entry) == entry->checksum && !visit(*entry)) {
+                return;
+            }
+        }
+    }
+
+private:
+    std::vector<uint64_t> buffer; // Built in memory
+    void* mapped = nullptr;       // Or mapped from a file
+
+    // Total size; also the offsets of the directory and of the records
+    static uint64_t layout(const Header& header, uint64_t& directoryOffset, uint64_t& recordsOffset) {
+        directoryOffset = sizeof(Header) + header.entryCount * sizeof(IndexEntry);
+        recordsOffset = align8(directoryOffset + ((1ULL << header.directoryBits) + 1) * sizeof(uint32_t));
+        if (header.hasRecords) {
+            recordsOffset += (header.endHeight - header.firstHeight + 1) * sizeof(uint64_t);
+        }
+        return recordsOffset + header.recordBytes;
+    }
+
+    bool attach(const uint8_t* base, uint64_t length, uint64_t tag) {
+        if (length < sizeof(Header)) {
+            return false;
+        }
+        std::memcpy(&header, base, sizeof(Header));
+        if (header.magic != RUN_MAGIC || header.version != FORMAT_VERSION || header.tag != tag ||
+            header.checksum != checksum(&header, offsetof(Header, checksum)) ||
+            header.directoryBits > MAX_DIRECTORY_BITS || header.endHeight < header.firstHeight ||
+            header.entryCount > length / sizeof(IndexEntry) || header.recordBytes > length ||
+            header.endHeight - header.firstHeight > length) {
+            return false;
+        }
+        uint64_t directoryOffset, recordsOffset;
+        if (layout(header, directoryOffset, recordsOffset) != length) {
+            return false;
+        }
+        size = length;
+        entries = reinterpret_cast<const IndexEntry*>(base + sizeof(Header));
+        directory = reinterpret_cast<const uint32_t*>(base + directoryOffset);
+        if (header.hasRecords) {
+            recordOffsets = reinterpret_cast<const uint64_t*>(base + recordsOffset) - (blocks() + 1);
+            records = base + recordsOffset;
+        }
+        return true;
+    }
+};
+
+IndexEntry IndexRuns::makeEntry(const Digest& key, uint32_t kind, uint32_t height, uint32_t position) {
+    IndexEntry entry;
+    entry.key = key;
+    entry.kind = kind;
+    entry.height = height;
+    entry.position = position;
+    entry.checksum = entryChecksum(entry);
+    return entry;
+}
+
+bool IndexRuns::View::findFirst(uint32_t kind, const Digest& key, IndexEntry& found) const {
+    uint64_t hash = keyHash(key);
+    bool hit = false;
+    for (size_t i = 0; i < runs.size() && !hit; ++i) {
+        runs[i]->visit(kind, key, hash, [&](const IndexEntry& entry) {
+            found = entry;
+            hit = true;
+            return false;
+        });
+    }
+    return hit;
+}
+
+void IndexRuns::View::findAll(uint32_t kind, const Digest& key, std::vector<IndexEntry>& found) const {
+    uint64_t hash = keyHash(key);
+    for (const auto& run : runs) {
+        run->visit(kind, key, hash, [&](const IndexEntry& entry) {
+            found.push_back(entry);
+            return true;
+        });
+    }
+}
+
+size_t IndexRuns::View::count(uint32_t kind) const {
+    size_t total = 0;
+    for (const auto& run : runs) {
+        total += static_cast<size_t>(run->header.kindCounts[kind % KINDS]);
+    }
+    return total;
+}
+
+const uint8_t* IndexRuns::View::record(size_t height, size_t& bytes) const {
+    bytes = 0;
+    auto after = std::upper_bound(runs.begin(), runs.end(), height,
+                                  [](size_t h, const std::shared_ptr<const Run>& run) { return h < run->header.firstHeight; });
+    if (after == runs.begin()) {
+        return nullptr;
+    }
+    const Run& run = **(after - 1);
+    if (height >= run.header.endHeight || !run.header.hasRecords) {
+        return nullptr;
+    }
+    size_t index = height - static_cast<size_t>(run.header.firstHeight);
+    uint64_t begin = run.recordOffsets[index], end = run.recordOffsets[index + 1];
+    if (begin > end || end > run.header.recordBytes) {
+        return nullptr;
+    }
+    bytes = static_cast<size_t>(end - begin);
+    return run.records + begin;
+}
+
+size_t IndexRuns::View::entryBytes() const {
+    size_t total = 0;
+    for (const auto& run : runs) {
+        total += static_cast<size_t>(run->header.entryCount * sizeof(IndexEntry));
+    }
+    return total;
+}
+
+size_t IndexRuns::View::recordBytes() const {
+    size_t total = 0;
+    for (const auto& run : runs) {
+        total += static_cast<size_t>(run->header.recordBytes);
+    }
+    return total;
+}
+
+IndexRuns::IndexRuns(int threadCount)
+    : threadCount(threadCount > 0 ? threadCount : omp_get_max_threads()), listTag(0), nextFile(0), syncWrites(true),
+      published(std::make_shared<const View>()) {}
+
+IndexRuns::~IndexRuns() {}
+
+std::string IndexRuns::runPath(uint64_t file) const {
+    return listPath + "." + std::to_string(file);
+}
+
+std::shared_ptr<const IndexRuns::View> IndexRuns::view() const {
+    return std::atomic_load(&published);
+}
+
+bool IndexRuns::open(const std::string& path, uint64_t tag) {
+    close();
+    listPath = path;
+    listTag = tag;
+    auto opened = std::make_shared<View>();
+    bool usable = path.empty();
+    ListHeader header;
+    if (!usable && readList(listPath, tag, header, files)) {
+        nextFile = header.nextFile;
+        usable = true;
+        for (uint64_t file : files) {
+            std::shared_ptr<const Run> run = Run::map(runPath(file), tag);
+            if (!run || run->header.firstHeight != opened->blocks) {
+                usable = false;
+                break;
+            }
+            opened->runs.push_back(run);
+            opened->blocks = static_cast<size_t>(run->header.endHeight);
+        }
+        usable = usable && opened->blocks == header.blocks;
+        opened->tipID = header.tip;
+    }
+    // Whatever the list named is kept in `files`, so clear() can delete it
+    if (!usable) {
+        opened = std::make_shared<View>();
+        nextFile = std::max<uint64_t>(nextFile, files.empty() ? 0 : *std::max_element(files.begin(), files.end()) + 1);
+    }
+    std::atomic_store(&published, std::shared_ptr<const View>(opened));
+    return usable;
+}
+
+void IndexRuns::clear() {
+    if (!listPath.empty()) {
+        // The list goes first, so it never names a deleted run
+        std::remove(listPath.c_str());
+        for (uint64_t file : files) {
+            std::remove(runPath(file).c_str());
+        }
+    }
+    files.clear();
+    std::atomic_store(&published, std::make_shared<const View>());
+}
+
+void IndexRuns::close() {
+    listPath.clear();
+    files.clear();
+    nextFile = 0;
+}
+
+void IndexRuns::removeFiles(const std::string& path) {
+    ListHeader header;
+    std::vector<uint64_t> files;
+    readList(path, 0, header, files);
+    std::remove(path.c_str());
+    for (uint64_t file : files) {
+        std::remove((path + "." + std::to_string(file)).c_str());
+    }
+}
+
+// Sorts (key hash, entry number) pairs, so every key is hashed once: chunks are sorted on
+// all threads and neighbouring chunks merged pairwise, then the entries are gathered
+void IndexRuns::sortEntries(std::vector<IndexEntry>& entries) const {
+    struct Keyed {
+        uint64_t hash;
+        size_t index;
+    };
+    std::vector<Keyed> keyed(entries.size());
+    #pragma omp parallel for schedule(static) num_threads(threadCount)
+    for (long long i = 0; i < static_cast<long long>(entries.size()); ++i) {
+        keyed[i] = Keyed{keyHash(entries[i].key), static_cast<size_t>(i)};
+    }
+    auto before = [&entries](const Keyed& a, const Keyed& b) {
+        return a.hash != b.hash ? a.hash < b.hash : EntryOrder()(entries[a.index], entries[b.index]);
+    };
+
+    size_t chunks = entries.size() < 4096 ? 1 : static_cast<size_t>(threadCount);
+    std::vector<size_t> bounds(chunks + 1);
+    for (size_t c = 0; c <= chunks; ++c) {
+        bounds[c] = entries.size() * c / chunks;
+    }
+    #pragma omp parallel for schedule(static, 1) num_threads(threadCount)
+    for (long long c = 0; c < static_cast<long long>(chunks); ++c) {
+        std::sort(keyed.begin() + bounds[c], keyed.begin() + bounds[c + 1], before);
+    }
+    std::vector<Keyed> merged(chunks > 1 ? keyed.size() : 0);
+    for (size_t width = 1; width < chunks; width *= 2) {
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threadCount)
+        for (long long c = 0; c < static_cast<long long>(chunks); c += static_cast<long long>(2 * width)) {
+            size_t low = bounds[c];
+            size_t middle = bounds[std::min(static_cast<size_t>(c) + width, chunks)];
+            size_t high = bounds[std::min(static_cast<size_t>(c) + 2 * width, chunks)];
+            std::merge(keyed.begin() + low, keyed.begin() + middle, keyed.begin() + middle, keyed.begin() + high,
+                       merged.begin() + low, before);
+        }
+        keyed.swap(merged);
+    }
+
+    std::vector<IndexEntry> sorted(entries.size());
+    #pragma omp parallel for schedule(static) num_threads(threadCount)
+    for (long long i = 0; i < static_cast<long long>(entries.size()); ++i) {
+        sorted[i] = entries[keyed[i].index];
+    }
+    entries.swap(sorted);
+}
+
+bool IndexRuns::add(std::vector<IndexEntry>& entries, const std::vector<std::vector<uint8_t>>* records,
+                    size_t endHeight, const Digest& tip) {
+    std::shared_ptr<const View> current = view();
+    if (endHeight <= current->blocks) {
+        return true;
+    }
+    if (records != nullptr && records->size() != endHeight - current->blocks) {
+        return false;
+    }
+    sortEntries(entries);
+    std::vector<uint64_t> offsets;
+    std::vector<uint8_t> recordData;
+    if (records != nullptr) {
+        offsets.push_back(0);
+        for (const auto& record : *records) {
+            recordData.insert(recordData.end(), record.begin(), record.end());
+            recordData.resize(static_cast<size_t>(align8(recordData.size())), 0);
+            offsets.push_back(recordData.size());
+        }
+    }
+
+    auto next = std::make_shared<View>(*current);
+    std::vector<uint64_t> nextFiles = files;
+    nextFiles.resize(next->runs.size(), NOT_WRITTEN);
+    next->runs.push_back(Run::build(entries, offsets, recordData, current->blocks, endHeight, listTag));
+    nextFiles.push_back(NOT_WRITTEN);
+    next->blocks = endHeight;
+    next->tipID = tip;
+
+    // Binary-counter merging: runs shrink from the oldest to the newest
+    while (next->runs.size() >= 2 && next->runs[next->runs.size() - 2]->blocks() <= next->runs.back()->blocks()) {
+        const Run& older = *next->runs[next->runs.size() - 2];
+        const Run& newer = *next->runs.back();
+        std::vector<IndexEntry> merged(static_cast<size_t>(older.header.entryCount + newer.header.entryCount));
+        std::merge(older.entries, older.entries + older.header.entryCount, newer.entries,
+                   newer.entries + newer.header.entryCount, merged.begin(), EntryOrder());
+        offsets.clear();
+        recordData.clear();
+        if (older.header.hasRecords && newer.header.hasRecords) {
+            offsets.assign(older.recordOffsets, older.recordOffsets + older.blocks() + 1);
+            for (size_t i = 1; i <= newer.blocks(); ++i) {
+                offsets.push_back(older.header.recordBytes + newer.recordOffsets[i]);
+            }
+            recordData.assign(older.records, older.records + older.header.recordBytes);
+            recordData.insert(recordData.end(), newer.records, newer.records + newer.header.recordBytes);
+        }
+        std::shared_ptr<const Run> combined =
+            Run::build(merged, offsets, recordData, older.header.firstHeight, newer.header.endHeight, listTag);
+        next->runs.resize(next->runs.size() - 2);
+        next->runs.push_back(combined);
+        nextFiles.resize(nextFiles.size() - 2);
+        nextFiles.push_back(NOT_WRITTEN);
+    }
+
+    bool written = true;
+    if (!listPath.empty()) {
+        // New runs are written and mapped back, so built buffers do not stay in memory
+        uint64_t firstNew = nextFile;
+        for (size_t i = 0; i < next->runs.size() && written; ++i) {
+            if (nextFiles[i] != NOT_WRITTEN) {
+                continue;
+            }
+            nextFiles[i] = nextFile++;
+            std::shared_ptr<const Run> mapped;
+            written = next->runs[i]->writeTo(runPath(nextFiles[i]), syncWrites) &&
+                      (mapped = Run::map(runPath(nextFiles[i]), listTag)) != nullptr;
+            if (written) {
+                next->runs[i] = mapped;
+            }
+        }
+        written = written && writeList(*next, nextFiles);
+        if (written) {
+            for (uint64_t file : files) {
+                if (std::find(nextFiles.begin(), nextFiles.end(), file) == nextFiles.end()) {
+                    std::remove(runPath(file).c_str());
+                }
+            }
+            files = nextFiles;
+        } else {
+            // The old list still stands; the runs stay in memory and nothing more is written
+            for (uint64_t file = firstNew; file < nextFile; ++file) {
+                std::remove(runPath(file).c_str());
+            }
+            close();
+        }
+    }
+    std::atomic_store(&published, std::shared_ptr<const View>(next));
+    return written;
+}
+
+bool IndexRuns::writeList(const View& listed, const std::vector<uint64_t>& runFiles) const {
+    ListHeader header = ListHeader();
+    header.magic = LIST_MAGIC;
+    header.version = FORMAT_VERSION;
+    header.tag = listTag;
+    header.nextFile = nextFile;
+    header.blocks = listed.blocks;
+    header.tip = listed.tipID;
+    header.runCount = runFiles.size();
+    std::vector<uint8_t> bytes(sizeof(header) + runFiles.size() * sizeof(uint64_t));
+    std::memcpy(bytes.data(), &header, sizeof(header));
+    std::memcpy(bytes.data() + sizeof(header), runFiles.data(), runFiles.size() * sizeof(uint64_t));
+    uint64_t sum = checksum(runFiles.data(), runFiles.size() * sizeof(uint64_t), checksum(&header, sizeof(header)));
+    bytes.insert(bytes.end(), reinterpret_cast<const uint8_t*>(&sum), reinterpret_cast<const uint8_t*>(&sum) + sizeof(sum));
+
+    // Written aside and renamed, so a crash leaves either the old or the new list
+    std::string temporary = listPath + ".tmp";
+    if (!writeFile(temporary, bytes.data(), bytes.size(), syncWrites)) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return std::rename(temporary.c_str(), listPath.c_str()) == 0;
+}
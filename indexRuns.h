@@ -0,0 +1,115 @@
+#ifndef INDEXRUNS_H
+#define INDEXRUNS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include "digest.h"
+
+// One key of an IndexRuns: `kind` keeps apart the lookups an index stores in the same
+// runs, height and position say where the key occurs. 48 bytes with its own checksum.
+struct IndexEntry {
+    Digest key;
+    uint32_t kind;
+    uint32_t height;
+    uint32_t position;
+    uint32_t checksum;
+};
+
+// Immutable sorted runs of IndexEntry, the storage under ChainIndex and AddressIndex.
+//
+// add() turns the entries of the blocks indexed since the last call into a new run,
+// sorted by (key hash, kind, key, height, position) behind a directory on the top bits of
+// the key hash, so a lookup touches about one cache line per run. A run can also keep one
+// opaque record per block (e.g. a Bloom filter). While the older of the last two runs
+// covers no more blocks than the newer one the two are merged, so there are at most
+// log2(blocks) + 1 runs and every entry is rewritten O(log blocks) times.
+//
+// A run is never modified once built. add() publishes a new View, the list of runs at
+// that point, with an atomic shared_ptr store: any number of threads can take views and
+// look keys up while one thread adds, without locks, and a view keeps its runs alive.
+//
+// With a path every run is a file "<path>.<n>" mapped read-only, and "<path>" lists the
+// runs, the number of blocks they cover and the ID of the last of them. The list is
+// written aside and renamed over the old one once the run files are on disk, and runs it
+// no longer names are deleted afterwards, so a crash leaves the old or the new list.
+// open() reads the list and the run headers only, so it costs the same at any chain
+// length; an entry is checked against its checksum when a lookup reads it, and a damaged
+// one is never returned. Without a path the runs are kept in memory.
+class IndexRuns {
+public:
+    static const uint32_t KINDS = 4;
+
+    class Run;
+
+    // The runs as of one add(), covering blocks [0, blockCount())
+    class View {
+    public:
+        size_t blockCount() const { return blocks; }
+        const Digest& tip() const { return tipID; } // ID of the last block, zero while empty
+
+        // Entry of `kind` for `key` at the lowest height; false if there is none
+        bool findFirst(uint32_t kind, const Digest& key, IndexEntry& found) const;
+        // Every entry of `kind` for `key`, appended run by run and within a run by (height, position)
+        void findAll(uint32_t kind, const Digest& key, std::vector<IndexEntry>& found) const;
+        size_t count(uint32_t kind) const;
+
+        // Record of block `height`, null with `bytes` 0 if the runs keep none
+        const uint8_t* record(size_t height, size_t& bytes) const;
+        size_t entryBytes() const;
+        size_t recordBytes() const;
+
+    private:
+        std::vector<std::shared_ptr<const Run>> runs; // By height
+        size_t blocks = 0;
+        Digest tipID;
+
+        friend class IndexRuns;
+    };
+
+    static IndexEntry makeEntry(const Digest& key, uint32_t kind, uint32_t height, uint32_t position);
+
+    explicit IndexRuns(int threadCount = 0); // 0 uses all available OpenMP threads
+    ~IndexRuns();
+
+    IndexRuns(const IndexRuns&) = delete;
+    IndexRuns& operator=(const IndexRuns&) = delete;
+
+    // Opens the runs listed at `path`; false, and no runs, if the list or a run is missing,
+    // damaged or was written under another `tag`. An empty path keeps the runs in memory.
+    bool open(const std::string& path, uint64_t tag);
+    // Drops every run, deleting its file; the next add() starts over at height 0
+    void clear();
+    // Adds the entries of blocks [blockCount(), endHeight), sorting `entries`; `tip` is
+    // the ID of block endHeight - 1. `records` holds one record per block, or is null
+    // if these runs keep none.
+    bool add(std::vector<IndexEntry>& entries, const std::vector<std::vector<uint8_t>>* records, size_t endHeight,
+             const Digest& tip);
+    // Stops writing; views already taken keep working
+    void close();
+    // Syncing run files before they are listed (the default) keeps the list from naming a
+    // run a crash lost; benchmarks and throwaway indexes can turn it off
+    void setSyncWrites(bool sync) { syncWrites = sync; }
+
+    size_t blockCount() const { return view()->blockCount(); }
+    std::shared_ptr<const View> view() const;
+
+    // Deletes the list at `path` and every run it names
+    static void removeFiles(const std::string& path);
+
+private:
+    int threadCount;
+    std::string listPath;
+    uint64_t listTag;
+    uint64_t nextFile;
+    bool syncWrites;
+    std::vector<uint64_t> files; // Run file numbers, parallel to the current view's runs
+    std::shared_ptr<const View> published;
+
+    void sortEntries(std::vector<IndexEntry>& entries) const;
+    bool writeList(const View& view, const std::vector<uint64_t>& runFiles) const;
+    std::string runPath(uint64_t file) const;
+};
+
+#endif // INDEXRUNS_H
@@ -1,69 +1,206 @@
 // main.cpp
 #include <iostream>
 #include "mainFunctions.h"
+#include "metrics.h"
+#include "queryServer.h"
+#include <cerrno>
 #include <cstdlib>
+#include <cstring>
 #include <ctime>
-#include <limits>
+#include <fstream>
+#include <string>
+#include <unistd.h>
 
-int main() {
-    srand(static_cast<unsigned int>(time(0)));
+int main(int argc, char* argv[]) {
+    // The whole workload follows from one seed; pass it back as the first argument to replay a run.
+    // --port N also serves queries on 127.0.0.1:N next to the Unix socket.
+    // --batch FILE [--output FILE] answers a query file against the stored chain and exits.
+    // --export FILE writes the stored chain as text (the old blockchain.txt) and exits.
+    // --sync SOCKET[,SOCKET...] fetches the chain from sync peers (chain_sync --serve) instead of mining it.
+    // --pool N mines on N worker processes of this binary, started with --pool-worker SOCKET.
+    uint64_t seed = static_cast<uint64_t>(time(0));
+    int queryPort = 0;
+    std::string batchPath, outputPath = "batch_results.jsonl", exportPath;
+    std::vector<std::string> syncPeers;
+    size_t poolWorkers = 0;
+    std::string poolWorkerPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--port" && i + 1 < argc) {
+            queryPort = std::atoi(argv[++i]);
+        } else if (arg == "--batch" && i + 1 < argc) {
+            batchPath = argv[++i];
+        } else if (arg == "--output" && i + 1 < argc) {
+            outputPath = argv[++i];
+        } else if (arg == "--export" && i + 1 < argc) {
+            exportPath = argv[++i];
+        } else if (arg == "--sync" && i + 1 < argc) {
+            std::string list = argv[++i];
+            for (size_t begin = 0, end; begin <= list.size(); begin = end + 1) {
+                end = std::min(list.find(',', begin), list.size());
+                if (end > begin) {
+                    syncPeers.push_back(list.substr(begin, end - begin));
+                }
+            }
+        } else if (arg == "--pool" && i + 1 < argc) {
+            poolWorkers = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--pool-worker" && i + 1 < argc) {
+            poolWorkerPath = argv[++i];
+        } else {
+            seed = std::strtoull(argv[i], nullptr, 10);
+        }
+    }
+    if (!poolWorkerPath.empty()) {
+        return PoolWorker("worker-" + std::to_string(::getpid())).run(poolWorkerPath) ? 0 : 1;
+    }
+    if (!exportPath.empty()) {
+        BlockStore store;
+        if (!store.open("blockchain.dat") || store.size() == 0) {
+            std::cout << "Export needs a stored chain in blockchain.dat\n";
+            return 1;
+        }
+        exportBlocksToFile(store, exportPath);
+        std::cout << "Exported " << store.size() << " blocks to " << exportPath << "\n";
+        return 0;
+    }
+    std::cout << "Workload seed: " << seed << std::endl;
+    WorkloadGenerator generator(seed);
     int userNumber = 60, transactionNumber = 2000;
 
-    std::vector<User> users = generateUsers(userNumber);
+    std::vector<User> users = generateUsers(userNumber, generator);
+    if (!batchPath.empty()) {
+        // No mining: balances are replayed from the stored chain for this seed's users
+        BlockStore store;
+        if (!store.open("blockchain.dat") || store.size() == 0) {
+            std::cout << "Batch mode needs a stored chain in blockchain.dat\n";
+            return 1;
+        }
+        AccountSnapshots snapshots("accounts", 10);
+        verifyStoredChain(store, users, "blockchain.checkpoint", &snapshots);
+        ChainIndex index;
+        bool indexed = index.open("blockchain.lookup", store);
+        return runBatchQueries(batchPath, outputPath, store, indexed ? &index : nullptr,
+                               AccountState::fromUsers(users)) ? 0 : 1;
+    }
+    if (!syncPeers.empty()) {
+        // No mining: blockchain.dat is extended from the peers, after checking what is already there
+        BlockStore store;
+        if (!store.open("blockchain.dat")) {
+            std::cout << "Could not open blockchain.dat\n";
+            return 1;
+        }
+        AccountSnapshots snapshots("accounts", 10);
+        if (store.size() > 0 && !verifyStoredChain(store, users, "blockchain.checkpoint", &snapshots)) {
+            return 1;
+        }
+        bool synced = syncChain(syncPeers, store, users);
+        saveUsersToFile(users, "users.txt");
+        return synced ? 0 : 1;
+    }
     saveUsersToFile(users, "users.txt");
     saveUsersToFile(users, "createdUsers.txt");
-    std::vector<Transaction> transactionPool = generateTransactions(transactionNumber, users);
-    saveTransactionsToFile(transactionPool, "transactions.txt");
+    // The workload is drawn from the created users' balances and streamed into the mempool
+    // chunk by chunk, each chunk also going to transactions.txt; it is never held whole
+    const std::vector<User> createdUsers = users;
+    std::ofstream transactionsFile("transactions.txt");
+    TransactionSource transactions = [&](const WorkloadGenerator::TransactionConsumer& consumer) {
+        generateTransactions(transactionNumber, createdUsers, generator, [&](std::vector<Transaction>& chunk) {
+            writeTransactions(transactionsFile, chunk);
+            consumer(chunk);
+        });
+        transactionsFile.close();
+    };
 
-    std::vector<Block> blockchain = mineBlockchain(transactionPool, users);
-    saveBlocksToFile(blockchain, "blockchain.txt");
-
-    // Save updated user balances to file again after mining
-    saveUsersToFile(users, "users.txt");
+    // Mined blocks are appended to the binary store; a text dump is only written by --export
+    BlockStore store;
+    if (!store.open("blockchain.dat")) {
+        std::cout << "Could not open blockchain.dat, blocks are kept in memory only\n";
+    } else if (store.discardedBytes() > 0) {
+        std::cout << "Block store: dropped " << store.discardedBytes() << " bytes of an incomplete block\n";
+    }
+    // Account state is snapshotted every 10 blocks, so a restart replays at most that many
+    AccountSnapshots snapshots("accounts", 10);
+    // A resumed chain is checked past its last signed checkpoint and its balances replayed;
+    // a chain that fails is left untouched and this run mines in memory only
+    if (store.isOpen() && store.size() > 0 &&
+        !verifyStoredChain(store, users, "blockchain.checkpoint", &snapshots)) {
+        store.close();
+        std::cout << "Not extending blockchain.dat, blocks are kept in memory only\n";
+    }
+    // Block, Merkle root and transaction lookups over the store, extended as blocks are stored
+    ChainIndex chainIndex;
+    bool indexed = store.isOpen() && chainIndex.open("blockchain.lookup", store);
+    // Metrics go to metrics.prom / metrics.json every second; progress lines are printed from them
+    MetricsReporter reporter("metrics.prom", "metrics.json", 1.0);
+    reporter.addConsumer(MetricsReporter::progressPrinter());
+    reporter.start();
 
-    int choice;
-    do {
-        std::cout << "\nChoose what to do next:\n";
-        std::cout << "1. Find Block\n";
-        std::cout << "2. Find Transaction\n";
-        std::cout << "3. Find User\n";
-        std::cout << "4. Exit\n";
-        std::cout << "Enter your choice (1-4): ";
+    // Per-block address filters sized for a 1% false-positive rate, exact postings from 64 transactions;
+    // kept in blockchain.addresses next to the store, so a restart only indexes new blocks
+    AddressIndex addressIndex(0.01, 64);
+    if (store.isOpen() && !addressIndex.open("blockchain.addresses", store)) {
+        std::cout << "Could not write blockchain.addresses, the address index is kept in memory only\n";
+    }
 
-        // Input validation
-        while (!(std::cin >> choice) || choice < 1 || choice > 4) {
-            std::cin.clear(); // Clear error flag
-            std::cin.ignore(std::numeric_limits<std::streamsize>::max(), '\n'); // Discard invalid input
-            std::cout << "Invalid input. Please enter a number between 1 and 4: ";
+    // Block, transaction, user, balance and history queries are answered on blockchain.sock
+    // from chain snapshots published after every stored block, so they run alongside mining;
+    // hashes and addresses are looked up in the index views published with each snapshot,
+    // from an in-memory chain index when blockchain.lookup is not in use
+    ChainPublisher publisher(AccountState::fromUsers(users), store.isOpen() ? &store : nullptr,
+                             indexed ? &chainIndex : nullptr, &addressIndex);
+    QueryServer server(publisher);
+    bool serving = server.listenUnix("blockchain.sock") &&
+                   (queryPort <= 0 || server.listenTcp(static_cast<uint16_t>(queryPort))) && server.start();
+    if (serving) {
+        std::cout << "Answering queries on blockchain.sock";
+        if (queryPort > 0) {
+            std::cout << " and 127.0.0.1:" << queryPort;
         }
+        std::cout << std::endl;
+    } else {
+        std::cout << "Could not start the query server: " << std::strerror(errno) << std::endl;
+    }
 
-        switch (choice) {
-            case 1: {
-                std::string searchHash;
-                std::cout << "Enter Merkle Root Hash: ";
-                std::cin >> searchHash;
-                findBlock(searchHash, blockchain);
-                break;
-            }
-            case 2: {
-                std::string transactionID;
-                std::cout << "Enter Transaction ID: ";
-                std::cin >> transactionID;
-                findTransaction(transactionID, blockchain);
-                break;
-            }
-            case 3: {
-                std::string userName;
-                std::cout << "Enter User Name: ";
-                std::cin >> userName;
-                findUser(userName, users);
-                break;
-            }
-            case 4:
-                std::cout << "Exiting the program...\n";
-                break;
+    // The pool's workers are this binary again; without them every block is mined in this process
+    PoolCoordinator pool;
+    std::vector<pid_t> poolPids;
+    bool pooled = poolWorkers > 0 && pool.listen("blockchain-pool.sock") && pool.start() &&
+                  PoolCoordinator::spawnWorkers("/proc/self/exe", {"--pool-worker", "blockchain-pool.sock"},
+                                                poolWorkers, poolPids) &&
+                  pool.waitForWorkers(poolWorkers, 10.0);
+    if (pooled) {
+        std::cout << "Mining on " << poolWorkers << " pool worker processes through blockchain-pool.sock" << std::endl;
+    } else if (poolWorkers > 0) {
+        std::cout << "Could not start the mining pool, mining in this process" << std::endl;
+    }
+
+    snapshots.start();
+    mineBlockchain(transactions, users, 100, store.isOpen() ? &store : nullptr, indexed ? &chainIndex : nullptr,
+                   &addressIndex, &snapshots, &publisher, pooled ? &pool : nullptr, "blockchain.checkpoint");
+    snapshots.stop();
+    chainIndex.close();
+    addressIndex.close();
+    if (poolWorkers > 0) {
+        PoolCoordinator::Stats stats = pool.stats();
+        pool.stop(); // Closing the connections ends the workers
+        PoolCoordinator::reapWorkers(poolPids);
+        for (const auto& worker : stats.workers) {
+            std::cout << "Pool worker " << worker.name << ": " << worker.blocks << " blocks, " << worker.hashes
+                      << " hashes, " << worker.shares << " shares, " << worker.staleShares << " stale, "
+                      << worker.invalidShares << " invalid" << std::endl;
         }
-    } while (choice != 4);
+    }
+    reporter.stop();
+    reportAddressIndex(addressIndex);
+
+    // Save updated user balances to file again after mining
+    saveUsersToFile(users, "users.txt");
 
+    if (serving) {
+        std::cout << "\nMining finished; queries are still answered until stdin is closed or Enter is pressed\n";
+        std::string line;
+        std::getline(std::cin, line);
+        server.stop();
+    }
     return 0;
-}
\ No newline at end of file
+}
@@ -5,117 +5,271 @@
 #include <random>
 #include <ctime>
 #include "block.h"
+#include "mempool.h"
+#include "blockValidator.h"
+#include "boundedQueue.h"
+#include "metrics.h"
+#include <chrono>
+#include <memory>
+#include <thread>
 
-std::vector<User> generateUsers(int userNumber) {
-    std::vector<User> users;
+namespace {
+
+// Templates assembled ahead of mining, and mined blocks waiting to be persisted
+const size_t PIPELINE_DEPTH = 2;
+
+// One block moving through the production pipeline
+struct BlockJob {
+    std::unique_ptr<Block> block;
+    std::vector<int64_t> balances; // Account balances once this block is applied
+    size_t poolSize = 0;           // Pending transactions left when it was assembled
+};
+
+} // namespace
+
+std::vector<User> generateUsers(int userNumber, const WorkloadGenerator& generator) {
     std::cout << "Generating " << userNumber << " users" << std::endl;
-    for (int i = 1; i <= userNumber; ++i) {
-        std::string name = "User" + std::to_string(i);
-        std::string publicKey = HashUtils::processHashInput(name);
-        int balance = rand() % 1000000 + 100; // Random initial balance
-        users.emplace_back(name, publicKey, balance);
-    }
+    std::vector<User> users = generator.generateUsers(static_cast<size_t>(userNumber));
     std::cout << "User generation completed" << std::endl;
     return users;
 }
 
-std::vector<Transaction> generateTransactions(int transactionNumber, std::vector<User>& users) {
-    std::vector<Transaction> transactionPool;
+void generateTransactions(int transactionNumber, const std::vector<User>& users, const WorkloadGenerator& generator,
+                          const WorkloadGenerator::TransactionConsumer& consumer) {
     std::cout << "Generating " << transactionNumber << " transactions" << std::endl;
-    for (int i = 0; i < transactionNumber; ++i) {
-        int senderIndex, receiverIndex;
-        do {
-            senderIndex = rand() % users.size();
-        } while (users[senderIndex].getBalance() < 100); // Ensure the sender has at least 100 units
-
-        do {
-            receiverIndex = rand() % users.size();
-        } while (senderIndex == receiverIndex);
-
-        int amount = rand() % (users[senderIndex].getBalance() - 1) + 1; // Ensure the transaction amount is valid
-        std::string transactionID = HashUtils::processHashInput(users[senderIndex].getPublicKey() + users[receiverIndex].getPublicKey() + std::to_string(amount));
-        transactionPool.emplace_back(transactionID, users[senderIndex].getPublicKey(), users[receiverIndex].getPublicKey(), amount);
-    }
+    generator.generateTransactions(users, static_cast<size_t>(transactionNumber), consumer);
     std::cout << "Transactions generation completed" << std::endl;
-    return transactionPool;
-}
-
-Block createBlock(const std::vector<Transaction>& transactions, const std::string& previousHash) {
-    Block newBlock(previousHash, transactions, 1); // Set difficulty to 1 for mining
-    newBlock.mineBlock();
-    return newBlock;
 }
 
-std::vector<Block> mineBlockchain(std::vector<Transaction>& transactionPool, std::vector<User>& users) {
-    std::vector<Block> blockchain;
-
-    // Create and mine the genesis block
-    Block genesisBlock = Block::createGenesisBlock();
-    blockchain.push_back(genesisBlock);
+void mineBlockchain(const TransactionSource& transactions, std::vector<User>& users, size_t maxTransactionsPerBlock,
+                    BlockStore* store, ChainIndex* chainIndex, AddressIndex* addressIndex, AccountSnapshots* snapshots,
+                    ChainPublisher* publisher, PoolCoordinator* pool, const std::string& checkpointPath) {
+    AccountState accounts = AccountState::fromUsers(users); // O(1) lookups by public key
+
+    // Blocks are read back from the store, or without one from the publisher, which
+    // keeps them for the address index when the caller has no publisher of its own
+    std::unique_ptr<ChainPublisher> ownPublisher;
+    if (store == nullptr && publisher == nullptr && addressIndex != nullptr) {
+        ownPublisher.reset(new ChainPublisher(accounts));
+        publisher = ownPublisher.get();
+    }
+    BlockSource blocks = [store, publisher](size_t height) {
+        return store != nullptr ? store->view(height) : publisher->block(height);
+    };
+    auto chainHeight = [store, publisher]() -> size_t {
+        return store != nullptr ? store->size() : publisher != nullptr ? publisher->blockCount() : 0;
+    };
+
+    Digest previousHash;
+    if (store != nullptr && store->size() > 0) {
+        // Continue the stored chain from its tip; nothing below it is read
+        previousHash = store->view(store->size() - 1).header().blockID;
+        std::cout << "Resuming stored chain at height " << store->size() - 1 << ": " << previousHash << std::endl;
+    } else {
+        // Create and mine the genesis block
+        Block genesisBlock = Block::createGenesisBlock();
+        previousHash = genesisBlock.getBlockID();
+        if (store != nullptr && store->append(genesisBlock) && chainIndex != nullptr) {
+            chainIndex->catchUp(*store);
+        }
+        if (publisher != nullptr) {
+            publisher->append(genesisBlock);
+        }
+    }
+    if (addressIndex != nullptr) {
+        addressIndex->catchUp(blocks, chainHeight());
+    }
 
     // Proceed to mine subsequent blocks
-    const int maxTransactionsPerBlock = 100;
     std::ofstream failedTransactionsFile("failedTransactions.txt");
+    if (publisher != nullptr) {
+        publisher->publish(accounts.getBalances());
+    }
     int minedBlockIndex = 1; // Move initialization outside the loop
 
-    while (!transactionPool.empty()) {
-        std::vector<Transaction> validTransactions;
+    Metrics& metrics = Metrics::instance();
+    Metrics::Counter& validated = metrics.counter("transactions_validated_total", "Transaction IDs re-derived on intake");
+    Metrics::Counter& accepted = metrics.counter("transactions_accepted_total", "Transactions selected into blocks");
+    Metrics::Counter& rejectedTotal = metrics.counter("transactions_rejected_total", "Transactions rejected on intake or selection");
+    Metrics::Gauge& mempoolDepth = metrics.gauge("mempool_depth", "Pending transactions in the mempool");
+    Metrics::Histogram& assemblyLatency = metrics.histogram(
+        "block_assembly_seconds", "Time to select, check and build one block template", Metrics::latencyBuckets());
+    Metrics::Histogram& usersFileLatency = metrics.histogram(
+        "users_file_write_seconds", "Time to rewrite users.txt after a block", Metrics::latencyBuckets());
+
+    // The pool drops its oldest transactions when it is full; they are logged like rejections
+    auto logEvicted = [&](Mempool& pool) {
+        std::vector<Transaction> evicted = pool.takeEvicted();
+        for (const auto& transaction : evicted) {
+            failedTransactionsFile << "Evicted Transaction, mempool full: " << transaction.getTransactionID() << "\n";
+        }
+        rejectedTotal.add(evicted.size());
+    };
+
+    // Transactions arrive chunk by chunk and each chunk's IDs are re-derived on all cores
+    // before it enters the pool, so only the mempool ever holds the whole workload. A resumed
+    // run regenerates the same workload, so whatever the stored chain already holds is
+    // dropped here instead of being mined (and its balances applied) a second time
+    BlockValidator validator;
+    Mempool mempool;
+    ChainIndex::TransactionLocation stored;
+    transactions([&](std::vector<Transaction>& chunk) {
+        std::vector<char> idValid = validator.verifyTransactionIds(chunk);
+        validated.add(chunk.size());
+        for (size_t i = 0; i < chunk.size(); ++i) {
+            const auto& transaction = chunk[i];
+            if (!idValid[i]) {
+                failedTransactionsFile << "Rejected Transaction due to hash mismatch: " << transaction.getTransactionID() << "\n";
+                rejectedTotal.add();
+            } else if (chainIndex != nullptr && chainIndex->findTransaction(transaction.getTransactionID(), stored)) {
+                failedTransactionsFile << "Skipped Transaction already in block " << stored.height << ": "
+                                       << transaction.getTransactionID() << "\n";
+            } else if (mempool.add(transaction) == Mempool::DUPLICATE) {
+                failedTransactionsFile << "Rejected Transaction due to duplicate ID: " << transaction.getTransactionID() << "\n";
+                rejectedTotal.add();
+            }
+        }
+        logEvicted(mempool);
+    });
+    mempoolDepth.set(static_cast<int64_t>(mempool.size()));
+
+    // Three stages with bounded queues between them. Assembly (selection, balance checks,
+    // Merkle tree) runs on its own thread up to PIPELINE_DEPTH templates ahead of mining;
+    // mining patches in the previous hash and mines on this thread, or on the pool's
+    // worker processes when there is one; store appends, indexing and the users file are
+    // written by a persistence thread. A template's balance changes are applied as soon as
+    // it is selected, which is safe because a selected block is always mined; each job
+    // carries the balances as of its block.
+    typedef std::chrono::steady_clock Clock;
+    auto seconds = [](Clock::time_point since) { return std::chrono::duration<double>(Clock::now() - since).count(); };
+    BoundedQueue<BlockJob> templates(PIPELINE_DEPTH);
+    BoundedQueue<BlockJob> mined(PIPELINE_DEPTH);
+    double assembleSeconds = 0, mineSeconds = 0, persistSeconds = 0;
+    Clock::time_point pipelineStart = Clock::now();
+
+    std::thread assembler([&] {
+        while (!mempool.empty()) {
+            Clock::time_point start = Clock::now();
+            std::vector<Transaction> rejected;
+            std::vector<Transaction> selected = mempool.selectForBlock(accounts, maxTransactionsPerBlock, rejected);
+            for (const auto& transaction : rejected) {
+                failedTransactionsFile << "Rejected Transaction due to insufficient balance or invalid user: " << transaction.getTransactionID() << "\n";
+            }
+            rejectedTotal.add(rejected.size());
+            logEvicted(mempool);
+            accepted.add(selected.size());
+            mempoolDepth.set(static_cast<int64_t>(mempool.size()));
 
-        for (auto it = transactionPool.begin(); it != transactionPool.end() && validTransactions.size() < maxTransactionsPerBlock;) {
-            const auto& transaction = *it;
-            std::string senderPublicKey = transaction.getSenderPublicKey();
-            std::string receiverPublicKey = transaction.getReceiverPublicKey();
-            double amount = transaction.getAmount();
+            if (selected.empty()) {
+                break; // Exit the loop if no valid transactions are available
+            }
 
-            int senderIndex = findUserIndex(users, senderPublicKey);
-            int receiverIndex = findUserIndex(users, receiverPublicKey);
+            // The template's Merkle root is kept current as each transaction is added
+            BlockJob job;
+            job.block.reset(new Block(Digest(), std::vector<Transaction>(), Block::CHAIN_DIFFICULTY));
+            for (const auto& transaction : selected) {
+                job.block->addTransaction(transaction);
+            }
+            job.block->buildMerkleTree();
+            job.balances = accounts.getBalances();
+            job.poolSize = mempool.size();
+            assembleSeconds += seconds(start);
+            assemblyLatency.observe(seconds(start));
+            if (!templates.push(std::move(job))) {
+                break;
+            }
+        }
+        templates.close();
+    });
 
-            if (senderIndex != -1 && receiverIndex != -1 && users[senderIndex].getBalance() >= amount) {
-                validTransactions.push_back(transaction);
-                users[senderIndex].updateBalance(-amount);
-                users[receiverIndex].updateBalance(amount);
-                it = transactionPool.erase(it); // Remove valid transaction from the pool
-            } else {
-                failedTransactionsFile << "Rejected Transaction due to insufficient balance or invalid user: " << transaction.getTransactionID() << "\n";
-                it = transactionPool.erase(it); // Remove invalid transaction from the pool
+    std::thread persister([&] {
+        BlockJob job;
+        while (mined.pop(job)) {
+            Clock::time_point start = Clock::now();
+            const Block& block = *job.block;
+            bool stored = store != nullptr && store->append(block);
+            if (store != nullptr && !stored) {
+                std::cout << "Failed to append block " << block.getBlockID() << " to the block store" << std::endl;
+            } else if (stored && chainIndex != nullptr && !chainIndex->catchUp(*store)) {
+                std::cout << "Failed to index block " << block.getBlockID() << std::endl;
+            }
+            if (publisher != nullptr) {
+                publisher->append(block);
+            }
+            if (addressIndex != nullptr && !addressIndex->catchUp(blocks, chainHeight())) {
+                std::cout << "Failed to write the address index for block " << block.getBlockID() << std::endl;
+            }
+            // Queries see the block once it is stored, together with the balances after it
+            if (publisher != nullptr) {
+                publisher->publish(job.balances);
             }
+
+            // Save updated user balances to file
+            accounts.writeBalancesTo(users, job.balances);
+            Clock::time_point write = Clock::now();
+            saveUsersToFile(users, "users.txt");
+            usersFileLatency.observe(seconds(write));
+            // Snapshots are tied to stored heights; the writer works in the background. The
+            // verifier's checkpoint is moved to the same heights (this block was built and
+            // checked here), so a restart checks and replays only the blocks stored since
+            if (stored && snapshots != nullptr && snapshots->due(store->size() - 1)) {
+                if (!checkpointPath.empty()) {
+                    ChainVerifier::Checkpoint checkpoint;
+                    checkpoint.height = store->size() - 1;
+                    checkpoint.blockID = block.getBlockID();
+                    checkpoint.stateDigest = ChainVerifier::stateDigest(accounts, job.balances);
+                    ChainVerifier::writeCheckpoint(checkpointPath, checkpoint);
+                }
+                snapshots->submit(store->size() - 1, block.getBlockID(), accounts, std::move(job.balances));
+            }
+            persistSeconds += seconds(start);
         }
+    });
 
-        if (validTransactions.empty()) {
-            break; // Exit the loop if no valid transactions are available
+    BlockJob job;
+    while (templates.pop(job)) {
+        Clock::time_point start = Clock::now();
+        job.block->setPreviousHash(previousHash);
+        if (pool == nullptr || !pool->mine(*job.block)) {
+            job.block->mineBlock();
         }
+        previousHash = job.block->getBlockID();
+        mineSeconds += seconds(start);
 
-        std::string previousHash = blockchain.empty()
-            ? "0000000000000000000000000000000000000000000000000000000000000000"
-            : blockchain.back().getBlockID();
+std::cout << minedBlockIndex << " Mined new block: " << previousHash 
+          << " | Nonce: " << job.block->getNonce() 
+          << " | Transactions in pool: " << job.poolSize << std::endl;
 
-        Block newBlock = createBlock(validTransactions, previousHash);
-        blockchain.push_back(newBlock);
+        mined.push(std::move(job));
+        minedBlockIndex++; // Increment the index correctly
+    }
+    mined.close();
+    assembler.join();
+    persister.join();
 
-std::cout << minedBlockIndex << " Mined new block: " << newBlock.getBlockID() 
-          << " | Nonce: " << newBlock.getNonce() 
-          << " | Transactions in pool: " << transactionPool.size() << std::endl;
+    std::cout << "Pipeline: " << minedBlockIndex - 1 << " blocks in " << seconds(pipelineStart) << " s"
+              << " | assemble " << assembleSeconds << " s, mine " << mineSeconds << " s, persist " << persistSeconds << " s"
+              << std::endl;
 
-        // Save updated user balances to file
-        saveUsersToFile(users, "users.txt");
-        minedBlockIndex++; // Increment the index correctly
+    // Whatever is still parked never got funded
+    for (const auto& transaction : mempool.pendingTransactions()) {
+        failedTransactionsFile << "Transaction still pending, sender never funded: " << transaction.getTransactionID() << "\n";
     }
 
     failedTransactionsFile.close();
-    return blockchain;
 }
 
-std::vector<Transaction> selectRandomTransactions(const std::vector<Transaction>& transactions, int count) {
+std::vector<Transaction> selectRandomTransactions(const std::vector<Transaction>& transactions, size_t count) {
     std::vector<Transaction> selectedTransactions;
     if (transactions.size() <= count) {
         return transactions; // Return all if fewer than required
     }
 
-    std::vector<int> indices(transactions.size());
+    std::vector<size_t> indices(transactions.size());
     std::iota(indices.begin(), indices.end(), 0);
     std::random_shuffle(indices.begin(), indices.end());
 
-    for (int i = 0; i < count; ++i) {
+    for (size_t i = 0; i < count; ++i) {
         selectedTransactions.push_back(transactions[indices[i]]);
     }
 
@@ -137,7 +291,22 @@ void updateBalances(const std::vector<Transaction>& transactions, std::vector<Us
     }
 }
 
-int findUserIndex(const std::vector<User>& users, const std::string& publicKey) {
+void updateBalances(const std::vector<Transaction>& transactions, AccountState& accounts) {
+    for (const auto& transaction : transactions) {
+        int64_t senderIndex = accounts.findAccount(transaction.getSenderPublicKey());
+        int64_t receiverIndex = accounts.findAccount(transaction.getReceiverPublicKey());
+
+        if (senderIndex != AccountState::NOT_FOUND) {
+            accounts.updateBalance(senderIndex, -transaction.getAmount());
+        }
+
+        if (receiverIndex != AccountState::NOT_FOUND) {
+            accounts.updateBalance(receiverIndex, transaction.getAmount());
+        }
+    }
+}
+
+int findUserIndex(const std::vector<User>& users, const Digest& publicKey) {
     auto it = std::find_if(users.begin(), users.end(), [&publicKey](const User& user) {
         return user.getPublicKey() == publicKey;
     });
@@ -157,32 +326,39 @@ void saveUsersToFile(const std::vector<User>& users, const std::string& filename
 
 void saveTransactionsToFile(const std::vector<Transaction>& transactions, const std::string& filename) {
     std::ofstream file(filename);
+    writeTransactions(file, transactions);
+    file.close();
+}
+
+void writeTransactions(std::ostream& file, const std::vector<Transaction>& transactions) {
     for (const auto& tx : transactions) {
         file << "\nTransaction ID: " << tx.getTransactionID() 
              << "\nSender: " << tx.getSenderPublicKey() 
              << "\nReceiver: " << tx.getReceiverPublicKey() 
              << "\nAmount: " << tx.getAmount() << "\n";
     }
-    file.close();
 }
 
-void saveBlocksToFile(const std::vector<Block>& blockchain, const std::string& filename) {
+void exportBlocksToFile(const BlockStore& store, const std::string& filename) {
     std::ofstream file(filename);
-    for (const auto& block : blockchain) {
-        file << "Block ID: " << block.getBlockID() 
-             << "\nBlock Hash: " << block.calculateBlockHash() 
-             << "\nMerkle Root Hash: " << block.getMerkleRootHash()
-             << "\nTimestamp: " << block.getTimestamp() 
-             << "\nDifficulty Target: " << block.getDifficulty()
-             << "\nVersion: 2.0" 
-             << "\nNonce: " << block.getNonce()
-             << "\nNumber of Transactions: " << block.getNumTransactions()
+    for (size_t height = 0; height < store.size(); ++height) {
+        BlockView block = store.view(height);
+        const StoredBlockHeader& header = block.header();
+        file << "Block ID: " << header.blockID
+             << "\nBlock Hash: " << header.blockID
+             << "\nMerkle Root Hash: " << header.merkleRoot
+             << "\nTimestamp: " << header.timestamp
+             << "\nDifficulty Target: " << header.difficultyTarget
+             << "\nVersion: 2.0"
+             << "\nNonce: " << header.nonce
+             << "\nExtra Nonce: " << header.extraNonce
+             << "\nNumber of Transactions: " << header.transactionCount
              << "\nTransactions:\n";
 
-        int totalAmount = 0;
-        for (const auto& tx : block.getTransactions()) {
-            file << "Transaction ID: " << tx.getTransactionID() << "\n";
-            totalAmount += tx.getAmount();
+        int64_t totalAmount = 0;
+        for (size_t t = 0; t < block.transactionCount(); ++t) {
+            file << "Transaction ID: " << block.transaction(t).transactionID << "\n";
+            totalAmount += block.transaction(t).amount;
         }
 
         file << "Total Amount: " << totalAmount << "\n";
@@ -191,54 +367,125 @@ void saveBlocksToFile(const std::vector<Block>& blockchain, const std::string& f
     file.close();
 }
 
-void findBlock(const std::string& searchHash, const std::vector<Block>& blockchain) {
-    for (const auto& block : blockchain) {
-        if (block.getBlockID() == searchHash || block.getMerkleRootHash() == searchHash) {
-            std::cout << "Block found: " << block.getBlockID() << "\n";
-            std::cout << "Block Hash: " << block.calculateBlockHash() << "\n";
-            std::cout << "Merkle Root Hash: " << block.getMerkleRootHash() << "\n";
-            std::cout << "Timestamp: " << block.getTimestamp() << "\n";
-            std::cout << "Difficulty Target: " << block.getDifficulty() << "\n";
-            std::cout << "Version: 2.0" << "\n";
-            std::cout << "Nonce: " << block.getNonce() << "\n";
-            std::cout << "Number of Transactions: " << block.getNumTransactions() << "\n";
-            std::cout << "Transactions:\n";
-            for (const auto& tx : block.getTransactions()) {
-                std::cout << "Transaction ID: " << tx.getTransactionID() << "\n";
-            }
-            return;
-        }
+void reportAddressIndex(const AddressIndex& addressIndex) {
+    AddressIndex::Stats stats = addressIndex.stats();
+    std::cout << "Address filters: " << stats.blocks << " blocks, " << stats.filterBytes << " bytes"
+              << " | target FPR " << stats.targetFalsePositiveRate * 100 << "%"
+              << ", expected " << stats.expectedFalsePositiveRate * 100 << "%";
+    if (stats.queries > 0) {
+        std::cout << ", observed " << stats.observedFalsePositiveRate * 100 << "% over " << stats.queries << " queries";
     }
-    std::cout << "Block not found.\n";
+    std::cout << " | hot addresses: " << stats.hotAddresses << " (" << stats.postingsBytes << " bytes of postings)\n";
 }
 
-void findTransaction(const std::string& transactionID, const std::vector<Block>& blockchain) {
-    for (const auto& block : blockchain) {
-        for (const auto& transaction : block.getTransactions()) {
-            if (transaction.getTransactionID() == transactionID) {
-                std::cout << "Transaction found:\n";
-                std::cout << "Transaction ID: " << transaction.getTransactionID() << "\n";
-                std::cout << "Sender: " << transaction.getSenderPublicKey() << "\n";
-                std::cout << "Receiver: " << transaction.getReceiverPublicKey() << "\n";
-                std::cout << "Amount: " << transaction.getAmount() << "\n";
-                return;
-            }
+// Verifies the stored chain past its last checkpoint and replays its balances, from the
+// newest account snapshot for these users if there is one, otherwise from the users'
+// initial balances; on success the users carry the replayed balances into mining
+bool verifyStoredChain(const BlockStore& store, std::vector<User>& users, const std::string& checkpointPath,
+                       const AccountSnapshots* snapshots) {
+    AccountState accounts = AccountState::fromUsers(users);
+    size_t replayFrom = 0;
+    AccountState snapshot;
+    AccountSnapshots::Info info;
+    if (snapshots != nullptr && snapshots->loadLatest(store, snapshot, info)) {
+        if (snapshot.sameAccounts(accounts)) {
+            accounts = std::move(snapshot);
+            replayFrom = static_cast<size_t>(info.height) + 1;
+            std::cout << "Loaded account snapshot at height " << info.height << "\n";
+        } else {
+            std::cout << "Account snapshot at height " << info.height << " is for other accounts, not used\n";
         }
     }
-    std::cout << "Transaction not found.\n";
+    ChainVerifier verifier;
+    ChainVerifier::Result result = verifier.verifyChain(store, accounts, checkpointPath, replayFrom);
+
+    std::cout << "Verified " << result.blocksChecked << " blocks";
+    if (result.usedCheckpoint) {
+        std::cout << " after the checkpoint at height " << result.checkedFrom - 1;
+    }
+    std::cout << " in " << result.checkSeconds << " s, replayed " << result.transactionsReplayed
+              << " transactions from height " << result.replayedFrom << " in " << result.replaySeconds << " s\n";
+    if (!result.valid) {
+        std::cout << "Chain verification failed at height " << result.failedHeight << ": "
+                  << ChainVerifier::failureName(result.failure) << "; balances start from the generated users\n";
+        return false;
+    }
+    accounts.writeBalancesTo(users);
+    return true;
 }
 
-void findUser(const std::string& userName, const std::vector<User>& users) {
-    for (const auto& user : users) {
-        if (user.getName() == userName) {
-            std::cout << "User found:\n";
-            std::cout << "Name: " << user.getName() << "\n";
-            std::cout << "Public Key: " << user.getPublicKey() << "\n";
-            std::cout << "Balance: " << user.getBalance() << "\n";
-            return;
-        }
+// Catches the store up with the longest chain among the peers instead of mining it.
+// `users` hold the balances after the store's current tip (see verifyStoredChain) and
+// are left at the new tip.
+bool syncChain(const std::vector<std::string>& peerPaths, BlockStore& store, std::vector<User>& users) {
+    AccountState accounts = AccountState::fromUsers(users);
+    ChainSync::Result result = ChainSync(peerPaths).sync(store, accounts);
+    std::cout << "Synced " << result.blocksApplied << " blocks (" << result.transactions << " transactions) from height "
+              << result.startHeight << ": headers in " << result.headerSeconds << " s, bodies in " << result.bodySeconds
+              << " s, " << result.bytesReceived / 1e6 << " MB; blocks per peer:";
+    for (size_t p = 0; p < peerPaths.size(); ++p) {
+        std::cout << " " << peerPaths[p] << "=" << result.blocksPerPeer[p];
     }
-    std::cout << "User not found.\n";
+    std::cout << "\n";
+    if (result.peersDropped > 0) {
+        std::cout << result.peersDropped << " peers dropped, " << result.retries << " ranges fetched again\n";
+    }
+    accounts.writeBalancesTo(users);
+    if (!result.valid) {
+        std::cout << "Sync stopped at height " << result.failedHeight << ": " << ChainSync::failureName(result.failure)
+                  << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Resolves a query file as one sorted batch and writes CSV or JSONL (by extension), then
+// times the same queries answered one at a time the way the interactive lookups did: a
+// full block load and a flushed output line per query. With no index each of those is a
+// scan, so only a prefix of the file is timed.
+bool runBatchQueries(const std::string& queryPath, const std::string& outputPath, const BlockStore& store,
+                     const ChainIndex* index, const AccountState& accounts) {
+    std::ifstream in(queryPath);
+    if (!in) {
+        std::cout << "Could not read " << queryPath << "\n";
+        return false;
+    }
+    std::vector<BatchQuery::Query> queries = BatchQuery::parse(in);
+    BatchQuery batch(store, index, accounts);
+    BatchQuery::Format format = BatchQuery::formatFor(outputPath);
+
+    auto start = std::chrono::steady_clock::now();
+    BatchQuery::Stats stats;
+    std::vector<BatchQuery::Row> rows = batch.resolve(queries, &stats);
+    bool written = batch.write(outputPath, format, queries, rows);
+    double batchSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (!written) {
+        std::cout << "Could not write " << outputPath << "\n";
+        return false;
+    }
+    std::cout << "Batch: " << queries.size() << " queries (" << stats.found << " found, " << stats.notFound
+              << " not found, " << stats.malformed << " malformed) in " << batchSeconds << " s = "
+              << queries.size() / std::max(batchSeconds, 1e-9) << " queries/s | " << stats.blocksRead
+              << " blocks read " << (stats.scanned ? "in one store scan" : "through the index") << " -> "
+              << outputPath << "\n";
+
+    size_t sample = std::min(queries.size(), index != nullptr ? size_t(20000) : size_t(500));
+    if (sample == 0) {
+        return true;
+    }
+    std::ofstream discard("/dev/null");
+    std::string line;
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < sample; ++i) {
+        line.clear();
+        batch.appendRow(line, format, queries[i], batch.resolveOne(queries[i]));
+        discard << line << std::flush;
+    }
+    double oneSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double oneRate = sample / std::max(oneSeconds, 1e-9);
+    std::cout << "One by one: " << sample << " queries in " << oneSeconds << " s = " << oneRate << " queries/s"
+              << " | batch is " << (queries.size() / std::max(batchSeconds, 1e-9)) / oneRate << "x faster\n";
+    return true;
 }
 
 bool verifyTransaction(const Transaction& transaction, const std::vector<User>& users) {
@@ -257,9 +504,19 @@ bool verifyTransaction(const Transaction& transaction, const std::vector<User>&
     return true;
 }
 
+bool verifyTransaction(const Transaction& transaction, const AccountState& accounts) {
+    int64_t senderIndex = accounts.findAccount(transaction.getSenderPublicKey());
+    if (senderIndex == AccountState::NOT_FOUND) {
+        return false; // Sender not found
+    }
+
+    // Check if the sender's balance is sufficient
+    return accounts.getBalance(senderIndex) >= transaction.getAmount();
+}
+
 bool verifyTransactionHash(const Transaction& transaction) {
-    std::string expectedHash = HashUtils::processHashInput(
-        transaction.getSenderPublicKey() + transaction.getReceiverPublicKey() + std::to_string(transaction.getAmount())
+    Digest expectedHash = HashUtils::hash(
+        transaction.getSenderPublicKey().toHex() + transaction.getReceiverPublicKey().toHex() + std::to_string(transaction.getAmount())
     );
     if (transaction.getTransactionID() != expectedHash) {
         std::cout << "Invalid Transaction: Hash mismatch. Transaction ID: " << transaction.getTransactionID() 
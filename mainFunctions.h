@@ -5,23 +5,51 @@
 #include "user.h"
 #include "transactions.h"
 #include "block.h"
+#include "accountState.h"
+#include "blockStore.h"
+#include "chainIndex.h"
+#include "chainVerifier.h"
+#include "accountSnapshot.h"
+#include "chainSnapshot.h"
+#include "batchQuery.h"
+#include "chainSync.h"
+#include "miningPool.h"
+#include "addressIndex.h"
+#include "workloadGenerator.h"
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <functional>
+#include <ostream>
 
-std::vector<Transaction> selectRandomTransactions(const std::vector<Transaction>& transactions, int count);
-std::vector<Block> mineBlockchain(std::vector<Transaction>& transactionPool, std::vector<User>& users);
+std::vector<Transaction> selectRandomTransactions(const std::vector<Transaction>& transactions, size_t count);
+// Hands the workload to the consumer chunk by chunk (see WorkloadGenerator::generateTransactions)
+typedef std::function<void(const WorkloadGenerator::TransactionConsumer& consumer)> TransactionSource;
+
+// With a checkpoint path, the ChainVerifier checkpoint there is advanced with every account snapshot
+void mineBlockchain(const TransactionSource& transactions, std::vector<User>& users,
+                    size_t maxTransactionsPerBlock = 100, BlockStore* store = nullptr,
+                    ChainIndex* chainIndex = nullptr, AddressIndex* addressIndex = nullptr, AccountSnapshots* snapshots = nullptr,
+                    ChainPublisher* publisher = nullptr, PoolCoordinator* pool = nullptr,
+                    const std::string& checkpointPath = std::string());
 void updateBalances(const std::vector<Transaction>& transactions, std::vector<User>& users);
-int findUserIndex(const std::vector<User>& users, const std::string& publicKey);
+void updateBalances(const std::vector<Transaction>& transactions, AccountState& accounts);
+int findUserIndex(const std::vector<User>& users, const Digest& publicKey);
 void saveUsersToFile(const std::vector<User>& users, const std::string& filename);
 void saveTransactionsToFile(const std::vector<Transaction>& transactions, const std::string& filename);
-void saveBlocksToFile(const std::vector<Block>& blockchain, const std::string& filename);
-std::vector<User> generateUsers(int userNumber);
-std::vector<Transaction> generateTransactions(int transactionNumber, std::vector<User>& users);
-void findBlock(const std::string& blockID, const std::vector<Block>& blockchain);
-void findTransaction(const std::string& transactionID, const std::vector<Block>& blockchain);
-void findUser(const std::string& userPublicKey, const std::vector<User>& users);
+void writeTransactions(std::ostream& file, const std::vector<Transaction>& transactions);
+void exportBlocksToFile(const BlockStore& store, const std::string& filename);
+std::vector<User> generateUsers(int userNumber, const WorkloadGenerator& generator);
+void generateTransactions(int transactionNumber, const std::vector<User>& users, const WorkloadGenerator& generator,
+                          const WorkloadGenerator::TransactionConsumer& consumer);
+void reportAddressIndex(const AddressIndex& addressIndex);
+bool verifyStoredChain(const BlockStore& store, std::vector<User>& users, const std::string& checkpointPath,
+                       const AccountSnapshots* snapshots = nullptr);
+bool syncChain(const std::vector<std::string>& peerPaths, BlockStore& store, std::vector<User>& users);
+bool runBatchQueries(const std::string& queryPath, const std::string& outputPath, const BlockStore& store,
+                     const ChainIndex* index, const AccountState& accounts);
 bool verifyTransaction(const Transaction& transaction, const std::vector<User>& users);
+bool verifyTransaction(const Transaction& transaction, const AccountState& accounts);
 bool verifyTransactionHash(const Transaction& transaction);
 
 #endif // MAINFUNCTIONS_H
\ No newline at end of file
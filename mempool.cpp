@@ -0,0 +1,201 @@
+#include "mempool.h"
+
+// Slab entry (the transaction is stored inline) and the three hash map nodes (id,
+// sender queue, incoming count)
+const size_t Mempool::ENTRY_BYTES = sizeof(Mempool::Entry) + 3 * 48;
+
+Mempool::Mempool(size_t maxBytes, uint32_t maxParkedBlocks)
+    : arrivalHead(NONE), arrivalTail(NONE), nextSequence(0), maxBytes(maxBytes), maxParkedBlocks(maxParkedBlocks),
+      evicted(0) {}
+
+Mempool::AddResult Mempool::add(const Transaction& transaction) {
+    const Digest& id = transaction.getTransactionID();
+    if (byId.count(id)) {
+        return DUPLICATE;
+    }
+    while (!empty() && (size() + 1) * ENTRY_BYTES > maxBytes) {
+        evictOldest();
+    }
+
+    Entry entry = {transaction, nextSequence++, arrivalTail, NONE, NONE, NONE, 0, true};
+
+    uint32_t slot;
+    if (!freeSlots.empty()) {
+        slot = freeSlots.back();
+        freeSlots.pop_back();
+        slab[slot] = entry;
+    } else {
+        slot = static_cast<uint32_t>(slab.size());
+        slab.push_back(entry);
+    }
+
+    // Append to the arrival list
+    if (arrivalTail != NONE) {
+        slab[arrivalTail].nextArrival = slot;
+    } else {
+        arrivalHead = slot;
+    }
+    arrivalTail = slot;
+
+    // Append to the sender's queue
+    SenderQueue& queue = bySender[slab[slot].sender()];
+    slab[slot].prevSender = queue.tail;
+    if (queue.tail != NONE) {
+        slab[queue.tail].nextSender = slot;
+    } else {
+        queue.head = slot;
+    }
+    queue.tail = slot;
+
+    pendingIncoming[slab[slot].receiver()]++;
+    byId[id] = slot;
+    return ADDED;
+}
+
+void Mempool::unlink(uint32_t slot) {
+    Entry& entry = slab[slot];
+
+    if (entry.prevArrival != NONE) slab[entry.prevArrival].nextArrival = entry.nextArrival;
+    else arrivalHead = entry.nextArrival;
+    if (entry.nextArrival != NONE) slab[entry.nextArrival].prevArrival = entry.prevArrival;
+    else arrivalTail = entry.prevArrival;
+
+    auto queue = bySender.find(entry.sender());
+    if (entry.prevSender != NONE) slab[entry.prevSender].nextSender = entry.nextSender;
+    else queue->second.head = entry.nextSender;
+    if (entry.nextSender != NONE) slab[entry.nextSender].prevSender = entry.prevSender;
+    else queue->second.tail = entry.prevSender;
+    if (queue->second.head == NONE) {
+        bySender.erase(queue);
+    }
+
+    auto incoming = pendingIncoming.find(entry.receiver());
+    if (--incoming->second == 0) {
+        pendingIncoming.erase(incoming);
+    }
+
+    byId.erase(entry.id());
+    entry.live = false;
+    freeSlots.push_back(slot);
+}
+
+void Mempool::evictOldest() {
+    evictedTransactions.push_back(slab[arrivalHead].transaction);
+    unlink(arrivalHead);
+    evicted++;
+}
+
+std::vector<Transaction> Mempool::takeEvicted() {
+    std::vector<Transaction> result;
+    result.swap(evictedTransactions);
+    return result;
+}
+
+bool Mempool::remove(const Digest& transactionID) {
+    auto it = byId.find(transactionID);
+    if (it == byId.end()) {
+        return false;
+    }
+    unlink(it->second);
+    return true;
+}
+
+bool Mempool::contains(const Digest& transactionID) const {
+    return byId.count(transactionID) != 0;
+}
+
+const Transaction* Mempool::find(const Digest& transactionID) const {
+    auto it = byId.find(transactionID);
+    return it == byId.end() ? nullptr : &slab[it->second].transaction;
+}
+
+std::vector<Transaction> Mempool::pendingTransactions() const {
+    std::vector<Transaction> result;
+    result.reserve(size());
+    for (uint32_t slot = arrivalHead; slot != NONE; slot = slab[slot].nextArrival) {
+        result.push_back(slab[slot].transaction);
+    }
+    return result;
+}
+
+// Accepts the parked head of `sender`'s queue, and the transactions queued behind it,
+// for as long as they are funded and arrived before `before` (later ones are still
+// ahead of the main pass). Every acceptance funds its receiver, who is retried next.
+void Mempool::acceptChain(const Digest& sender, uint64_t before, AccountState& accounts, size_t maxTransactions,
+                          std::vector<Transaction>& selected) {
+    std::vector<Digest> work(1, sender);
+    while (!work.empty() && selected.size() < maxTransactions) {
+        Digest current = work.back();
+        work.pop_back();
+
+        auto queue = bySender.find(current);
+        while (queue != bySender.end() && selected.size() < maxTransactions) {
+            uint32_t slot = queue->second.head;
+            const Entry& entry = slab[slot];
+            int64_t senderIndex = accounts.findAccount(entry.sender());
+            int64_t receiverIndex = accounts.findAccount(entry.receiver());
+            if (entry.sequence >= before || senderIndex == AccountState::NOT_FOUND ||
+                receiverIndex == AccountState::NOT_FOUND ||
+                accounts.getBalance(senderIndex) < entry.transaction.getAmount()) {
+                break;
+            }
+
+            accounts.updateBalance(senderIndex, -entry.transaction.getAmount());
+            accounts.updateBalance(receiverIndex, entry.transaction.getAmount());
+            selected.push_back(entry.transaction);
+            work.push_back(entry.receiver());
+            unlink(slot);
+            queue = bySender.find(current);
+        }
+    }
+}
+
+std::vector<Transaction> Mempool::selectForBlock(AccountState& accounts, size_t maxTransactions,
+                                                 std::vector<Transaction>& rejected) {
+    std::vector<Transaction> selected;
+    selectPass(accounts, maxTransactions, true, selected, rejected);
+    if (selected.empty() && !empty()) {
+        // Nothing was accepted, so every parked head is waiting on another parked transaction
+        selectPass(accounts, maxTransactions, false, selected, rejected);
+    }
+    return selected;
+}
+
+// One pass over the arrival order. Without `parking`, unfunded heads are rejected on the
+// spot, so the sender's next transaction is evaluated when the pass reaches it.
+void Mempool::selectPass(AccountState& accounts, size_t maxTransactions, bool parking,
+                         std::vector<Transaction>& selected, std::vector<Transaction>& rejected) {
+    uint32_t slot = arrivalHead;
+    while (slot != NONE && selected.size() < maxTransactions) {
+        Entry& entry = slab[slot];
+        uint32_t next = entry.nextArrival; // Never removed below: acceptChain only takes earlier arrivals
+
+        if (bySender.find(entry.sender())->second.head != slot) {
+            slot = next; // Queued behind a parked transaction of the same sender
+            continue;
+        }
+
+        int64_t senderIndex = accounts.findAccount(entry.sender());
+        int64_t receiverIndex = accounts.findAccount(entry.receiver());
+        int64_t amount = entry.transaction.getAmount();
+
+        if (senderIndex == AccountState::NOT_FOUND || receiverIndex == AccountState::NOT_FOUND) {
+            rejected.push_back(entry.transaction);
+            unlink(slot);
+        } else if (accounts.getBalance(senderIndex) >= amount) {
+            accounts.updateBalance(senderIndex, -amount);
+            accounts.updateBalance(receiverIndex, amount);
+            selected.push_back(entry.transaction);
+            Digest receiver = entry.receiver();
+            uint64_t sequence = entry.sequence;
+            unlink(slot);
+            acceptChain(receiver, sequence, accounts, maxTransactions, selected);
+        } else if (!parking || !pendingIncoming.count(entry.sender()) || ++entry.parkedBlocks > maxParkedBlocks) {
+            rejected.push_back(entry.transaction); // Nothing pending funds it, or it waited too long
+            unlink(slot);
+        }
+        // Otherwise parked: it stays at the head of its sender queue
+
+        slot = next;
+    }
+}
@@ -0,0 +1,98 @@
+#ifndef MEMPOOL_H
+#define MEMPOOL_H
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "transactions.h"
+#include "accountState.h"
+
+// Pending transaction pool.
+//
+// Entries live in a slab with a free list and are linked into two intrusive lists: the
+// global arrival order and a per-sender queue. Insert, lookup and removal by transaction
+// ID are O(1) through a hash map. Transactions of one sender are applied strictly in
+// arrival order; a sender that cannot pay yet while other pending transactions would
+// fund it is parked instead of rejected, and is retried as soon as one of them is
+// accepted, so a transaction can fund a later one within the same block.
+//
+// Parking is bounded. A head that is still unfunded after `maxParkedBlocks` selections
+// is rejected, which lets the sender's later transactions through. When a selection
+// accepts nothing at all, no balance changed, so nothing parked can be funded any more:
+// the parked heads are re-evaluated at once and rejected instead, which also breaks
+// senders waiting on each other in a cycle.
+//
+// The pool has a memory cap; when adding would exceed it the oldest transactions are
+// evicted first.
+class Mempool {
+public:
+    enum AddResult { ADDED, DUPLICATE };
+
+    // Approximate bytes per pending transaction: slab entry and index nodes
+    static const size_t ENTRY_BYTES;
+
+    explicit Mempool(size_t maxBytes = 256 * 1024 * 1024, uint32_t maxParkedBlocks = 8);
+
+    AddResult add(const Transaction& transaction);
+    bool remove(const Digest& transactionID);
+    bool contains(const Digest& transactionID) const;
+    const Transaction* find(const Digest& transactionID) const;
+
+    size_t size() const { return byId.size(); }
+    bool empty() const { return byId.empty(); }
+    size_t memoryUsage() const { return byId.size() * ENTRY_BYTES; }
+    size_t evictedCount() const { return evicted; }
+    std::vector<Transaction> takeEvicted(); // Transactions evicted since the last call
+
+    // Selects up to maxTransactions for a block template in one pass over the arrival
+    // order, applying them to `accounts`. Accepted transactions leave the pool, as do
+    // rejected ones (unknown account, unfunded with nothing pending to fund them, or
+    // parked for too long), which are appended to `rejected`. Parked transactions stay for
+    // later blocks. An empty result means the pool is empty.
+    std::vector<Transaction> selectForBlock(AccountState& accounts, size_t maxTransactions,
+                                            std::vector<Transaction>& rejected);
+
+    std::vector<Transaction> pendingTransactions() const; // In arrival order
+
+private:
+    static const uint32_t NONE = UINT32_MAX;
+
+    struct Entry {
+        Transaction transaction;
+        uint64_t sequence; // Arrival number, increases monotonically
+        uint32_t prevArrival, nextArrival;
+        uint32_t prevSender, nextSender;
+        uint32_t parkedBlocks; // Selections this transaction has waited through as an unfunded head
+        bool live;
+
+        const Digest& id() const { return transaction.getTransactionID(); }
+        const Digest& sender() const { return transaction.getSenderPublicKey(); }
+        const Digest& receiver() const { return transaction.getReceiverPublicKey(); }
+    };
+
+    struct SenderQueue {
+        uint32_t head = NONE;
+        uint32_t tail = NONE;
+    };
+
+    std::vector<Entry> slab;
+    std::vector<uint32_t> freeSlots;
+    std::unordered_map<Digest, uint32_t, DigestHasher> byId;
+    std::unordered_map<Digest, SenderQueue, DigestHasher> bySender;
+    std::unordered_map<Digest, uint32_t, DigestHasher> pendingIncoming; // Receiver -> pending count
+    uint32_t arrivalHead, arrivalTail;
+    uint64_t nextSequence;
+    size_t maxBytes;
+    uint32_t maxParkedBlocks;
+    size_t evicted;
+    std::vector<Transaction> evictedTransactions;
+
+    void unlink(uint32_t slot);
+    void evictOldest();
+    void acceptChain(const Digest& sender, uint64_t before, AccountState& accounts, size_t maxTransactions,
+                     std::vector<Transaction>& selected);
+    void selectPass(AccountState& accounts, size_t maxTransactions, bool parking, std::vector<Transaction>& selected,
+                    std::vector<Transaction>& rejected);
+};
+
+#endif // MEMPOOL_H
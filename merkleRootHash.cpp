@@ -0,0 +1,188 @@
+#include "merkleRootHash.h"
+#include <algorithm>
+
+namespace {
+
+// Pairs handed to HashUtils::processHashBatch at a time
+const size_t HASH_BATCH = 8;
+
+// Absorbs hex(left) + hex(right) without building the 128 character string on the heap
+HashState pairState(const Digest& left, const Digest& right) {
+    char hex[2 * Digest::HEX_LENGTH];
+    left.writeHex(hex);
+    right.writeHex(hex + Digest::HEX_LENGTH);
+    HashState state;
+    state.update(hex, sizeof(hex));
+    return state;
+}
+
+} // namespace
+
+MerkleTree::MerkleTree() {
+    build(0);
+}
+
+MerkleTree::MerkleTree(const std::vector<Transaction>& txs) {
+    nodes.reserve(2 * txs.size() + 1);
+    for (const auto& transaction : txs) {
+        nodes.push_back(transaction.getTransactionID());
+    }
+    build(txs.size());
+}
+
+MerkleTree::MerkleTree(const std::vector<Digest>& leaves) {
+    nodes.reserve(2 * leaves.size() + 1);
+    nodes.assign(leaves.begin(), leaves.end()); // Keeps the reserved capacity for the upper levels
+    build(leaves.size());
+}
+
+void MerkleTree::build(size_t leafCount) {
+    this->leafCount = leafCount;
+    levelOffsets.assign(1, 0);
+    if (leafCount == 0) {
+        nodes.assign(1, emptyRoot());
+        levelOffsets.push_back(1);
+        return;
+    }
+
+    size_t levelStart = 0;
+    size_t levelSize = leafCount;
+    levelOffsets.push_back(leafCount);
+    while (levelSize > 1) {
+        size_t parentCount = (levelSize + 1) / 2;
+        size_t parentStart = nodes.size();
+        nodes.resize(parentStart + parentCount);
+
+        // Each thread hashes whole batches of pairs into its own slice of the next level
+        const Digest* level = nodes.data() + levelStart;
+        Digest* parents = nodes.data() + parentStart;
+        long batches = static_cast<long>((parentCount + HASH_BATCH - 1) / HASH_BATCH);
+        #pragma omp parallel for schedule(static) if (parentCount >= PARALLEL_PAIRS)
+        for (long b = 0; b < batches; ++b) {
+            HashState states[HASH_BATCH];
+            size_t first = static_cast<size_t>(b) * HASH_BATCH;
+            size_t count = std::min<size_t>(HASH_BATCH, parentCount - first);
+            for (size_t k = 0; k < count; ++k) {
+                size_t left = 2 * (first + k);
+                size_t right = left + 1 < levelSize ? left + 1 : left;
+                states[k] = pairState(level[left], level[right]);
+            }
+            HashUtils::processHashBatch(states, count, parents + first);
+        }
+
+        levelStart = parentStart;
+        levelSize = parentCount;
+        levelOffsets.push_back(nodes.size());
+    }
+}
+
+std::string MerkleTree::createMerkleRootHash() const {
+    return root().toHex();
+}
+
+const Digest& MerkleTree::root() const {
+    return nodes.back();
+}
+
+size_t MerkleTree::size() const {
+    return leafCount;
+}
+
+size_t MerkleTree::levelCount() const {
+    return levelOffsets.size() - 1;
+}
+
+const Digest& MerkleTree::node(size_t level, size_t index) const {
+    return nodes[levelOffsets[level] + index];
+}
+
+MerkleTree::Proof MerkleTree::proof(size_t txIndex) const {
+    Proof path;
+    if (txIndex >= size()) {
+        return path;
+    }
+    size_t index = txIndex;
+    for (size_t level = 0; level + 2 < levelOffsets.size(); ++level) {
+        size_t start = levelOffsets[level];
+        size_t levelSize = levelOffsets[level + 1] - start;
+        size_t sibling = index ^ 1;
+        if (sibling >= levelSize) {
+            sibling = index; // Odd node at the end is paired with itself
+        }
+        path.push_back({nodes[start + sibling], (index & 1) != 0});
+        index /= 2;
+    }
+    return path;
+}
+
+bool MerkleTree::verifyProof(const Digest& root, const Digest& txId, const Proof& proof) {
+    Digest current = txId;
+    for (const auto& step : proof) {
+        current = step.siblingOnLeft ? hashPair(step.sibling, current) : hashPair(current, step.sibling);
+    }
+    return current == root;
+}
+
+Digest MerkleTree::hashPair(const Digest& left, const Digest& right) {
+    return pairState(left, right).finalize();
+}
+
+Digest MerkleTree::emptyRoot() {
+    static const Digest placeholder = HashUtils::hash("Empty Tree Placeholder Hash");
+    return placeholder;
+}
+
+MerkleAccumulator::MerkleAccumulator() : count(0) {}
+
+MerkleAccumulator MerkleAccumulator::fromTree(const MerkleTree& tree) {
+    MerkleAccumulator accumulator;
+    accumulator.count = tree.size();
+    for (size_t h = 0; (accumulator.count >> h) > 0; ++h) {
+        accumulator.frontier.push_back(Digest());
+        if ((accumulator.count >> h) & 1) {
+            // The complete subtree of 2^h leaves just before the partial tail
+            accumulator.frontier[h] = tree.node(h, (accumulator.count >> h) - 1);
+        }
+    }
+    return accumulator;
+}
+
+void MerkleAccumulator::append(const Digest& leaf) {
+    Digest carry = leaf;
+    size_t h = 0;
+    while ((count >> h) & 1) {
+        carry = MerkleTree::hashPair(frontier[h], carry);
+        ++h;
+    }
+    if (h >= frontier.size()) {
+        frontier.resize(h + 1);
+    }
+    frontier[h] = carry;
+    ++count;
+}
+
+Digest MerkleAccumulator::root() const {
+    if (count == 0) {
+        return MerkleTree::emptyRoot();
+    }
+
+    // Walk up while a level still has more than one node. At level h a set bit means the
+    // frontier subtree is the last complete node; it pairs with the partial node carried
+    // up from below, or with itself. A clear bit leaves the carried node unpaired.
+    bool hasCarry = false;
+    Digest carry;
+    size_t h = 0;
+    for (; ((count - 1) >> h) > 0; ++h) {
+        if ((count >> h) & 1) {
+            carry = MerkleTree::hashPair(frontier[h], hasCarry ? carry : frontier[h]);
+            hasCarry = true;
+        } else if (hasCarry) {
+            carry = MerkleTree::hashPair(carry, carry);
+        }
+    }
+    return hasCarry ? carry : frontier[h];
+}
+
+size_t MerkleAccumulator::size() const {
+    return count;
+}
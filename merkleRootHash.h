@@ -6,44 +6,67 @@
 #include "hash.h"
 #include "transactions.h"
 
+// Binary Merkle tree over transaction IDs. Every level is kept, back to back in one
+// contiguous buffer (leaves first, root last), so inclusion proofs can be served after
+// construction. An odd node at the end of a level is paired with itself.
 class MerkleTree {
+public:
+    struct ProofStep {
+        Digest sibling;
+        bool siblingOnLeft;
+    };
+    typedef std::vector<ProofStep> Proof;
+
+    MerkleTree();
+    // Constructor to initialize with a list of transactions
+    explicit MerkleTree(const std::vector<Transaction>& txs);
+    explicit MerkleTree(const std::vector<Digest>& leaves);
+
+    // Creates the Merkle root hash
+    std::string createMerkleRootHash() const;
+    const Digest& root() const;
+    size_t size() const; // Number of leaves
+    size_t levelCount() const;
+    const Digest& node(size_t level, size_t index) const;
+
+    // Sibling hashes from the leaf up to the root, O(log n) long
+    Proof proof(size_t txIndex) const;
+    static bool verifyProof(const Digest& root, const Digest& txId, const Proof& proof);
+
+    // Combines and hashes two hashes, as hex(left) + hex(right)
+    static Digest hashPair(const Digest& left, const Digest& right);
+    static Digest emptyRoot();
+
 private:
-    std::vector<Transaction> transactions;
+    // Levels with at least this many pairs are split across OpenMP threads
+    static const size_t PARALLEL_PAIRS = 512;
+
+    std::vector<Digest> nodes;
+    size_t leafCount;
+    std::vector<size_t> levelOffsets; // Start of each level in nodes, plus the end
 
-    // Combines and hashes two transaction hashes
-    std::string hashCombinedTransactions(const std::string& left, const std::string& right) {
-        return HashUtils::processHashInput(left + right);
-    }
+    void build(size_t leafCount);
+};
 
+// Append-only Merkle root accumulator for block templates that grow one transaction at a
+// time. It keeps the root of every complete subtree still waiting for a right sibling
+// (one per set bit of the leaf count), so append() costs O(log n) hashes at worst and
+// O(1) amortized, and root() folds the frontier in O(log n) hashes. The root matches
+// MerkleTree for the same leaves, including the odd-node duplication rule. Copies are
+// only log2(n) digests, which makes snapshots cheap.
+class MerkleAccumulator {
 public:
-    // Constructor to initialize with a list of transactions
-    MerkleTree(const std::vector<Transaction>& txs) : transactions(txs) {}
+    MerkleAccumulator();
+    // Picks up the frontier of an already built tree without rehashing any leaves
+    static MerkleAccumulator fromTree(const MerkleTree& tree);
 
-    // Creates the Merkle root hash
-    std::string createMerkleRootHash() {
-        if (transactions.empty()) {
-            return HashUtils::processHashInput("Empty Tree Placeholder Hash");
-        }
-
-        std::vector<std::string> tree;
-        for (const auto& transaction : transactions) {
-            tree.push_back(transaction.getTransactionID());  // Ensure correct function name
-        }
-
-        while (tree.size() > 1) {
-            std::vector<std::string> newLevel;
-            for (size_t i = 0; i < tree.size(); i += 2) {
-                if (i + 1 < tree.size()) {
-                    newLevel.push_back(hashCombinedTransactions(tree[i], tree[i + 1]));
-                } else {
-                    newLevel.push_back(hashCombinedTransactions(tree[i], tree[i]));
-                }
-            }
-            tree = newLevel;
-        }
-
-        return tree.front();
-    }
+    void append(const Digest& leaf);
+    Digest root() const;
+    size_t size() const;
+
+private:
+    std::vector<Digest> frontier; // frontier[h] is valid while bit h of count is set
+    size_t count;
 };
 
 #endif // MERKLEROOTHASH_H
@@ -0,0 +1,295 @@
+#include "metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+
+uint64_t Metrics::Counter::value() const {
+    uint64_t sum = 0;
+    for (const Slot& slot : slots) {
+        sum += slot.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+Metrics::Histogram::Histogram(const std::vector<double>& upperBounds)
+    : upperBounds(upperBounds), counts(new std::atomic<uint64_t>[upperBounds.size() + 1]) {
+    std::sort(this->upperBounds.begin(), this->upperBounds.end());
+    for (size_t i = 0; i <= upperBounds.size(); ++i) {
+        counts[i].store(0, std::memory_order_relaxed);
+    }
+}
+
+void Metrics::Histogram::observe(double value) {
+    size_t bucket = std::lower_bound(upperBounds.begin(), upperBounds.end(), value) - upperBounds.begin();
+    counts[bucket].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumNanos.fetch_add(static_cast<uint64_t>(std::max(0.0, value) * 1e9), std::memory_order_relaxed);
+}
+
+double Metrics::Snapshot::get(const std::string& name, const std::string& labels) const {
+    for (const Sample& sample : samples) {
+        if (sample.name == name && sample.labels == labels) {
+            return sample.value;
+        }
+    }
+    return 0;
+}
+
+Metrics::Metrics() : started(std::chrono::steady_clock::now()) {}
+
+Metrics& Metrics::instance() {
+    static Metrics metrics;
+    return metrics;
+}
+
+size_t Metrics::threadSlot() {
+    static std::atomic<size_t> nextSlot(0);
+    thread_local size_t slot = nextSlot.fetch_add(1, std::memory_order_relaxed) % THREAD_SLOTS;
+    return slot;
+}
+
+std::vector<double> Metrics::latencyBuckets() {
+    return {0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10, 25, 100};
+}
+
+Metrics::Entry* Metrics::find(const std::string& name) {
+    for (Entry& entry : entries) {
+        if (entry.name == name) {
+            return &entry;
+        }
+    }
+    return nullptr;
+}
+
+Metrics::Counter& Metrics::counter(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name)) {
+        return *entry->counter;
+    }
+    counters.emplace_back();
+    entries.push_back(Entry{name, help, COUNTER, &counters.back(), nullptr, nullptr});
+    return counters.back();
+}
+
+Metrics::Gauge& Metrics::gauge(const std::string& name, const std::string& help) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name)) {
+        return *entry->gauge;
+    }
+    gauges.emplace_back();
+    entries.push_back(Entry{name, help, GAUGE, nullptr, &gauges.back(), nullptr});
+    return gauges.back();
+}
+
+Metrics::Histogram& Metrics::histogram(const std::string& name, const std::string& help,
+                                       const std::vector<double>& upperBounds) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (Entry* entry = find(name)) {
+        return *entry->histogram;
+    }
+    histograms.emplace_back(upperBounds);
+    entries.push_back(Entry{name, help, HISTOGRAM, nullptr, nullptr, &histograms.back()});
+    return histograms.back();
+}
+
+Metrics::Snapshot Metrics::snapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Snapshot snapshot;
+    snapshot.uptimeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    for (const Entry& entry : entries) {
+        switch (entry.type) {
+            case COUNTER:
+                snapshot.samples.push_back(Sample{entry.name, "", static_cast<double>(entry.counter->value())});
+                for (size_t slot = 0; slot < THREAD_SLOTS; ++slot) {
+                    if (uint64_t value = entry.counter->threadValue(slot)) {
+                        snapshot.samples.push_back(Sample{entry.name, "thread=\"" + std::to_string(slot) + "\"",
+                                                          static_cast<double>(value)});
+                    }
+                }
+                break;
+            case GAUGE:
+                snapshot.samples.push_back(Sample{entry.name, "", static_cast<double>(entry.gauge->value())});
+                break;
+            case HISTOGRAM:
+                snapshot.samples.push_back(Sample{entry.name + "_count", "", static_cast<double>(entry.histogram->count())});
+                snapshot.samples.push_back(Sample{entry.name + "_sum", "", entry.histogram->sum()});
+                break;
+        }
+    }
+    return snapshot;
+}
+
+// Counters are exported per thread slot only; sum() over the thread label gives the total
+std::string Metrics::prometheusText() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << std::setprecision(12);
+    for (const Entry& entry : entries) {
+        out << "# HELP " << entry.name << " " << entry.help << "\n";
+        switch (entry.type) {
+            case COUNTER: {
+                out << "# TYPE " << entry.name << " counter\n";
+                bool any = false;
+                for (size_t slot = 0; slot < THREAD_SLOTS; ++slot) {
+                    if (uint64_t value = entry.counter->threadValue(slot)) {
+                        out << entry.name << "{thread=\"" << slot << "\"} " << value << "\n";
+                        any = true;
+                    }
+                }
+                if (!any) {
+                    out << entry.name << " 0\n";
+                }
+                break;
+            }
+            case GAUGE:
+                out << "# TYPE " << entry.name << " gauge\n";
+                out << entry.name << " " << entry.gauge->value() << "\n";
+                break;
+            case HISTOGRAM: {
+                const Histogram& histogram = *entry.histogram;
+                out << "# TYPE " << entry.name << " histogram\n";
+                uint64_t cumulative = 0;
+                for (size_t i = 0; i < histogram.bounds().size(); ++i) {
+                    cumulative += histogram.bucketCount(i);
+                    out << entry.name << "_bucket{le=\"" << histogram.bounds()[i] << "\"} " << cumulative << "\n";
+                }
+                cumulative += histogram.bucketCount(histogram.bounds().size());
+                out << entry.name << "_bucket{le=\"+Inf\"} " << cumulative << "\n";
+                out << entry.name << "_sum " << histogram.sum() << "\n";
+                out << entry.name << "_count " << histogram.count() << "\n";
+                break;
+            }
+        }
+    }
+    return out.str();
+}
+
+std::string Metrics::jsonSnapshot() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    std::ostringstream out;
+    out << std::setprecision(12);
+    out << "{\n  \"uptime_seconds\": "
+        << std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count() << ",\n  \"metrics\": {";
+    for (size_t e = 0; e < entries.size(); ++e) {
+        const Entry& entry = entries[e];
+        out << (e == 0 ? "\n" : ",\n") << "    \"" << entry.name << "\": ";
+        switch (entry.type) {
+            case COUNTER: {
+                out << "{\"type\": \"counter\", \"value\": " << entry.counter->value() << ", \"threads\": {";
+                bool first = true;
+                for (size_t slot = 0; slot < THREAD_SLOTS; ++slot) {
+                    if (uint64_t value = entry.counter->threadValue(slot)) {
+                        out << (first ? "" : ", ") << "\"" << slot << "\": " << value;
+                        first = false;
+                    }
+                }
+                out << "}}";
+                break;
+            }
+            case GAUGE:
+                out << "{\"type\": \"gauge\", \"value\": " << entry.gauge->value() << "}";
+                break;
+            case HISTOGRAM: {
+                const Histogram& histogram = *entry.histogram;
+                out << "{\"type\": \"histogram\", \"count\": " << histogram.count() << ", \"sum\": " << histogram.sum()
+                    << ", \"buckets\": [";
+                for (size_t i = 0; i <= histogram.bounds().size(); ++i) {
+                    out << (i == 0 ? "" : ", ") << "{\"le\": ";
+                    if (i < histogram.bounds().size()) {
+                        out << histogram.bounds()[i];
+                    } else {
+                        out << "\"+Inf\"";
+                    }
+                    out << ", \"count\": " << histogram.bucketCount(i) << "}";
+                }
+                out << "]}";
+                break;
+            }
+        }
+    }
+    out << "\n  }\n}\n";
+    return out.str();
+}
+
+bool Metrics::writeFile(const std::string& path, const std::string& content) const {
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream out(temporary);
+        out << content;
+        if (!out) {
+            return false;
+        }
+    }
+    return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+MetricsReporter::MetricsReporter(const std::string& prometheusPath, const std::string& jsonPath, double intervalSeconds)
+    : prometheusPath(prometheusPath), jsonPath(jsonPath), intervalSeconds(intervalSeconds), running(false) {}
+
+MetricsReporter::~MetricsReporter() {
+    stop();
+}
+
+void MetricsReporter::addConsumer(const Consumer& consumer) {
+    consumers.push_back(consumer);
+}
+
+void MetricsReporter::start() {
+    if (running) {
+        return;
+    }
+    running = true;
+    previous = Metrics::instance().snapshot();
+    worker = std::thread([this] {
+        std::unique_lock<std::mutex> lock(mutex);
+        while (running) {
+            wake.wait_for(lock, std::chrono::duration<double>(intervalSeconds));
+            lock.unlock();
+            report();
+            lock.lock();
+        }
+    });
+}
+
+void MetricsReporter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!running) {
+            return;
+        }
+        running = false;
+    }
+    wake.notify_all();
+    worker.join(); // The worker reports once more on its way out
+}
+
+void MetricsReporter::report() {
+    Metrics& metrics = Metrics::instance();
+    if (!prometheusPath.empty()) {
+        metrics.writeFile(prometheusPath, metrics.prometheusText());
+    }
+    if (!jsonPath.empty()) {
+        metrics.writeFile(jsonPath, metrics.jsonSnapshot());
+    }
+    Metrics::Snapshot current = metrics.snapshot();
+    for (const Consumer& consumer : consumers) {
+        consumer(current, previous);
+    }
+    previous = current;
+}
+
+MetricsReporter::Consumer MetricsReporter::progressPrinter() {
+    return [](const Metrics::Snapshot& current, const Metrics::Snapshot& previous) {
+        double hashes = current.get("mining_hashes_total") - previous.get("mining_hashes_total");
+        double elapsed = current.uptimeSeconds - previous.uptimeSeconds;
+        if (hashes <= 0 || elapsed <= 0) {
+            return;
+        }
+        std::cout << "Still mining... " << static_cast<uint64_t>(hashes / elapsed) << " hashes/sec"
+                  << " | Blocks mined: " << current.get("blocks_mined_total")
+                  << " | Mempool depth: " << current.get("mempool_depth") << std::endl;
+    };
+}
@@ -0,0 +1,158 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <condition_variable>
+#include <cstdint>
+
+// Process-wide metrics registry.
+//
+// Counters are split into cache-line sized per-thread slots: a thread picks its slot on
+// first use and only ever adds to that one, so hot loops never contend and a counter
+// can also be read per thread (e.g. hashes per mining thread). Histograms use fixed
+// bucket bounds with one atomic per bucket, gauges are a single atomic. Nothing on the
+// recording path takes a lock; the registry mutex is only held while registering a
+// metric or taking a snapshot. Metrics are never removed, so references returned by the
+// registry stay valid for the life of the process and can be cached in statics.
+class Metrics {
+public:
+    static const size_t THREAD_SLOTS = 64;
+
+    class Counter {
+    public:
+        void add(uint64_t amount = 1) {
+            slots[threadSlot()].value.fetch_add(amount, std::memory_order_relaxed);
+        }
+        uint64_t value() const;
+        uint64_t threadValue(size_t slot) const { return slots[slot].value.load(std::memory_order_relaxed); }
+
+    private:
+        struct alignas(64) Slot {
+            std::atomic<uint64_t> value{0};
+        };
+        Slot slots[THREAD_SLOTS];
+    };
+
+    class Gauge {
+    public:
+        void set(int64_t value) { current.store(value, std::memory_order_relaxed); }
+        void add(int64_t amount) { current.fetch_add(amount, std::memory_order_relaxed); }
+        int64_t value() const { return current.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> current{0};
+    };
+
+    class Histogram {
+    public:
+        explicit Histogram(const std::vector<double>& upperBounds);
+        void observe(double value);
+        const std::vector<double>& bounds() const { return upperBounds; }
+        uint64_t bucketCount(size_t bucket) const { return counts[bucket].load(std::memory_order_relaxed); }
+        uint64_t count() const { return total.load(std::memory_order_relaxed); }
+        double sum() const { return static_cast<double>(sumNanos.load(std::memory_order_relaxed)) * 1e-9; }
+
+    private:
+        std::vector<double> upperBounds;
+        std::unique_ptr<std::atomic<uint64_t>[]> counts; // One per bound plus +Inf
+        std::atomic<uint64_t> total{0};
+        std::atomic<uint64_t> sumNanos{0}; // Sum kept in units of 1e-9 so it can be atomic
+    };
+
+    // Flattened values at one point in time; counters appear once in total and once per
+    // thread slot that was used (label thread="N")
+    struct Sample {
+        std::string name;
+        std::string labels;
+        double value;
+    };
+    struct Snapshot {
+        double uptimeSeconds = 0;
+        std::vector<Sample> samples;
+        double get(const std::string& name, const std::string& labels = "") const;
+    };
+
+    static Metrics& instance();
+
+    Counter& counter(const std::string& name, const std::string& help);
+    Gauge& gauge(const std::string& name, const std::string& help);
+    Histogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& upperBounds);
+
+    // Latency buckets from 100 microseconds to 100 seconds
+    static std::vector<double> latencyBuckets();
+
+    Snapshot snapshot() const;
+    std::string prometheusText() const;
+    std::string jsonSnapshot() const;
+    // Written to a temporary file and renamed, so readers never see a partial file
+    bool writeFile(const std::string& path, const std::string& content) const;
+
+    static size_t threadSlot();
+
+private:
+    enum Type { COUNTER, GAUGE, HISTOGRAM };
+
+    struct Entry {
+        std::string name;
+        std::string help;
+        Type type;
+        Counter* counter;
+        Gauge* gauge;
+        Histogram* histogram;
+    };
+
+    Metrics();
+
+    mutable std::mutex mutex;
+    std::vector<Entry> entries;
+    std::deque<Counter> counters;
+    std::deque<Gauge> gauges;
+    std::deque<Histogram> histograms;
+    std::chrono::steady_clock::time_point started;
+
+    Entry* find(const std::string& name);
+};
+
+// Writes the Prometheus text file and the JSON snapshot every `interval` on a background
+// thread and hands each snapshot to the registered consumers (e.g. progress printing).
+// Files are written once more on stop().
+class MetricsReporter {
+public:
+    typedef std::function<void(const Metrics::Snapshot& current, const Metrics::Snapshot& previous)> Consumer;
+
+    MetricsReporter(const std::string& prometheusPath, const std::string& jsonPath, double intervalSeconds = 1.0);
+    ~MetricsReporter();
+
+    MetricsReporter(const MetricsReporter&) = delete;
+    MetricsReporter& operator=(const MetricsReporter&) = delete;
+
+    void addConsumer(const Consumer& consumer); // Call before start()
+    void start();
+    void stop();
+
+    // Prints mining hash rate, blocks mined and mempool depth whenever hashes were done
+    static Consumer progressPrinter();
+
+private:
+    std::string prometheusPath;
+    std::string jsonPath;
+    double intervalSeconds;
+    std::vector<Consumer> consumers;
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool running;
+    Metrics::Snapshot previous;
+
+    void report();
+};
+
+#endif // METRICS_H
@@ -0,0 +1,736 @@
+#include "miningPool.h"
+#include "blockHeader.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <ctime>
+#include <sstream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+const size_t MAX_LINE_BYTES = 512;        // A longer line without a newline closes the connection
+const int MAX_EVENTS = 64;
+const uint64_t NONCES_PER_CHECK = 4096;   // Worker: nonces hashed between looks at the socket
+const double PROGRESS_SECONDS = 0.05;     // Worker: how often hashes are reported
+const uint64_t NONCE_LIMIT = std::numeric_limits<uint64_t>::max(); // Exclusive, as in Block::mineBlock
+
+double secondsSince(Clock::time_point start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+double threadCpuSeconds() {
+    timespec now;
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+bool unixAddress(const std::string& path, sockaddr_un& address) {
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return true;
+}
+
+bool writeAll(int fd, const std::string& text) {
+    size_t done = 0;
+    while (done < text.size()) {
+        ssize_t written = ::send(fd, text.data() + done, text.size() - done, MSG_NOSIGNAL);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        done += static_cast<size_t>(written);
+    }
+    return true;
+}
+
+// Splits a line at spaces into views of it; `words` is reused so handling a share allocates nothing
+void splitWords(std::string_view line, std::vector<std::string_view>& words) {
+    words.clear();
+    size_t begin = line.find_first_not_of(' ');
+    while (begin != std::string_view::npos) {
+        size_t end = std::min(line.find(' ', begin), line.size());
+        words.push_back(line.substr(begin, end - begin));
+        begin = line.find_first_not_of(' ', end);
+    }
+}
+
+bool parseNumber(std::string_view text, uint64_t& value) {
+    const char* end = text.data() + text.size();
+    std::from_chars_result parsed = std::from_chars(text.data(), end, value);
+    return !text.empty() && parsed.ec == std::errc() && parsed.ptr == end;
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+    char digits[20];
+    out.append(digits, std::to_chars(digits, digits + sizeof(digits), value).ptr);
+}
+
+// Hashes nonces first .. end - 1 and appends those that meet the share target. Shared by
+// pool workers and the solo baseline, so both measure the same loop
+void hashRange(const BlockHeader& header, int shareBits, uint64_t first, uint64_t end, std::vector<uint64_t>& shares) {
+    for (uint64_t nonce = first; nonce < end; ++nonce) {
+        if (header.meetsDifficulty(nonce, shareBits)) {
+            shares.push_back(nonce);
+        }
+    }
+}
+
+} // namespace
+
+struct PoolCoordinator::Job {
+    uint64_t id = 0;
+    Digest previousHash;
+    std::string timestamp;
+    Digest merkleRoot;
+    int bits = 0;
+    int shareBits = 0;
+    uint64_t nextSlice = 0;
+    bool found = false;
+    uint64_t nonce = 0;
+    uint64_t extraNonce = 0;
+};
+
+struct PoolCoordinator::Connection {
+    struct Slice {
+        uint64_t extraNonce;
+        uint64_t firstNonce;
+        uint64_t endNonce;
+        BlockHeader header;  // For re-hashing shares
+        std::unordered_set<uint64_t> submitted; // Nonces already credited as shares
+    };
+
+    std::string input;
+    std::string output;
+    size_t written = 0;
+    uint32_t events = EPOLLIN;
+    bool closing = false;
+    size_t worker = SIZE_MAX;  // Index into workers once HELLO arrived
+    uint64_t jobId = 0;        // Job the slices belong to
+    std::vector<Slice> slices;
+    bool switching = false;    // A new job was sent and not acknowledged yet
+    uint64_t switchJob = 0;
+    Clock::time_point switchSent;
+};
+
+PoolCoordinator::PoolCoordinator() : PoolCoordinator(Config()) {}
+
+PoolCoordinator::PoolCoordinator(const Config& config)
+    : config(config), listener(-1), wakeFd(-1), stopping(false), jobCounter(0), jobChanged(false), messages(0),
+      loopCpuSeconds(0) {
+    this->config.sliceNonces = std::max<uint64_t>(config.sliceNonces, 1);
+}
+
+PoolCoordinator::~PoolCoordinator() {
+    stop();
+}
+
+bool PoolCoordinator::listen(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!unixAddress(socketPath, address)) {
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    ::unlink(socketPath.c_str()); // Left behind by a run that did not shut down cleanly
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        int saved = errno;
+        ::close(fd);
+        errno = saved;
+        return false;
+    }
+    listener = fd;
+    path = socketPath;
+    return true;
+}
+
+bool PoolCoordinator::start() {
+    if (listener < 0 || loop.joinable()) {
+        return false;
+    }
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        return false;
+    }
+    started = Clock::now();
+    loop = std::thread(&PoolCoordinator::run, this);
+    return true;
+}
+
+void PoolCoordinator::stop() {
+    if (loop.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        changed.notify_all();
+        uint64_t one = 1;
+        ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+        (void)ignored;
+        loop.join();
+    }
+    if (wakeFd >= 0) {
+        ::close(wakeFd);
+        wakeFd = -1;
+    }
+    if (listener >= 0) {
+        ::close(listener);
+        listener = -1;
+        ::unlink(path.c_str());
+    }
+}
+
+bool PoolCoordinator::waitForWorkers(size_t count, double timeoutSeconds) {
+    std::unique_lock<std::mutex> lock(mutex);
+    return changed.wait_for(lock, std::chrono::duration<double>(timeoutSeconds), [&] {
+        return stopping || static_cast<size_t>(std::count_if(workers.begin(), workers.end(), [](const WorkerStats& w) {
+                               return w.connected;
+                           })) >= count;
+    }) && !stopping;
+}
+
+bool PoolCoordinator::mine(Block& block) {
+    std::shared_ptr<Job> next = std::make_shared<Job>();
+    next->previousHash = block.getPreviousHash();
+    next->timestamp = block.getTimestamp();
+    next->merkleRoot = block.getMerkleRootHash();
+    next->bits = block.getDifficultyBits();
+    next->shareBits = std::min(config.shareBits, next->bits);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping || !loop.joinable()) {
+            return false;
+        }
+        next->id = ++jobCounter;
+        job = next;
+        jobChanged = true;
+    }
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+
+    uint64_t nonce, extraNonce;
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&] { return stopping || next->found || job != next; });
+        if (!next->found) {
+            return false;
+        }
+        nonce = next->nonce;
+        extraNonce = next->extraNonce;
+    }
+    return block.applyProofOfWork(nonce, extraNonce);
+}
+
+void PoolCoordinator::cancel() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!job) {
+            return;
+        }
+        job.reset();
+        jobChanged = true;
+    }
+    changed.notify_all();
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+}
+
+PoolCoordinator::Stats PoolCoordinator::stats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    Stats result;
+    result.workers = workers;
+    for (size_t i = 0; i < result.workers.size(); ++i) {
+        if (result.workers[i].connected) {
+            result.workers[i].seconds = secondsSince(joined[i]);
+        }
+    }
+    result.jobs = jobCounter;
+    result.messages = messages;
+    result.seconds = started == Clock::time_point() ? 0 : secondsSince(started);
+    result.loopCpuSeconds = loopCpuSeconds;
+    return result;
+}
+
+void PoolCoordinator::run() {
+    static Metrics::Counter& sharesTotal = Metrics::instance().counter("pool_shares_total", "Shares accepted by the pool coordinator");
+    static Metrics::Counter& staleTotal = Metrics::instance().counter(
+        "pool_stale_shares_total", "Shares for a pool job that had already been replaced or solved");
+    static Metrics::Counter& invalidTotal = Metrics::instance().counter(
+        "pool_invalid_shares_total", "Shares outside the worker's slices, short of the share target or repeated");
+    static Metrics::Gauge& connectedWorkers = Metrics::instance().gauge("pool_workers", "Pool workers connected");
+    static Metrics::Histogram& switchLatency = Metrics::instance().histogram(
+        "pool_job_switch_seconds", "Time from sending a new pool job until the worker acknowledged it",
+        Metrics::latencyBuckets());
+
+    int epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0) {
+        return;
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    ::epoll_ctl(epoll, EPOLL_CTL_ADD, wakeFd, &event);
+    event.data.fd = listener;
+    ::epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+    std::unordered_map<int, Connection> connections;
+
+    // The loop thread holds `mutex` while it handles a wakeup, so these see a consistent job
+    auto flush = [&](int fd, Connection& connection) {
+        while (connection.written < connection.output.size()) {
+            ssize_t sent = ::send(fd, connection.output.data() + connection.written,
+                                  connection.output.size() - connection.written, MSG_NOSIGNAL);
+            if (sent > 0) {
+                connection.written += static_cast<size_t>(sent);
+            } else if (sent < 0 && errno == EINTR) {
+                continue;
+            } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            } else {
+                connection.closing = true;
+                connection.output.clear();
+                connection.written = 0;
+                return;
+            }
+        }
+        if (connection.written == connection.output.size()) {
+            connection.output.clear();
+            connection.written = 0;
+        }
+        uint32_t wanted = EPOLLIN;
+        if (!connection.output.empty()) {
+            wanted |= EPOLLOUT;
+        }
+        if (wanted != connection.events) {
+            connection.events = wanted;
+            epoll_event update;
+            std::memset(&update, 0, sizeof(update));
+            update.events = wanted;
+            update.data.fd = fd;
+            ::epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &update);
+        }
+    };
+    // Hands the connection the next unused slice of the current job
+    auto assignSlice = [&](Connection& connection) {
+        uint64_t slice = job->nextSlice++;
+        uint64_t perExtraNonce = (NONCE_LIMIT - 1) / config.sliceNonces + 1;
+        uint64_t extraNonce = slice / perExtraNonce;
+        uint64_t firstNonce = slice % perExtraNonce * config.sliceNonces;
+        uint64_t endNonce = firstNonce + std::min(config.sliceNonces, NONCE_LIMIT - firstNonce);
+        if (connection.jobId != job->id) {
+            connection.slices.clear();
+            connection.jobId = job->id;
+        }
+        connection.slices.push_back(Connection::Slice{
+            extraNonce, firstNonce, endNonce,
+            BlockHeader(job->previousHash, job->timestamp, job->merkleRoot, extraNonce, job->bits), {}});
+        std::ostringstream line;
+        line << "JOB " << job->id << ' ' << job->previousHash.toHex() << ' ' << job->timestamp << ' '
+             << job->merkleRoot.toHex() << ' ' << job->bits << ' ' << job->shareBits << ' ' << extraNonce << ' '
+             << firstNonce << ' ' << endNonce << '\n';
+        connection.output += line.str();
+    };
+    auto broadcast = [&]() {
+        for (auto& entry : connections) {
+            Connection& connection = entry.second;
+            if (connection.worker == SIZE_MAX || connection.closing) {
+                continue;
+            }
+            if (job && !job->found) {
+                assignSlice(connection);
+                connection.switching = true;
+                connection.switchJob = job->id;
+                connection.switchSent = Clock::now();
+            } else {
+                connection.output += "IDLE\n"; // A pending switch is still timed when its ACK arrives
+            }
+            flush(entry.first, connection);
+        }
+    };
+    auto disconnect = [&](int fd, Connection& connection) {
+        if (connection.worker != SIZE_MAX) {
+            workers[connection.worker].connected = false;
+            workers[connection.worker].seconds = secondsSince(joined[connection.worker]);
+            connectedWorkers.add(-1);
+        }
+        ::close(fd);
+        connections.erase(fd);
+    };
+    // Returns false for a line that should close the connection
+    std::vector<std::string_view> words;
+    auto handle = [&](Connection& connection, std::string_view line) {
+        ++messages;
+        splitWords(line, words);
+        if (words.empty()) {
+            return true;
+        }
+        if (words[0] == "HELLO" && words.size() == 2 && connection.worker == SIZE_MAX) {
+            connection.worker = workers.size();
+            workers.emplace_back();
+            workers.back().name = std::string(words[1]);
+            workers.back().connected = true;
+            joined.push_back(Clock::now());
+            connectedWorkers.add(1);
+            if (job && !job->found) {
+                assignSlice(connection);
+            }
+            changed.notify_all();
+            return true;
+        }
+        uint64_t id;
+        if (connection.worker == SIZE_MAX || words.size() < 2 || !parseNumber(words[1], id)) {
+            return false;
+        }
+        WorkerStats& worker = workers[connection.worker];
+        bool current = job && job->id == id && !job->found;
+        if (words[0] == "ACK" && words.size() == 2) {
+            if (connection.switching && connection.switchJob == id) {
+                double seconds = secondsSince(connection.switchSent);
+                switchLatency.observe(seconds);
+                ++worker.jobSwitches;
+                worker.switchSecondsMean += (seconds - worker.switchSecondsMean) / worker.jobSwitches;
+                worker.switchSecondsMax = std::max(worker.switchSecondsMax, seconds);
+                connection.switching = false;
+            }
+        } else if (words[0] == "PROGRESS" && words.size() == 3) {
+            uint64_t nonces;
+            if (!parseNumber(words[2], nonces)) {
+                return false;
+            }
+            worker.hashes += nonces;
+        } else if (words[0] == "DONE" && words.size() == 2) {
+            if (current) {
+                assignSlice(connection);
+            }
+        } else if (words[0] == "SHARE" && words.size() == 4) {
+            uint64_t extraNonce, nonce;
+            if (!parseNumber(words[2], extraNonce) || !parseNumber(words[3], nonce)) {
+                return false;
+            }
+            if (!current) {
+                ++worker.staleShares;
+                staleTotal.add();
+                return true;
+            }
+            Connection::Slice* slice = nullptr;
+            if (connection.jobId == id) {
+                for (auto& candidate : connection.slices) {
+                    if (candidate.extraNonce == extraNonce && candidate.firstNonce <= nonce && nonce < candidate.endNonce) {
+                        slice = &candidate;
+                        break;
+                    }
+                }
+            }
+            // A resubmitted nonce is no new work, so it does not count again
+            if (!slice || !slice->header.meetsDifficulty(nonce, job->shareBits) || !slice->submitted.insert(nonce).second) {
+                ++worker.invalidShares;
+                invalidTotal.add();
+                return true;
+            }
+            ++worker.shares;
+            sharesTotal.add();
+            if (slice->header.meetsDifficulty(nonce)) {
+                ++worker.blocks;
+                job->found = true;
+                job->nonce = nonce;
+                job->extraNonce = extraNonce;
+                changed.notify_all();
+                broadcast(); // Everybody idles until the next template
+            }
+        } else {
+            return false;
+        }
+        return true;
+    };
+
+    epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running) {
+        int ready = ::epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0) {
+            break;
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int i = 0; i < ready && running; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                uint64_t count;
+                ssize_t ignored = ::read(wakeFd, &count, sizeof(count));
+                (void)ignored;
+                if (stopping) {
+                    running = false;
+                } else if (jobChanged) {
+                    jobChanged = false;
+                    broadcast();
+                }
+                continue;
+            }
+            if (fd == listener) {
+                int client;
+                while ((client = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    connections[client];
+                    event.events = EPOLLIN;
+                    event.data.fd = client;
+                    ::epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event);
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = found->second;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                char buffer[16384];
+                while (!connection.closing) {
+                    ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+                    if (received > 0) {
+                        connection.input.append(buffer, static_cast<size_t>(received));
+                    } else if (received < 0 && errno == EINTR) {
+                        continue;
+                    } else if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    } else {
+                        connection.closing = true;
+                    }
+                }
+            }
+            size_t start = 0, newline;
+            while ((newline = connection.input.find('\n', start)) != std::string::npos) {
+                if (!handle(connection, std::string_view(connection.input).substr(start, newline - start))) {
+                    connection.closing = true;
+                    break;
+                }
+                start = newline + 1;
+            }
+            connection.input.erase(0, start);
+            if (connection.input.size() > MAX_LINE_BYTES) {
+                connection.closing = true;
+            }
+            if (!connection.closing) {
+                flush(fd, connection);
+            }
+            if (connection.closing) {
+                disconnect(fd, connection);
+            }
+        }
+        loopCpuSeconds = threadCpuSeconds();
+    }
+
+    // Closing the connections is what tells the workers to exit
+    std::lock_guard<std::mutex> lock(mutex);
+    while (!connections.empty()) {
+        disconnect(connections.begin()->first, connections.begin()->second);
+    }
+    loopCpuSeconds = threadCpuSeconds();
+    ::close(epoll);
+}
+
+bool PoolCoordinator::spawnWorkers(const std::string& executable, const std::vector<std::string>& arguments,
+                                   size_t count, std::vector<pid_t>& pids) {
+    for (size_t worker = 0; worker < count; ++worker) {
+        std::vector<std::string> expanded = {executable};
+        for (std::string argument : arguments) {
+            size_t at = argument.find("{}");
+            if (at != std::string::npos) {
+                argument.replace(at, 2, std::to_string(worker));
+            }
+            expanded.push_back(argument);
+        }
+        std::vector<char*> argv;
+        for (auto& argument : expanded) {
+            argv.push_back(&argument[0]);
+        }
+        argv.push_back(nullptr);
+        pid_t pid;
+        if (::posix_spawn(&pid, executable.c_str(), nullptr, nullptr, argv.data(), environ) != 0) {
+            return false;
+        }
+        pids.push_back(pid);
+    }
+    return true;
+}
+
+void PoolCoordinator::reapWorkers(std::vector<pid_t>& pids) {
+    for (pid_t pid : pids) {
+        int status;
+        while (::waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+        }
+    }
+    pids.clear();
+}
+
+PoolWorker::PoolWorker(const std::string& name) : name(name) {}
+
+bool PoolWorker::run(const std::string& socketPath) {
+    sockaddr_un address;
+    if (!unixAddress(socketPath, address)) {
+        return false;
+    }
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 ||
+        !writeAll(fd, "HELLO " + name + "\n")) {
+        ::close(fd);
+        return false;
+    }
+
+    std::unique_ptr<BlockHeader> header; // Null while idle
+    uint64_t jobId = 0, extraNonce = 0, nextNonce = 0, endNonce = 0;
+    int shareBits = 0;
+    uint64_t unreported = 0;
+    Clock::time_point reported = Clock::now();
+    std::string input, output;
+    std::vector<std::string_view> words;
+    std::vector<uint64_t> shares;
+    auto report = [&]() {
+        if (unreported > 0) {
+            output += "PROGRESS ";
+            appendNumber(output, jobId);
+            output += ' ';
+            appendNumber(output, unreported);
+            output += '\n';
+            unreported = 0;
+        }
+        reported = Clock::now();
+    };
+
+    char buffer[4096];
+    while (true) {
+        // Block while idle; otherwise only look whether the coordinator sent anything
+        pollfd readable = {fd, POLLIN, 0};
+        int ready = ::poll(&readable, 1, header ? 0 : -1);
+        if (ready < 0 && errno != EINTR) {
+            break;
+        }
+        if (ready > 0) {
+            ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+            if (received <= 0 && !(received < 0 && errno == EINTR)) {
+                break; // The coordinator is gone
+            }
+            input.append(buffer, static_cast<size_t>(std::max<ssize_t>(received, 0)));
+            size_t start = 0, newline;
+            while ((newline = input.find('\n', start)) != std::string::npos) {
+                splitWords(std::string_view(input).substr(start, newline - start), words);
+                start = newline + 1;
+                Digest previous, merkleRoot;
+                uint64_t id, bits, share, extra, first, end;
+                if (words.size() == 10 && words[0] == "JOB" && parseNumber(words[1], id) &&
+                    Digest::parseHex(words[2].data(), words[2].size(), previous) &&
+                    Digest::parseHex(words[4].data(), words[4].size(), merkleRoot) &&
+                    parseNumber(words[5], bits) && parseNumber(words[6], share) && parseNumber(words[7], extra) &&
+                    parseNumber(words[8], first) && parseNumber(words[9], end)) {
+                    report(); // Hashes of the previous job still count for it
+                    if (id != jobId) {
+                        output += "ACK ";
+                        appendNumber(output, id);
+                        output += '\n';
+                    }
+                    header.reset(new BlockHeader(previous, std::string(words[3]), merkleRoot, extra, static_cast<int>(bits)));
+                    jobId = id;
+                    extraNonce = extra;
+                    nextNonce = first;
+                    endNonce = end;
+                    shareBits = static_cast<int>(share);
+                } else if (words.size() == 1 && words[0] == "IDLE") {
+                    report();
+                    header.reset();
+                }
+            }
+            input.erase(0, start);
+        }
+
+        if (header) {
+            uint64_t stop = nextNonce + std::min(NONCES_PER_CHECK, endNonce - nextNonce);
+            hashRange(*header, shareBits, nextNonce, stop, shares);
+            bool solved = false;
+            for (uint64_t nonce : shares) {
+                output += "SHARE ";
+                appendNumber(output, jobId);
+                output += ' ';
+                appendNumber(output, extraNonce);
+                output += ' ';
+                appendNumber(output, nonce);
+                output += '\n';
+                if (header->meetsDifficulty(nonce)) {
+                    // A block ends the job; stop here instead of hashing until IDLE arrives
+                    solved = true;
+                    stop = nonce + 1;
+                    break;
+                }
+            }
+            shares.clear();
+            unreported += stop - nextNonce;
+            nextNonce = stop;
+            if (solved) {
+                report();
+                header.reset();
+            } else if (nextNonce == endNonce) {
+                report();
+                output += "DONE ";
+                appendNumber(output, jobId);
+                output += '\n';
+                header.reset();
+            }
+        }
+        if (unreported > 0 && secondsSince(reported) >= PROGRESS_SECONDS) {
+            report();
+        }
+        if (!output.empty()) {
+            if (!writeAll(fd, output)) {
+                break;
+            }
+            output.clear();
+        }
+    }
+    ::close(fd);
+    return true;
+}
+
+double PoolWorker::soloHashRate(double seconds) {
+    BlockHeader header(Digest(), "0", Digest(), 0, 4);
+    int shareBits = PoolCoordinator::Config().shareBits;
+    std::vector<uint64_t> shares;
+    uint64_t hashed = 0;
+    auto start = Clock::now();
+    do {
+        hashRange(header, shareBits, hashed, hashed + NONCES_PER_CHECK, shares);
+        shares.clear();
+        hashed += NONCES_PER_CHECK;
+    } while (secondsSince(start) < seconds);
+    return hashed / secondsSince(start);
+}
@@ -0,0 +1,138 @@
+#ifndef MININGPOOL_H
+#define MININGPOOL_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <sys/types.h>
+#include "block.h"
+
+// Mining spread over worker processes on one host, coordinated over a Unix domain socket.
+//
+// The coordinator gives every worker its own slice of the current template's search
+// space: a range of nonces under one extra nonce, and another slice whenever a worker
+// reports its range done. Slices follow Block::mineBlock's search order, the whole nonce
+// range of an extra nonce before the next one, and never overlap. Workers hash their slice
+// and submit every nonce that meets the share target, which is easier than the block
+// target, so shares show how much work each worker is doing. The coordinator re-hashes
+// each share and credits every (extra nonce, nonce) once; a share that also meets the
+// block target ends the job. A new template replaces the job on every worker at once,
+// and a found block sends every worker idle at once, so nobody keeps hashing stale work.
+// Shares for an older job are counted as stale.
+//
+// One text line per message, hashes as 64 hex characters:
+//
+//   coordinator -> worker   JOB <job> <previous> <timestamp> <merkle root> <bits> <share bits>
+//                               <extra nonce> <first nonce> <end nonce>
+//                           IDLE
+//   worker -> coordinator   HELLO <name>
+//                           ACK <job>                  sent as soon as a JOB is taken up
+//                           SHARE <job> <extra nonce> <nonce>
+//                           PROGRESS <job> <nonces>    hashed since the last report
+//                           DONE <job>                 slice finished, asking for another
+//
+// The whole coordinator is one epoll thread; mine() is called from the block pipeline and
+// waits for it.
+class PoolCoordinator {
+public:
+    struct Config {
+        int shareBits = 3;                 // Capped at the block's difficulty bits
+        uint64_t sliceNonces = 1ULL << 20; // Nonces per slice
+    };
+
+    struct WorkerStats {
+        std::string name;
+        bool connected = false;
+        double seconds = 0;             // Connected time
+        uint64_t hashes = 0;            // As reported by the worker
+        uint64_t shares = 0;
+        uint64_t staleShares = 0;       // For a job that had already been replaced
+        uint64_t invalidShares = 0;     // Outside the worker's slices, short of the share target or repeated
+        uint64_t blocks = 0;
+        size_t jobSwitches = 0;
+        double switchSecondsMean = 0;   // New job sent until the worker acknowledged it
+        double switchSecondsMax = 0;
+    };
+
+    struct Stats {
+        std::vector<WorkerStats> workers;
+        uint64_t jobs = 0;
+        uint64_t messages = 0;          // Lines received
+        double seconds = 0;             // Since start()
+        double loopCpuSeconds = 0;      // CPU time of the coordinator thread
+    };
+
+    PoolCoordinator();
+    explicit PoolCoordinator(const Config& config);
+    ~PoolCoordinator();
+
+    PoolCoordinator(const PoolCoordinator&) = delete;
+    PoolCoordinator& operator=(const PoolCoordinator&) = delete;
+
+    bool listen(const std::string& path); // Replaces a stale socket file at `path`
+    bool start();
+    void stop();
+
+    // Waits until `count` workers have said HELLO; false on timeout
+    bool waitForWorkers(size_t count, double timeoutSeconds);
+    // Mines a template on the connected workers and fills in its proof of work; returns
+    // false when the coordinator is stopped or the job cancelled first
+    bool mine(Block& block);
+    // Sends every worker idle, e.g. because a block for this height arrived from elsewhere
+    void cancel();
+    Stats stats() const;
+
+    // Starts `count` processes of `executable` with `arguments`; "{}" in an argument is
+    // replaced by the worker's number
+    static bool spawnWorkers(const std::string& executable, const std::vector<std::string>& arguments, size_t count,
+                             std::vector<pid_t>& pids);
+    static void reapWorkers(std::vector<pid_t>& pids);
+
+private:
+    struct Job;
+    struct Connection;
+
+    Config config;
+    int listener;
+    int wakeFd;
+    std::string path;
+    std::thread loop;
+    mutable std::mutex mutex; // Guards everything below
+    std::condition_variable changed;
+    bool stopping;
+    std::shared_ptr<Job> job;          // Current template, null while idle
+    uint64_t jobCounter;
+    bool jobChanged;                   // Set by mine(), taken up by the loop
+    std::vector<WorkerStats> workers;  // In the order workers said HELLO
+    std::vector<std::chrono::steady_clock::time_point> joined;
+    uint64_t messages;
+    double loopCpuSeconds;
+    std::chrono::steady_clock::time_point started;
+
+    void run();
+};
+
+// A pool worker: one hashing thread per process, so mining scales by starting more
+// processes, each of which can sit in its own cgroup or container.
+class PoolWorker {
+public:
+    explicit PoolWorker(const std::string& name);
+
+    // Connects to the coordinator and mines whatever it hands out until it closes the
+    // connection; false if it cannot connect
+    bool run(const std::string& path);
+
+    // Hash rate of this process with no coordinator, hashing one fixed header for
+    // `seconds` with the same loop as run(); the baseline the pool is measured against
+    static double soloHashRate(double seconds);
+
+private:
+    std::string name;
+};
+
+#endif // MININGPOOL_H
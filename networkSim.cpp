@@ -0,0 +1,150 @@
+// networkSim.cpp
+// Runs the multi-node simulator for a list of node counts and prints how stale blocks,
+// propagation time and throughput change with the size of the network.
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include "networkSimulator.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+void usage() {
+    std::cout << "Usage: network_sim [--nodes 1,2,4,8] [--extra-peers 2] [--latency-ms 20] [--bandwidth-mbps 0]"
+                 " [--bits 4] [--hashrate 200] [--blocks 40] [--max-seconds 60] [--users 60] [--transactions 20000] [--seed 1]"
+                 " [--json out.json]\n";
+}
+
+std::vector<size_t> parseList(const std::string& text) {
+    std::vector<size_t> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t value = std::strtoull(item.c_str(), nullptr, 10);
+        if (value > 0) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+bool writeJson(const std::string& path, const NetworkSimulator::Config& config,
+               const std::vector<NetworkSimulator::Result>& results) {
+    std::ofstream out(path);
+    out << std::setprecision(9);
+    out << "{\n  \"latency_seconds\": " << config.latencySeconds << ",\n  \"bandwidth_bytes_per_second\": "
+        << config.bandwidthBytesPerSecond << ",\n  \"difficulty_bits\": " << config.difficultyBits
+        << ",\n  \"hashes_per_second_per_node\": " << config.hashesPerSecond
+        << ",\n  \"target_height\": " << config.targetHeight << ",\n  \"runs\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const NetworkSimulator::Result& r = results[i];
+        out << "    {\"nodes\": " << r.nodes << ", \"seconds\": " << r.seconds << ", \"blocks_mined\": " << r.blocksMined
+            << ", \"hashes\": " << r.hashes
+            << ", \"main_chain_blocks\": " << r.mainChainBlocks << ", \"stale_rate\": " << r.staleRate
+            << ", \"orphans_received\": " << r.orphansReceived << ", \"reorgs\": " << r.reorgs
+            << ", \"max_reorg_depth\": " << r.maxReorgDepth << ", \"propagation_mean_seconds\": " << r.propagationMean
+            << ", \"propagation_p90_seconds\": " << r.propagationP90 << ", \"propagation_max_seconds\": "
+            << r.propagationMax << ", \"transactions_confirmed\": " << r.transactionsConfirmed
+            << ", \"transactions_per_second\": " << r.transactionsPerSecond << ", \"blocks_per_second\": "
+            << r.blocksPerSecond << ", \"bytes_sent\": " << r.bytesSent << ", \"converged\": "
+            << (r.converged ? "true" : "false") << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    NetworkSimulator::Config config;
+    std::vector<size_t> nodeCounts = {1, 2, 4, 8};
+    size_t userCount = 60, transactionCount = 20000;
+    std::string jsonPath;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--nodes" && i + 1 < argc) {
+            nodeCounts = parseList(argv[++i]);
+        } else if (arg == "--extra-peers" && i + 1 < argc) {
+            config.extraPeers = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--latency-ms" && i + 1 < argc) {
+            config.latencySeconds = std::strtod(argv[++i], nullptr) / 1000;
+        } else if (arg == "--bandwidth-mbps" && i + 1 < argc) {
+            config.bandwidthBytesPerSecond = std::strtod(argv[++i], nullptr) * 1e6 / 8;
+        } else if (arg == "--bits" && i + 1 < argc) {
+            config.difficultyBits = std::atoi(argv[++i]);
+        } else if (arg == "--hashrate" && i + 1 < argc) {
+            config.hashesPerSecond = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--blocks" && i + 1 < argc) {
+            config.targetHeight = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--max-seconds" && i + 1 < argc) {
+            config.maxSeconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--users" && i + 1 < argc) {
+            userCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--transactions" && i + 1 < argc) {
+            transactionCount = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            config.seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (nodeCounts.empty()) {
+        usage();
+        return 2;
+    }
+
+    WorkloadGenerator generator(config.seed);
+    std::vector<User> users = generator.generateUsers(userCount);
+    std::vector<Transaction> transactions;
+    transactions.reserve(transactionCount);
+    generator.generateTransactions(users, transactionCount, [&](std::vector<Transaction>& chunk) {
+        transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+    });
+
+    std::cout << "Network simulation: " << config.latencySeconds * 1000 << " ms latency, ";
+    if (config.bandwidthBytesPerSecond > 0) {
+        std::cout << config.bandwidthBytesPerSecond * 8 / 1e6 << " Mbit/s";
+    } else {
+        std::cout << "unlimited bandwidth";
+    }
+    std::cout << " per link, " << config.difficultyBits << " difficulty bits, "
+              << (config.hashesPerSecond > 0 ? std::to_string(static_cast<uint64_t>(config.hashesPerSecond)) + " H/s"
+                                             : std::string("unthrottled"))
+              << " per node, " << config.targetHeight
+              << " blocks, " << transactions.size() << " transactions\n";
+    std::cout << std::setw(6) << "nodes" << std::setw(9) << "seconds" << std::setw(8) << "mined" << std::setw(7) << "main"
+              << std::setw(11) << "hash/block"
+              << std::setw(8) << "stale%" << std::setw(9) << "orphans" << std::setw(8) << "reorgs" << std::setw(7)
+              << "depth" << std::setw(11) << "prop ms" << std::setw(10) << "p90 ms" << std::setw(10) << "max ms"
+              << std::setw(10) << "tx/s" << std::setw(10) << "blocks/s" << std::setw(10) << "MB sent"
+              << std::setw(11) << "converged" << "\n";
+
+    std::vector<NetworkSimulator::Result> results;
+    for (size_t nodes : nodeCounts) {
+        config.nodes = nodes;
+        NetworkSimulator::Result r = NetworkSimulator(config, users, transactions).run();
+        results.push_back(r);
+        std::cout << std::fixed << std::setw(6) << r.nodes << std::setw(9) << std::setprecision(2) << r.seconds
+                  << std::setw(8) << r.blocksMined << std::setw(7) << r.mainChainBlocks << std::setw(11)
+                  << (r.blocksMined > 0 ? r.hashes / r.blocksMined : 0) << std::setw(8)
+                  << std::setprecision(1) << r.staleRate * 100 << std::setw(9) << r.orphansReceived << std::setw(8)
+                  << r.reorgs << std::setw(7) << r.maxReorgDepth << std::setw(11) << r.propagationMean * 1000
+                  << std::setw(10) << r.propagationP90 * 1000 << std::setw(10) << r.propagationMax * 1000
+                  << std::setw(10) << r.transactionsPerSecond << std::setw(10) << std::setprecision(2)
+                  << r.blocksPerSecond << std::setw(10) << r.bytesSent / 1e6 << std::setw(11)
+                  << (r.converged ? "yes" : "NO") << std::endl;
+    }
+    if (!jsonPath.empty() && !writeJson(jsonPath, config, results)) {
+        std::cout << "Could not write " << jsonPath << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,535 @@
+#include "networkSimulator.h"
+#include "accountState.h"
+#include "block.h"
+#include "blockHeader.h"
+#include "blockValidator.h"
+#include "mempool.h"
+#include "merkleRootHash.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+// Nonces tried between two looks at the inbox, at most; rate-limited nodes use about 1 ms worth
+const uint64_t NONCES_PER_SLICE = 2048;
+// Header fields of a block on the wire; transactions add sizeof(Transaction) each
+const size_t BLOCK_OVERHEAD_BYTES = 256;
+
+struct Message {
+    Clock::time_point deliverAt;
+    uint64_t sequence = 0;
+    size_t from = 0;
+    std::shared_ptr<const Block> block;                           // Either a block
+    std::shared_ptr<const std::vector<Transaction>> transactions; // or a batch of transactions
+};
+
+struct LaterFirst {
+    bool operator()(const Message& a, const Message& b) const {
+        return a.deliverAt != b.deliverAt ? a.deliverAt > b.deliverAt : a.sequence > b.sequence;
+    }
+};
+
+// Messages ordered by delivery time; a message is only handed out once it is due
+class Inbox {
+public:
+    void push(Message message) {
+        std::lock_guard<std::mutex> lock(mutex);
+        queue.push(std::move(message));
+        wake.notify_one();
+    }
+
+    // Appends every due message to `out`; with nothing due, waits up to `wait` for one
+    void takeDue(std::vector<Message>& out, Clock::duration wait) {
+        std::unique_lock<std::mutex> lock(mutex);
+        Clock::time_point deadline = Clock::now() + wait;
+        while (true) {
+            Clock::time_point now = Clock::now();
+            while (!queue.empty() && queue.top().deliverAt <= now) {
+                out.push_back(queue.top());
+                queue.pop();
+            }
+            if (!out.empty() || now >= deadline) {
+                return;
+            }
+            wake.wait_until(lock, queue.empty() ? deadline : std::min(deadline, queue.top().deliverAt));
+        }
+    }
+
+private:
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::priority_queue<Message, std::vector<Message>, LaterFirst> queue;
+};
+
+struct BlockRecord {
+    Clock::time_point minedAt;
+    Clock::time_point lastReceived;
+    size_t receivedBy = 0;
+};
+
+class Node;
+
+// State shared by all nodes of one run
+struct Simulation {
+    NetworkSimulator::Config config;
+    std::vector<std::unique_ptr<Node>> nodes;
+    std::atomic<bool> mining{true};
+    std::atomic<bool> running{true};
+    std::atomic<size_t> stoppedMiners{0};
+    std::atomic<size_t> bestHeight{0};
+    std::atomic<int64_t> inFlight{0}; // Sent but not yet processed by the receiver
+    std::atomic<uint64_t> bytesSent{0};
+    std::atomic<uint64_t> sequence{0};
+    std::mutex recordsMutex;
+    std::unordered_map<Digest, BlockRecord, DigestHasher> records;
+};
+
+class Node {
+public:
+    struct Entry {
+        std::shared_ptr<const Block> block;
+        size_t height;
+        std::vector<int64_t> balances; // After this block
+    };
+
+    std::vector<size_t> peers;
+    Inbox inbox;
+    std::vector<Digest> chain; // Active chain by height
+    std::unordered_map<Digest, Entry, DigestHasher> blocks;
+    size_t mined = 0;
+    uint64_t hashes = 0;
+    size_t orphansReceived = 0;
+    size_t reorgs = 0;
+    size_t maxReorgDepth = 0;
+
+    Node(size_t id, Simulation& simulation, const AccountState& accounts, const std::shared_ptr<const Block>& genesis)
+        : id(id), simulation(simulation), accounts(accounts), validator(1) {
+        double rate = simulation.config.hashesPerSecond;
+        slice = rate > 0 ? std::max<uint64_t>(1, std::min<uint64_t>(NONCES_PER_SLICE, static_cast<uint64_t>(rate / 1000)))
+                         : NONCES_PER_SLICE;
+        blocks.emplace(genesis->getBlockID(), Entry{genesis, 0, accounts.getBalances()});
+        chain.push_back(genesis->getBlockID());
+    }
+
+    void connectTo(size_t peer) {
+        if (peer != id && std::find(peers.begin(), peers.end(), peer) == peers.end()) {
+            peers.push_back(peer);
+            linkBusy.push_back(Clock::time_point());
+        }
+    }
+
+    void run() {
+        std::vector<Message> due;
+        bool stopped = false;
+        double rate = simulation.config.hashesPerSecond;
+        Clock::time_point miningStart = Clock::now();
+        startTemplate();
+        while (simulation.running.load()) {
+            if (!stopped && !simulation.mining.load()) {
+                stopped = true; // No block found after this point is published
+                simulation.stoppedMiners++;
+            }
+            Clock::duration wait = Clock::duration::zero();
+            if (stopped) {
+                wait = std::chrono::milliseconds(5);
+            } else if (rate > 0) {
+                Clock::time_point nextSlice = miningStart +
+                    std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(hashes / rate));
+                wait = std::max(Clock::duration::zero(), nextSlice - Clock::now());
+            }
+            due.clear();
+            inbox.takeDue(due, wait);
+            bool restart = false;
+            for (const Message& message : due) {
+                restart |= message.block ? receiveBlock(message.block, message.from)
+                                         : receiveTransactions(*message.transactions, message.from);
+                simulation.inFlight--;
+            }
+            if (restart) {
+                startTemplate();
+            }
+            if (!stopped && (rate <= 0 || due.empty())) {
+                mineSlice();
+            }
+        }
+    }
+
+private:
+    size_t id;
+    Simulation& simulation;
+    AccountState accounts; // Scratch copy; balances are loaded from the entry being built on
+    BlockValidator validator;
+    Mempool mempool;
+    std::vector<Clock::time_point> linkBusy; // Per peer: when the outgoing link is free again
+    std::unordered_map<Digest, std::vector<std::shared_ptr<const Block>>, DigestHasher> waitingForParent;
+    std::unordered_set<Digest, DigestHasher> waitingIds;
+    std::unordered_set<Digest, DigestHasher> rejectedBlocks;
+    std::unordered_set<Digest, DigestHasher> seenTransactions;
+    std::unordered_map<Digest, size_t, DigestHasher> chainTransactions; // On the active chain -> height
+    std::unique_ptr<Block> candidate;
+    std::unique_ptr<BlockHeader> header;
+    uint64_t nonce = 0;
+    uint64_t slice = NONCES_PER_SLICE;
+
+    void loadBalances(const std::vector<int64_t>& balances) {
+        for (size_t account = 0; account < balances.size(); ++account) {
+            accounts.updateBalance(account, balances[account] - accounts.getBalance(account));
+        }
+    }
+
+    bool onActiveChain(const Entry& entry) const {
+        return entry.height < chain.size() && chain[entry.height] == entry.block->getBlockID();
+    }
+
+    void send(size_t peerIndex, Message message, size_t bytes) {
+        const NetworkSimulator::Config& config = simulation.config;
+        Clock::time_point start = std::max(Clock::now(), linkBusy[peerIndex]);
+        Clock::duration transmit = config.bandwidthBytesPerSecond > 0
+            ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(bytes / config.bandwidthBytesPerSecond))
+            : Clock::duration::zero();
+        linkBusy[peerIndex] = start + transmit;
+        message.deliverAt = linkBusy[peerIndex] +
+            std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(config.latencySeconds));
+        message.from = id;
+        message.sequence = simulation.sequence++;
+        simulation.inFlight++;
+        simulation.bytesSent += bytes;
+        simulation.nodes[peers[peerIndex]]->inbox.push(std::move(message));
+    }
+
+    void relay(const Message& message, size_t except, size_t bytes) {
+        for (size_t p = 0; p < peers.size(); ++p) {
+            if (peers[p] != except) {
+                send(p, message, bytes);
+            }
+        }
+    }
+
+    // A template on the active tip; transactions of an abandoned one go back to the pool
+    void startTemplate() {
+        if (candidate) {
+            for (const auto& transaction : candidate->getTransactions()) {
+                if (!chainTransactions.count(transaction.getTransactionID())) {
+                    mempool.add(transaction);
+                }
+            }
+        }
+        loadBalances(blocks.at(chain.back()).balances);
+        std::vector<Transaction> rejected;
+        std::vector<Transaction> selected =
+            mempool.selectForBlock(accounts, simulation.config.maxTransactionsPerBlock, rejected);
+        candidate.reset(new Block(chain.back(), selected, 1));
+        candidate->setDifficultyBits(simulation.config.difficultyBits);
+        header.reset(new BlockHeader(candidate->createHeader(id))); // Extra nonce = node, so nodes never mine the same header
+        nonce = 0;
+    }
+
+    void mineSlice() {
+        uint64_t end = nonce + slice;
+        uint64_t first = nonce;
+        while (nonce < end && !header->meetsDifficulty(nonce)) {
+            ++nonce;
+        }
+        hashes += std::min(nonce + 1, end) - first;
+        if (nonce == end) {
+            return;
+        }
+        auto block = std::make_shared<const Block>(Block::restore(
+            header->hash(nonce), candidate->getPreviousHash(), candidate->getMerkleRootHash(), candidate->getTimestamp(),
+            nonce, id, candidate->getDifficultyBits(), candidate->getVersion(), candidate->getTransactions()));
+        candidate.reset();
+        mined++;
+        {
+            std::lock_guard<std::mutex> lock(simulation.recordsMutex);
+            simulation.records[block->getBlockID()].minedAt = Clock::now();
+        }
+        receiveBlock(block, id);
+        startTemplate();
+    }
+
+    bool checkHeader(const Block& block) const {
+        if (block.getDifficultyBits() != simulation.config.difficultyBits ||
+            block.getBlockID().leadingZeroBits() < block.getDifficultyBits()) {
+            return false;
+        }
+        BlockHeader serialized(block.getPreviousHash(), block.getTimestamp(), block.getMerkleRootHash(),
+                               block.getExtraNonce(), block.getDifficultyBits());
+        if (serialized.hash(block.getNonce()) != block.getBlockID()) {
+            return false;
+        }
+        std::vector<Digest> leaves;
+        leaves.reserve(block.getTransactions().size());
+        for (const auto& transaction : block.getTransactions()) {
+            leaves.push_back(transaction.getTransactionID());
+        }
+        return MerkleTree(leaves).root() == block.getMerkleRootHash();
+    }
+
+    // True when the active tip changed
+    bool receiveBlock(const std::shared_ptr<const Block>& block, size_t from) {
+        const Digest& blockID = block->getBlockID();
+        if (blocks.count(blockID) || waitingIds.count(blockID) || rejectedBlocks.count(blockID)) {
+            return false;
+        }
+        if (from != id && !checkHeader(*block)) {
+            rejectedBlocks.insert(blockID);
+            return false;
+        }
+        {
+            std::lock_guard<std::mutex> lock(simulation.recordsMutex);
+            BlockRecord& record = simulation.records[blockID];
+            record.receivedBy++;
+            record.lastReceived = Clock::now();
+        }
+        Message message;
+        message.block = block;
+        relay(message, from, BLOCK_OVERHEAD_BYTES + block->getTransactions().size() * sizeof(Transaction));
+
+        if (!blocks.count(block->getPreviousHash())) {
+            waitingForParent[block->getPreviousHash()].push_back(block);
+            waitingIds.insert(blockID);
+            orphansReceived++;
+            return false;
+        }
+        bool tipChanged = false;
+        std::vector<std::shared_ptr<const Block>> ready(1, block);
+        while (!ready.empty()) {
+            std::shared_ptr<const Block> next = ready.back();
+            ready.pop_back();
+            tipChanged |= connect(next);
+            auto children = waitingForParent.find(next->getBlockID());
+            if (children != waitingForParent.end() && blocks.count(next->getBlockID())) {
+                for (const auto& child : children->second) {
+                    waitingIds.erase(child->getBlockID());
+                    ready.push_back(child);
+                }
+                waitingForParent.erase(children);
+            }
+        }
+        return tipChanged;
+    }
+
+    // Validates a block whose parent is known and adds it to the tree; true when it became the tip
+    bool connect(const std::shared_ptr<const Block>& block) {
+        const Entry& parent = blocks.at(block->getPreviousHash());
+
+        // Transactions already on this branch: the part off the active chain, then the active chain up to the fork
+        std::unordered_set<Digest, DigestHasher> branchTransactions;
+        const Entry* entry = &parent;
+        while (!onActiveChain(*entry)) {
+            for (const auto& transaction : entry->block->getTransactions()) {
+                branchTransactions.insert(transaction.getTransactionID());
+            }
+            entry = &blocks.at(entry->block->getPreviousHash());
+        }
+        size_t forkHeight = entry->height;
+        for (const auto& transaction : block->getTransactions()) {
+            auto confirmed = chainTransactions.find(transaction.getTransactionID());
+            if (!branchTransactions.insert(transaction.getTransactionID()).second ||
+                (confirmed != chainTransactions.end() && confirmed->second <= forkHeight)) {
+                rejectedBlocks.insert(block->getBlockID());
+                return false;
+            }
+        }
+        loadBalances(parent.balances);
+        BlockValidator::Result result = validator.validateBlock(*block, accounts);
+        if (result.invalidIds > 0 || result.unknownAccounts > 0 || result.insufficientBalance > 0) {
+            rejectedBlocks.insert(block->getBlockID());
+            return false;
+        }
+
+        size_t height = parent.height + 1;
+        blocks.emplace(block->getBlockID(), Entry{block, height, accounts.getBalances()});
+        if (height < chain.size()) {
+            return false; // Ties keep the branch seen first
+        }
+        switchTo(block->getBlockID());
+        return true;
+    }
+
+    void switchTo(const Digest& tip) {
+        std::vector<const Entry*> branch;
+        const Entry* entry = &blocks.at(tip);
+        while (!onActiveChain(*entry)) {
+            branch.push_back(entry);
+            entry = &blocks.at(entry->block->getPreviousHash());
+        }
+        size_t depth = chain.size() - 1 - entry->height;
+        if (depth > 0) {
+            reorgs++;
+            maxReorgDepth = std::max(maxReorgDepth, depth);
+        }
+        while (chain.size() - 1 > entry->height) {
+            for (const auto& transaction : blocks.at(chain.back()).block->getTransactions()) {
+                chainTransactions.erase(transaction.getTransactionID());
+                mempool.add(transaction);
+            }
+            chain.pop_back();
+        }
+        for (auto it = branch.rbegin(); it != branch.rend(); ++it) {
+            for (const auto& transaction : (*it)->block->getTransactions()) {
+                chainTransactions[transaction.getTransactionID()] = (*it)->height;
+                mempool.remove(transaction.getTransactionID());
+            }
+            chain.push_back((*it)->block->getBlockID());
+        }
+
+        size_t height = chain.size() - 1;
+        size_t best = simulation.bestHeight.load();
+        while (height > best && !simulation.bestHeight.compare_exchange_weak(best, height)) {
+        }
+    }
+
+    // True when an empty template should be rebuilt now that there is something to include
+    bool receiveTransactions(const std::vector<Transaction>& transactions, size_t from) {
+        // Transactions whose ID does not match their contents are neither kept nor relayed
+        std::vector<char> idValid = validator.verifyTransactionIds(transactions);
+        auto fresh = std::make_shared<std::vector<Transaction>>();
+        for (size_t i = 0; i < transactions.size(); ++i) {
+            const Transaction& transaction = transactions[i];
+            if (idValid[i] && seenTransactions.insert(transaction.getTransactionID()).second) {
+                fresh->push_back(transaction);
+                if (!chainTransactions.count(transaction.getTransactionID())) {
+                    mempool.add(transaction);
+                }
+            }
+        }
+        if (!fresh->empty()) {
+            Message message;
+            message.transactions = fresh;
+            relay(message, from, fresh->size() * sizeof(Transaction));
+        }
+        return candidate && candidate->getNumTransactions() == 0 && !mempool.empty();
+    }
+};
+
+double percentile(std::vector<double> values, double p) {
+    if (values.empty()) {
+        return 0;
+    }
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, static_cast<size_t>(p * static_cast<double>(values.size() - 1) + 0.5))];
+}
+
+} // namespace
+
+NetworkSimulator::NetworkSimulator(const Config& config, const std::vector<User>& users,
+                                   const std::vector<Transaction>& transactions)
+    : config(config), users(users), transactions(transactions) {}
+
+NetworkSimulator::Result NetworkSimulator::run() {
+    Simulation simulation;
+    simulation.config = config;
+    simulation.config.nodes = std::max<size_t>(1, config.nodes);
+    size_t nodeCount = simulation.config.nodes;
+
+    // Every node starts from the same genesis block and balances
+    Block genesisBlock(Digest(), std::vector<Transaction>(), 1);
+    genesisBlock.mineBlock(1);
+    auto genesis = std::make_shared<const Block>(genesisBlock);
+    AccountState accounts = AccountState::fromUsers(users);
+    for (size_t i = 0; i < nodeCount; ++i) {
+        simulation.nodes.emplace_back(new Node(i, simulation, accounts, genesis));
+    }
+
+    // Ring for connectivity, plus random links
+    std::mt19937_64 random(config.seed);
+    auto link = [&](size_t a, size_t b) {
+        simulation.nodes[a]->connectTo(b);
+        simulation.nodes[b]->connectTo(a);
+    };
+    for (size_t i = 0; nodeCount > 1 && i < nodeCount; ++i) {
+        link(i, (i + 1) % nodeCount);
+        for (size_t k = 0; k < config.extraPeers; ++k) {
+            link(i, random() % nodeCount);
+        }
+    }
+
+    // Each transaction enters the network at one random node
+    std::vector<std::shared_ptr<std::vector<Transaction>>> origins(nodeCount);
+    for (auto& origin : origins) {
+        origin = std::make_shared<std::vector<Transaction>>();
+    }
+    for (const auto& transaction : transactions) {
+        origins[random() % nodeCount]->push_back(transaction);
+    }
+    Clock::time_point start = Clock::now();
+    for (size_t i = 0; i < nodeCount; ++i) {
+        Message message;
+        message.deliverAt = start;
+        message.from = i;
+        message.transactions = origins[i];
+        simulation.inFlight++;
+        simulation.nodes[i]->inbox.push(std::move(message));
+    }
+
+    std::vector<std::thread> threads;
+    for (auto& node : simulation.nodes) {
+        threads.emplace_back([&node] { node->run(); });
+    }
+    auto elapsed = [&] { return std::chrono::duration<double>(Clock::now() - start).count(); };
+    while (simulation.bestHeight.load() < config.targetHeight && elapsed() < config.maxSeconds) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    simulation.mining = false;
+    Result result;
+    result.seconds = elapsed();
+    // Let every miner notice the stop, then deliver whatever is still on the wire
+    while (simulation.stoppedMiners.load() < nodeCount || simulation.inFlight.load() > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    simulation.running = false;
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    result.nodes = nodeCount;
+    const Node* longest = simulation.nodes[0].get();
+    result.converged = true;
+    for (const auto& node : simulation.nodes) {
+        result.blocksMined += node->mined;
+        result.hashes += node->hashes;
+        result.orphansReceived += node->orphansReceived;
+        result.reorgs += node->reorgs;
+        result.maxReorgDepth = std::max(result.maxReorgDepth, node->maxReorgDepth);
+        result.converged = result.converged && node->chain.back() == simulation.nodes[0]->chain.back();
+        if (node->chain.size() > longest->chain.size()) {
+            longest = node.get();
+        }
+    }
+    result.mainChainBlocks = longest->chain.size() - 1;
+    for (size_t height = 1; height < longest->chain.size(); ++height) {
+        result.transactionsConfirmed += longest->blocks.at(longest->chain[height]).block->getTransactions().size();
+    }
+    result.staleRate = result.blocksMined > 0
+        ? static_cast<double>(result.blocksMined - result.mainChainBlocks) / static_cast<double>(result.blocksMined)
+        : 0;
+
+    std::vector<double> propagation;
+    for (const auto& entry : simulation.records) {
+        if (entry.second.receivedBy == nodeCount) {
+            propagation.push_back(std::chrono::duration<double>(entry.second.lastReceived - entry.second.minedAt).count());
+        }
+    }
+    result.propagated = propagation.size();
+    for (double seconds : propagation) {
+        result.propagationMean += seconds / static_cast<double>(propagation.size());
+    }
+    result.propagationP90 = percentile(propagation, 0.90);
+    result.propagationMax = percentile(propagation, 1.0);
+    result.transactionsPerSecond = static_cast<double>(result.transactionsConfirmed) / result.seconds;
+    result.blocksPerSecond = static_cast<double>(result.mainChainBlocks) / result.seconds;
+    result.bytesSent = simulation.bytesSent.load();
+    return result;
+}
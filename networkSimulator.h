@@ -0,0 +1,74 @@
+#ifndef NETWORKSIMULATOR_H
+#define NETWORKSIMULATOR_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "transactions.h"
+#include "user.h"
+
+// In-process network of competing miners, for seeing how forks, propagation and
+// throughput change with the number of nodes.
+//
+// Every node is a thread with its own mempool, account balances, block tree and active
+// chain. Nodes are linked in a ring plus random extra links; each directed link delivers
+// messages after a fixed latency and serializes them at the link bandwidth, so a large
+// block also delays whatever is queued behind it. Transactions are handed to random nodes
+// and gossiped; a mined block is checked (proof of work, Merkle root) and relayed to all
+// peers except the sender, then validated against the balances of its parent before it
+// joins the tree. Nodes follow the longest chain: a longer branch replaces the active one,
+// the transactions of the dropped blocks go back to the mempool and the miner restarts on
+// the new tip. Mining runs in short nonce slices so arriving blocks are seen promptly.
+// Difficulty cannot go past a few bits with this hash, so the block interval is set by
+// capping each node's hash rate instead: a node that is ahead of its rate waits on its
+// inbox until the next slice is due.
+//
+// Mining stops once some node's chain reaches the target height (or after maxSeconds);
+// the run ends when every message in flight has been delivered.
+class NetworkSimulator {
+public:
+    struct Config {
+        size_t nodes = 4;
+        size_t extraPeers = 2;               // Random links per node on top of the ring
+        double latencySeconds = 0.02;        // One way, per link
+        double bandwidthBytesPerSecond = 0;  // Per directed link, 0 for unlimited
+        int difficultyBits = 4;              // The chain's own target; the hash rarely gives more zeros
+        double hashesPerSecond = 200;        // Per node, 0 for as fast as the host allows
+        size_t maxTransactionsPerBlock = 100;
+        size_t targetHeight = 40;
+        double maxSeconds = 60;
+        uint64_t seed = 1;
+    };
+
+    struct Result {
+        size_t nodes = 0;
+        double seconds = 0;            // Until mining stopped
+        size_t blocksMined = 0;
+        uint64_t hashes = 0;
+        size_t mainChainBlocks = 0;    // Longest chain at the end, without genesis
+        double staleRate = 0;          // Mined blocks that ended up off the main chain
+        size_t orphansReceived = 0;    // Blocks that arrived before their parent
+        size_t reorgs = 0;
+        size_t maxReorgDepth = 0;
+        size_t propagated = 0;         // Blocks that reached every node
+        double propagationMean = 0;    // Seconds from being mined until the last node had it
+        double propagationP90 = 0;
+        double propagationMax = 0;
+        size_t transactionsConfirmed = 0;
+        double transactionsPerSecond = 0;
+        double blocksPerSecond = 0;
+        uint64_t bytesSent = 0;
+        bool converged = false;        // All nodes on the same tip at the end
+    };
+
+    NetworkSimulator(const Config& config, const std::vector<User>& users, const std::vector<Transaction>& transactions);
+
+    Result run();
+
+private:
+    Config config;
+    std::vector<User> users;
+    std::vector<Transaction> transactions;
+};
+
+#endif // NETWORKSIMULATOR_H
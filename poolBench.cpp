@@ -0,0 +1,388 @@
+// poolBench.cpp
+// Runs a local mining pool with growing numbers of worker processes. The pool first holds
+// one template that cannot be solved, so its steady hash rate can be set against the same
+// processes hashing on their own, then mines real templates, which shows the cost of
+// switching jobs. Also runs a single pool worker (--worker), e.g. inside a container, or a
+// coordinator for such workers (--coordinator).
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include <filesystem>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
+#include "miningPool.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+const size_t USERS = 60;
+const size_t TRANSACTIONS_PER_BLOCK = 100;
+const double CONNECT_SECONDS = 10;
+const int UNSOLVABLE_DIFFICULTY = 16;  // 64 leading zero bits
+
+struct Run {
+    size_t workers = 0;
+    size_t blocks = 0;
+    bool ok = false;
+    double soloHashRate = 0;       // The same number of processes hashing without a pool
+    double steadySeconds = 0;
+    double steadyHashRate = 0;
+    double blockSeconds = 0;
+    PoolCoordinator::Stats steady; // Each phase on its own
+    PoolCoordinator::Stats mining;
+};
+
+void usage() {
+    std::cout << "Usage: mining_pool [--workers 1,2,4] [--blocks 50] [--share-bits 3] [--slice-bits 20]"
+                 " [--seconds 2] [--seed 1] [--json out.json]\n"
+                 "       mining_pool --coordinator SOCKET [--workers 1] [--blocks 50] [--share-bits 3]"
+                 " [--slice-bits 20] [--seconds 2] [--seed 1]\n"
+                 "       mining_pool --worker SOCKET [--name NAME]\n"
+                 "       mining_pool --solo SECONDS --result FILE\n";
+}
+
+std::vector<size_t> parseList(const std::string& text) {
+    std::vector<size_t> values;
+    std::stringstream in(text);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        size_t value = std::strtoull(item.c_str(), nullptr, 10);
+        if (value > 0) {
+            values.push_back(value);
+        }
+    }
+    return values;
+}
+
+// Linked templates of generated transactions at the usual difficulty
+std::vector<Block> makeTemplates(size_t count, uint64_t seed) {
+    WorkloadGenerator generator(seed);
+    std::vector<User> users = generator.generateUsers(USERS);
+    std::vector<Transaction> transactions;
+    generator.generateTransactions(users, count * TRANSACTIONS_PER_BLOCK, [&](std::vector<Transaction>& chunk) {
+        transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+    });
+    std::vector<Block> templates;
+    for (size_t i = 0; i < count; ++i) {
+        templates.emplace_back(Digest(), std::vector<Transaction>(), 1);
+        for (size_t t = i * TRANSACTIONS_PER_BLOCK; t < (i + 1) * TRANSACTIONS_PER_BLOCK && t < transactions.size(); ++t) {
+            templates.back().addTransaction(transactions[t]);
+        }
+    }
+    return templates;
+}
+
+// Mines the templates in order on the pool; false if any block came back without a valid proof of work
+bool mineTemplates(PoolCoordinator& pool, std::vector<Block>& templates, double& seconds) {
+    auto start = std::chrono::steady_clock::now();
+    Digest previous;
+    for (Block& block : templates) {
+        block.setPreviousHash(previous);
+        if (!pool.mine(block) || !block.meetsDifficulty(block.calculateBlockHash())) {
+            return false;
+        }
+        previous = block.getBlockID();
+    }
+    seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return true;
+}
+
+double hashes(const PoolCoordinator::Stats& stats) {
+    double total = 0;
+    for (const auto& worker : stats.workers) {
+        total += worker.hashes;
+    }
+    return total;
+}
+
+// What the pool did between two snapshots; the maximum switch time stays the one since start
+PoolCoordinator::Stats difference(const PoolCoordinator::Stats& before, const PoolCoordinator::Stats& after) {
+    PoolCoordinator::Stats result = after;
+    for (size_t i = 0; i < before.workers.size() && i < after.workers.size(); ++i) {
+        const PoolCoordinator::WorkerStats& b = before.workers[i];
+        PoolCoordinator::WorkerStats& w = result.workers[i];
+        w.seconds -= b.seconds;
+        w.hashes -= b.hashes;
+        w.shares -= b.shares;
+        w.staleShares -= b.staleShares;
+        w.invalidShares -= b.invalidShares;
+        w.blocks -= b.blocks;
+        double switchSeconds = w.switchSecondsMean * w.jobSwitches - b.switchSecondsMean * b.jobSwitches;
+        w.jobSwitches -= b.jobSwitches;
+        w.switchSecondsMean = w.jobSwitches > 0 ? switchSeconds / w.jobSwitches : 0;
+    }
+    result.jobs -= before.jobs;
+    result.messages -= before.messages;
+    result.seconds -= before.seconds;
+    result.loopCpuSeconds -= before.loopCpuSeconds;
+    return result;
+}
+
+// Holds an unsolvable template on the pool for `seconds`, then sends the workers idle
+PoolCoordinator::Stats holdSteady(PoolCoordinator& pool, double seconds, double& elapsed) {
+    Block unsolvable(Digest(), std::vector<Transaction>(), UNSOLVABLE_DIFFICULTY);
+    PoolCoordinator::Stats before = pool.stats();
+    auto start = std::chrono::steady_clock::now();
+    std::thread miner([&] { pool.mine(unsolvable); });
+    std::this_thread::sleep_for(std::chrono::duration<double>(seconds));
+    pool.cancel();
+    miner.join();
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    // Workers report what they hashed since their last progress line as they go idle
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return difference(before, pool.stats());
+}
+
+void printWorkers(const PoolCoordinator::Stats& steady, double steadySeconds, const PoolCoordinator::Stats& mining) {
+    std::cout << "    " << std::setw(10) << "worker" << std::setw(12) << "H/s" << std::setw(10) << "shares/s"
+              << std::setw(14) << "shares/1k H" << std::setw(8) << "blocks" << std::setw(7) << "stale"
+              << std::setw(9) << "invalid" << std::setw(15) << "switch ms avg" << std::setw(8) << "max" << "\n";
+    for (size_t i = 0; i < steady.workers.size() && i < mining.workers.size(); ++i) {
+        const PoolCoordinator::WorkerStats& s = steady.workers[i];
+        const PoolCoordinator::WorkerStats& m = mining.workers[i];
+        std::cout << "    " << std::fixed << std::setw(10) << s.name << std::setprecision(0) << std::setw(12)
+                  << s.hashes / steadySeconds << std::setprecision(1) << std::setw(10) << s.shares / steadySeconds
+                  << std::setprecision(2) << std::setw(14) << (s.hashes > 0 ? 1000.0 * s.shares / s.hashes : 0)
+                  << std::setw(8) << m.blocks << std::setw(7) << m.staleShares << std::setw(9)
+                  << s.invalidShares + m.invalidShares << std::setprecision(3) << std::setw(15)
+                  << m.switchSecondsMean * 1000 << std::setw(8) << m.switchSecondsMax * 1000 << "\n";
+    }
+}
+
+void writeStats(std::ostream& out, const PoolCoordinator::Stats& stats) {
+    out << "{\"seconds\": " << stats.seconds << ", \"jobs\": " << stats.jobs << ", \"messages\": " << stats.messages
+        << ", \"coordinator_cpu_seconds\": " << stats.loopCpuSeconds << ", \"workers\": [";
+    for (size_t w = 0; w < stats.workers.size(); ++w) {
+        const PoolCoordinator::WorkerStats& ws = stats.workers[w];
+        out << (w > 0 ? ", " : "") << "{\"name\": \"" << ws.name << "\", \"hashes\": " << ws.hashes
+            << ", \"shares\": " << ws.shares << ", \"stale_shares\": " << ws.staleShares
+            << ", \"invalid_shares\": " << ws.invalidShares << ", \"blocks\": " << ws.blocks
+            << ", \"job_switches\": " << ws.jobSwitches << ", \"switch_seconds_mean\": " << ws.switchSecondsMean
+            << ", \"switch_seconds_max\": " << ws.switchSecondsMax << "}";
+    }
+    out << "]}";
+}
+
+bool writeJson(const std::string& path, const PoolCoordinator::Config& config, const std::vector<Run>& runs) {
+    std::ofstream out(path);
+    out << std::setprecision(9);
+    out << "{\n  \"share_bits\": " << config.shareBits << ",\n  \"slice_nonces\": " << config.sliceNonces
+        << ",\n  \"runs\": [\n";
+    for (size_t i = 0; i < runs.size(); ++i) {
+        const Run& run = runs[i];
+        out << "    {\"workers\": " << run.workers << ", \"blocks\": " << run.blocks << ", \"ok\": "
+            << (run.ok ? "true" : "false") << ", \"solo_hashes_per_second\": " << run.soloHashRate
+            << ", \"steady_hashes_per_second\": " << run.steadyHashRate << ", \"block_seconds\": "
+            << run.blockSeconds << ",\n     \"steady\": ";
+        writeStats(out, run.steady);
+        out << ",\n     \"mining\": ";
+        writeStats(out, run.mining);
+        out << "}" << (i + 1 < runs.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+    return static_cast<bool>(out);
+}
+
+// Aggregate hash rate of `count` processes hashing alone at the same time
+double soloBaseline(const fs::path& work, size_t count, double seconds) {
+    std::vector<pid_t> pids;
+    std::string resultPattern = (work / "solo{}.txt").string();
+    bool spawned = PoolCoordinator::spawnWorkers("/proc/self/exe", {"--solo", std::to_string(seconds), "--result",
+                                                                    resultPattern}, count, pids);
+    PoolCoordinator::reapWorkers(pids);
+    double total = 0;
+    for (size_t i = 0; spawned && i < count; ++i) {
+        double rate = 0;
+        std::ifstream in((work / ("solo" + std::to_string(i) + ".txt")).string());
+        in >> rate;
+        total += rate;
+    }
+    return total;
+}
+
+// The steady phase, then the templates, on a pool whose workers are connected
+Run measure(PoolCoordinator& pool, size_t workers, double seconds, size_t blocks, uint64_t seed) {
+    Run run;
+    run.workers = workers;
+    run.steady = holdSteady(pool, seconds, run.steadySeconds);
+    run.steadyHashRate = hashes(run.steady) / run.steadySeconds;
+    std::vector<Block> templates = makeTemplates(blocks, seed);
+    run.blocks = templates.size();
+    PoolCoordinator::Stats before = pool.stats();
+    run.ok = mineTemplates(pool, templates, run.blockSeconds);
+    run.mining = difference(before, pool.stats());
+    return run;
+}
+
+void printHeading() {
+    std::cout << std::setw(8) << "workers" << std::setw(12) << "solo H/s" << std::setw(12) << "pool H/s"
+              << std::setw(11) << "overhead%" << std::setw(10) << "shares/s" << std::setw(10) << "msgs/s"
+              << std::setw(12) << "coord CPU%" << std::setw(10) << "blocks/s" << std::setw(7) << "stale"
+              << std::setw(9) << "invalid" << std::setw(11) << "switch ms" << std::setw(12) << "coord CPU%"
+              << std::setw(5) << "ok" << "\n";
+}
+
+void printRun(const Run& run) {
+    const PoolCoordinator::Stats& s = run.steady;
+    const PoolCoordinator::Stats& m = run.mining;
+    uint64_t shares = 0, stale = 0, invalid = 0;
+    double switchSeconds = 0;
+    size_t switches = 0;
+    for (const auto& w : s.workers) {
+        shares += w.shares;
+        invalid += w.invalidShares;
+    }
+    for (const auto& w : m.workers) {
+        stale += w.staleShares;
+        invalid += w.invalidShares;
+        switchSeconds += w.switchSecondsMean * w.jobSwitches;
+        switches += w.jobSwitches;
+    }
+    std::cout << std::fixed << std::setprecision(0) << std::setw(8) << run.workers << std::setw(12);
+    if (run.soloHashRate > 0) {
+        std::cout << run.soloHashRate << std::setw(12) << run.steadyHashRate << std::setprecision(1) << std::setw(11)
+                  << 100 * (1 - run.steadyHashRate / run.soloHashRate);
+    } else {
+        std::cout << "-" << std::setw(12) << run.steadyHashRate << std::setw(11) << "-";
+    }
+    std::cout << std::setprecision(0) << std::setw(10) << shares / run.steadySeconds << std::setw(10)
+              << s.messages / s.seconds << std::setprecision(2) << std::setw(12) << 100 * s.loopCpuSeconds / s.seconds
+              << std::setprecision(1) << std::setw(10) << run.blocks / run.blockSeconds << std::setw(7) << stale
+              << std::setw(9) << invalid << std::setprecision(3) << std::setw(11)
+              << (switches > 0 ? 1000 * switchSeconds / switches : 0) << std::setprecision(2) << std::setw(12)
+              << 100 * m.loopCpuSeconds / m.seconds << std::setw(5) << (run.ok ? "yes" : "NO") << std::endl;
+    printWorkers(s, run.steadySeconds, m);
+}
+
+// Waits for `workers` external workers on `socketPath` and measures the pool they make up
+int coordinate(const std::string& socketPath, const PoolCoordinator::Config& config, size_t workers, double seconds,
+               size_t blocks, uint64_t seed) {
+    PoolCoordinator pool(config);
+    if (!pool.listen(socketPath) || !pool.start()) {
+        std::cout << "Could not listen on " << socketPath << "\n";
+        return 1;
+    }
+    std::cout << "Waiting for " << workers << " workers on " << socketPath << std::endl;
+    while (!pool.waitForWorkers(workers, 1.0)) {
+    }
+    printHeading();
+    Run run = measure(pool, workers, seconds, blocks, seed);
+    pool.stop();
+    printRun(run);
+    return run.ok ? 0 : 1;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    PoolCoordinator::Config config;
+    std::vector<size_t> workerCounts = {1, 2, 4};
+    size_t blocks = 50;
+    double soloSeconds = 2;
+    uint64_t seed = 1;
+    std::string jsonPath, workerPath, coordinatorPath, resultPath, name = "worker-" + std::to_string(::getpid());
+    double solo = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--workers" && i + 1 < argc) {
+            workerCounts = parseList(argv[++i]);
+        } else if (arg == "--blocks" && i + 1 < argc) {
+            blocks = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--share-bits" && i + 1 < argc) {
+            config.shareBits = std::atoi(argv[++i]);
+        } else if (arg == "--slice-bits" && i + 1 < argc) {
+            config.sliceNonces = 1ULL << std::min(63, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            soloSeconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = std::strtoull(argv[++i], nullptr, 10);
+        } else if (arg == "--json" && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if (arg == "--worker" && i + 1 < argc) {
+            workerPath = argv[++i];
+        } else if (arg == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (arg == "--coordinator" && i + 1 < argc) {
+            coordinatorPath = argv[++i];
+        } else if (arg == "--solo" && i + 1 < argc) {
+            solo = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--result" && i + 1 < argc) {
+            resultPath = argv[++i];
+        } else {
+            usage();
+            return 2;
+        }
+    }
+    if (!workerPath.empty()) {
+        if (!PoolWorker(name).run(workerPath)) {
+            std::cout << "Could not connect to " << workerPath << "\n";
+            return 1;
+        }
+        return 0;
+    }
+    if (solo > 0) {
+        double rate = PoolWorker::soloHashRate(solo);
+        if (resultPath.empty()) {
+            std::cout << std::fixed << std::setprecision(0) << rate << " H/s\n";
+            return 0;
+        }
+        std::ofstream out(resultPath);
+        out << std::setprecision(9) << rate << "\n";
+        return out ? 0 : 1;
+    }
+    if (workerCounts.empty() || blocks == 0) {
+        usage();
+        return 2;
+    }
+    if (!coordinatorPath.empty()) {
+        return coordinate(coordinatorPath, config, workerCounts.front(), soloSeconds, blocks, seed);
+    }
+
+    fs::path work = fs::temp_directory_path() / ("mining_pool." + std::to_string(::getpid()));
+    std::error_code error;
+    fs::create_directories(work, error);
+    std::string socketPath = (work / "pool.sock").string();
+
+    std::cout << "Mining pool: " << soloSeconds << " s on an unsolvable template, then " << blocks
+              << " blocks; share target " << config.shareBits << " bits, " << config.sliceNonces
+              << " nonces per slice\n";
+    printHeading();
+
+    std::vector<Run> runs;
+    bool allOk = true;
+    for (size_t workers : workerCounts) {
+        double soloHashRate = soloBaseline(work, workers, soloSeconds);
+        PoolCoordinator pool(config);
+        std::vector<pid_t> pids;
+        if (!pool.listen(socketPath) || !pool.start() ||
+            !PoolCoordinator::spawnWorkers("/proc/self/exe", {"--worker", socketPath, "--name", "w{}"}, workers, pids) ||
+            !pool.waitForWorkers(workers, CONNECT_SECONDS)) {
+            std::cout << "Could not start a pool of " << workers << " workers\n";
+            pool.stop();
+            PoolCoordinator::reapWorkers(pids);
+            fs::remove_all(work, error);
+            return 1;
+        }
+        Run run = measure(pool, workers, soloSeconds, blocks, seed);
+        run.soloHashRate = soloHashRate;
+        pool.stop(); // Closes the connections, which ends the workers
+        PoolCoordinator::reapWorkers(pids);
+        allOk = allOk && run.ok;
+        printRun(run);
+        runs.push_back(run);
+    }
+    fs::remove_all(work, error);
+    if (!jsonPath.empty() && !writeJson(jsonPath, config, runs)) {
+        std::cout << "Could not write " << jsonPath << "\n";
+        return 1;
+    }
+    return allOk ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+// queryLoadTest.cpp
+// Closed-loop load generator for the query server: every connection keeps `depth`
+// requests in flight and times each one from send to its response line.
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string socketPath = "blockchain.sock";
+    int port = 0;
+    int connections = 4;
+    int depth = 1;
+    double seconds = 5;
+    int users = 60;
+};
+
+// Blocking line-oriented client connection
+class Client {
+public:
+    ~Client() {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+
+    bool connect(const Options& options) {
+        if (options.port > 0) {
+            sockaddr_in address;
+            std::memset(&address, 0, sizeof(address));
+            address.sin_family = AF_INET;
+            address.sin_port = htons(static_cast<uint16_t>(options.port));
+            address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+            fd = ::socket(AF_INET, SOCK_STREAM, 0);
+            return fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+        }
+        sockaddr_un address;
+        std::memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        std::strncpy(address.sun_path, options.socketPath.c_str(), sizeof(address.sun_path) - 1);
+        fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        return fd >= 0 && ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    bool send(const std::string& request) {
+        size_t sent = 0;
+        while (sent < request.size()) {
+            ssize_t n = ::send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            sent += static_cast<size_t>(n);
+        }
+        return true;
+    }
+
+    bool readLine(std::string& line) {
+        while (true) {
+            size_t newline = buffer.find('\n', consumed);
+            if (newline != std::string::npos) {
+                line.assign(buffer, consumed, newline - consumed);
+                consumed = newline + 1;
+                if (consumed == buffer.size()) {
+                    buffer.clear();
+                    consumed = 0;
+                }
+                return true;
+            }
+            char chunk[16384];
+            ssize_t n = ::recv(fd, chunk, sizeof(chunk), 0);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            buffer.append(chunk, static_cast<size_t>(n));
+        }
+    }
+
+    bool query(const std::string& request, std::string& response) {
+        return send(request + "\n") && readLine(response);
+    }
+
+private:
+    int fd = -1;
+    std::string buffer;
+    size_t consumed = 0;
+};
+
+std::string field(const std::string& response, const std::string& name) {
+    size_t at = response.find(" " + name + "=");
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += name.size() + 2;
+    return response.substr(at, response.find(' ', at) - at);
+}
+
+// Known block IDs, transaction IDs, user names and keys from the chain being served
+struct Corpus {
+    std::vector<std::string> blocks;
+    std::vector<std::string> transactions;
+    std::vector<std::string> keys;
+    std::vector<std::string> users;
+};
+
+bool sample(const Options& options, Corpus& corpus) {
+    Client client;
+    std::string response;
+    if (!client.connect(options) || !client.query("HEIGHT", response)) {
+        return false;
+    }
+    uint64_t height = std::strtoull(field(response, "height").c_str(), nullptr, 10);
+    std::mt19937_64 random(12345);
+    for (int i = 0; i < 256 && height > 0; ++i) {
+        uint64_t h = random() % height;
+        if (!client.query("BLOCKAT " + std::to_string(h), response) || response.compare(0, 2, "OK") != 0) {
+            continue;
+        }
+        corpus.blocks.push_back(field(response, "id"));
+        uint64_t count = std::strtoull(field(response, "transactions").c_str(), nullptr, 10);
+        if (count > 0 && client.query("TXAT " + std::to_string(h) + " " + std::to_string(random() % count), response) &&
+            response.compare(0, 2, "OK") == 0) {
+            corpus.transactions.push_back(field(response, "id"));
+            corpus.keys.push_back(field(response, "sender"));
+        }
+    }
+    for (int user = 1; user <= options.users; ++user) {
+        corpus.users.push_back("User" + std::to_string(user));
+    }
+    return !corpus.blocks.empty();
+}
+
+std::string nextRequest(const Corpus& corpus, std::mt19937_64& random) {
+    // 30% transactions, 30% blocks, 20% users, 20% balances
+    unsigned kind = random() % 10;
+    if (kind < 3 && !corpus.transactions.empty()) {
+        return "TX " + corpus.transactions[random() % corpus.transactions.size()] + "\n";
+    } else if (kind < 6 || corpus.keys.empty()) {
+        return "BLOCK " + corpus.blocks[random() % corpus.blocks.size()] + "\n";
+    } else if (kind < 8) {
+        return "USER " + corpus.users[random() % corpus.users.size()] + "\n";
+    }
+    return "BALANCE " + corpus.keys[random() % corpus.keys.size()] + "\n";
+}
+
+struct WorkerResult {
+    std::vector<double> latencies; // Seconds
+    uint64_t notFound = 0;
+    uint64_t errors = 0;
+    bool failed = false;
+};
+
+void runWorker(const Options& options, const Corpus& corpus, int id, Clock::time_point end, WorkerResult& result) {
+    Client client;
+    if (!client.connect(options)) {
+        result.failed = true;
+        return;
+    }
+    std::mt19937_64 random(1000 + id);
+    std::vector<Clock::time_point> sent; // Send times of the requests in flight, oldest first
+    size_t oldest = 0;
+    std::string response;
+    auto issue = [&] {
+        sent.push_back(Clock::now());
+        return client.send(nextRequest(corpus, random));
+    };
+    for (int i = 0; i < options.depth; ++i) {
+        if (!issue()) {
+            result.failed = true;
+            return;
+        }
+    }
+    while (oldest < sent.size()) {
+        if (!client.readLine(response)) {
+            result.failed = true;
+            return;
+        }
+        Clock::time_point now = Clock::now();
+        result.latencies.push_back(std::chrono::duration<double>(now - sent[oldest++]).count());
+        if (response == "NOTFOUND") {
+            result.notFound++;
+        } else if (response.compare(0, 2, "OK") != 0) {
+            result.errors++;
+        }
+        if (now < end && !issue()) {
+            result.failed = true;
+            return;
+        }
+    }
+}
+
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+void printUsage() {
+    std::cout << "Usage: query_loadtest [--socket blockchain.sock | --port N] [--connections 4] [--depth 1]"
+                 " [--seconds 5] [--users 60]\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--socket" && i + 1 < argc) {
+            options.socketPath = argv[++i];
+        } else if (arg == "--port" && i + 1 < argc) {
+            options.port = std::atoi(argv[++i]);
+        } else if (arg == "--connections" && i + 1 < argc) {
+            options.connections = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--depth" && i + 1 < argc) {
+            options.depth = std::max(1, std::atoi(argv[++i]));
+        } else if (arg == "--seconds" && i + 1 < argc) {
+            options.seconds = std::strtod(argv[++i], nullptr);
+        } else if (arg == "--users" && i + 1 < argc) {
+            options.users = std::max(1, std::atoi(argv[++i]));
+        } else {
+            printUsage();
+            return 2;
+        }
+    }
+
+    Corpus corpus;
+    if (!sample(options, corpus)) {
+        std::cout << "Could not reach the query server or the chain is empty\n";
+        return 1;
+    }
+    std::cout << "Sampled " << corpus.blocks.size() << " blocks, " << corpus.transactions.size()
+              << " transactions; " << options.connections << " connections x " << options.depth
+              << " in flight for " << options.seconds << " s" << std::endl;
+
+    std::vector<WorkerResult> results(options.connections);
+    std::vector<std::thread> workers;
+    Clock::time_point start = Clock::now();
+    Clock::time_point end = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+    for (int i = 0; i < options.connections; ++i) {
+        workers.emplace_back(runWorker, std::cref(options), std::cref(corpus), i, end, std::ref(results[i]));
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    uint64_t notFound = 0, errors = 0;
+    int failed = 0;
+    for (const auto& result : results) {
+        latencies.insert(latencies.end(), result.latencies.begin(), result.latencies.end());
+        notFound += result.notFound;
+        errors += result.errors;
+        failed += result.failed;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "Requests: " << latencies.size() << " in " << elapsed << " s = " << latencies.size() / elapsed << " qps\n";
+    std::cout << "Latency (us): p50 " << percentile(latencies, 0.50) * 1e6 << ", p90 " << percentile(latencies, 0.90) * 1e6
+              << ", p99 " << percentile(latencies, 0.99) * 1e6 << ", p99.9 " << percentile(latencies, 0.999) * 1e6
+              << ", max " << (latencies.empty() ? 0 : latencies.back() * 1e6) << "\n";
+    std::cout << "Not found: " << notFound << ", errors: " << errors << ", failed connections: " << failed << "\n";
+    return failed > 0 || errors > 0 ? 1 : 0;
+}
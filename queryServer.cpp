@@ -0,0 +1,447 @@
+#include "queryServer.h"
+#include "metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <unordered_map>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+
+const size_t MAX_REQUEST_BYTES = 4096;        // A longer line without a newline closes the connection
+const size_t MAX_PENDING_OUTPUT = 1 << 20;    // Stop reading a client that does not read its responses
+const int MAX_EVENTS = 64;
+
+struct Connection {
+    std::string input;
+    std::string output;
+    size_t written = 0;   // Bytes of output already sent
+    uint32_t events = 0;  // Currently registered epoll interest
+    bool closing = false; // Peer finished sending; close once the output is flushed
+};
+
+void appendHex(std::string& out, const Digest& digest) {
+    char hex[Digest::HEX_LENGTH];
+    digest.writeHex(hex);
+    out.append(hex, sizeof(hex));
+}
+
+bool parseNumber(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.size() > 19 || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    value = std::stoull(text);
+    return true;
+}
+
+void appendBlock(std::string& out, const BlockView& block, size_t height) {
+    const StoredBlockHeader& header = block.header();
+    out += "OK block height=" + std::to_string(height) + " id=";
+    appendHex(out, header.blockID);
+    out += " previous=";
+    appendHex(out, header.previousHash);
+    out += " merkle=";
+    appendHex(out, header.merkleRoot);
+    out += " timestamp=" + std::to_string(header.timestamp) + " nonce=" + std::to_string(header.nonce) +
+           " extra_nonce=" + std::to_string(header.extraNonce) +
+           " transactions=" + std::to_string(header.transactionCount) + "\n";
+}
+
+void appendTransaction(std::string& out, const BlockView& block, const ChainIndex::TransactionLocation& ref) {
+    const StoredTransaction& tx = block.transaction(ref.position);
+    out += "OK tx id=";
+    appendHex(out, tx.transactionID);
+    out += " sender=";
+    appendHex(out, tx.sender);
+    out += " receiver=";
+    appendHex(out, tx.receiver);
+    out += " amount=" + std::to_string(tx.amount) + " height=" + std::to_string(ref.height) +
+           " position=" + std::to_string(ref.position) + " block=";
+    appendHex(out, block.header().blockID);
+    out += "\n";
+}
+
+// Sends as much pending output as the socket takes; false if the connection failed
+bool flush(int fd, Connection& connection) {
+    while (connection.written < connection.output.size()) {
+        ssize_t sent = ::send(fd, connection.output.data() + connection.written,
+                              connection.output.size() - connection.written, MSG_NOSIGNAL);
+        if (sent > 0) {
+            connection.written += static_cast<size_t>(sent);
+        } else if (sent < 0 && errno == EINTR) {
+            continue;
+        } else if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        } else {
+            return false;
+        }
+    }
+    if (connection.written == connection.output.size()) {
+        connection.output.clear();
+        connection.written = 0;
+    } else if (connection.written >= MAX_PENDING_OUTPUT / 2) {
+        connection.output.erase(0, connection.written);
+        connection.written = 0;
+    }
+    return true;
+}
+
+// Reads everything available; false on a read error
+bool receive(int fd, Connection& connection) {
+    char buffer[16384];
+    while (true) {
+        ssize_t received = ::recv(fd, buffer, sizeof(buffer), 0);
+        if (received > 0) {
+            connection.input.append(buffer, static_cast<size_t>(received));
+            if (connection.input.size() > MAX_PENDING_OUTPUT) {
+                return true; // Enough to work on; the rest is read on the next wakeup
+            }
+        } else if (received == 0) {
+            connection.closing = true;
+            return true;
+        } else if (errno == EINTR) {
+            continue;
+        } else {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+    }
+}
+
+void closeKeepingErrno(int fd) {
+    int saved = errno;
+    ::close(fd);
+    errno = saved;
+}
+
+} // namespace
+
+void QueryServer::appendAnswer(std::string& out, const ChainSnapshot& snapshot, const std::string& request) const {
+    std::vector<std::string> words;
+    size_t position = 0;
+    while (position < request.size()) {
+        size_t begin = request.find_first_not_of(" \t\r", position);
+        if (begin == std::string::npos) {
+            break;
+        }
+        size_t end = std::min(request.find_first_of(" \t\r", begin), request.size());
+        words.push_back(request.substr(begin, end - begin));
+        position = end;
+    }
+    if (words.empty()) {
+        out += "ERROR empty request\n";
+        return;
+    }
+    std::string command = words[0];
+    std::transform(command.begin(), command.end(), command.begin(), ::toupper);
+
+    Digest key;
+    uint64_t height, index;
+    if (command == "HEIGHT" && words.size() == 1) {
+        out += "OK height=" + std::to_string(snapshot.height()) + "\n";
+    } else if (command == "BLOCK" && words.size() == 2) {
+        if (!Digest::parseHex(words[1], key)) {
+            out += "ERROR expected a 64 character hex hash\n";
+            return;
+        }
+        int64_t found = snapshot.findBlock(key);
+        if (found == ChainIndex::NOT_FOUND) {
+            found = snapshot.findBlockByMerkleRoot(key);
+        }
+        if (found == ChainIndex::NOT_FOUND) {
+            out += "NOTFOUND\n";
+            return;
+        }
+        appendBlock(out, snapshot.block(static_cast<size_t>(found)), static_cast<size_t>(found));
+    } else if (command == "BLOCKAT" && words.size() == 2) {
+        if (!parseNumber(words[1], height)) {
+            out += "ERROR expected a block height\n";
+        } else if (height >= snapshot.height()) {
+            out += "NOTFOUND\n";
+        } else {
+            appendBlock(out, snapshot.block(height), height);
+        }
+    } else if (command == "TX" && words.size() == 2) {
+        ChainIndex::TransactionLocation ref;
+        if (!Digest::parseHex(words[1], key)) {
+            out += "ERROR expected a 64 character hex transaction ID\n";
+        } else if (!snapshot.findTransaction(key, ref)) {
+            out += "NOTFOUND\n";
+        } else {
+            appendTransaction(out, snapshot.block(ref.height), ref);
+        }
+    } else if (command == "TXAT" && words.size() == 3) {
+        if (!parseNumber(words[1], height) || !parseNumber(words[2], index)) {
+            out += "ERROR expected a block height and a position\n";
+        } else if (height >= snapshot.height() ||
+                   index >= snapshot.block(height).transactionCount()) {
+            out += "NOTFOUND\n";
+        } else {
+            ChainIndex::TransactionLocation ref = {static_cast<uint32_t>(height), static_cast<uint32_t>(index)};
+            appendTransaction(out, snapshot.block(height), ref);
+        }
+    } else if (command == "USER" && words.size() == 2) {
+        int64_t account = snapshot.accounts().findAccountByName(words[1]);
+        if (account == AccountState::NOT_FOUND) {
+            out += "NOTFOUND\n";
+            return;
+        }
+        out += "OK user name=" + snapshot.accounts().getName(account) + " key=";
+        appendHex(out, snapshot.accounts().getPublicKey(account));
+        out += " balance=" + std::to_string(snapshot.balance(account)) + "\n";
+    } else if ((command == "BALANCE" || command == "HISTORY") && words.size() == 2) {
+        if (!Digest::parseHex(words[1], key)) {
+            out += "ERROR expected a 64 character hex public key\n";
+        } else if (command == "BALANCE") {
+            int64_t account = snapshot.accounts().findAccount(key);
+            if (account == AccountState::NOT_FOUND) {
+                out += "NOTFOUND\n";
+                return;
+            }
+            out += "OK balance key=";
+            appendHex(out, key);
+            out += " balance=" + std::to_string(snapshot.balance(account)) + "\n";
+        } else if (!snapshot.hasAddressIndex()) {
+            out += "ERROR address index unavailable\n";
+        } else {
+            std::vector<AddressIndex::TransactionRef> refs = snapshot.history(key);
+            out += "OK history key=";
+            appendHex(out, key);
+            out += " transactions=" + std::to_string(refs.size()) + " ids=";
+            for (size_t i = 0; i < refs.size(); ++i) {
+                if (i > 0) {
+                    out += ",";
+                }
+                appendHex(out, snapshot.block(refs[i].height).transaction(refs[i].position).transactionID);
+            }
+            out += "\n";
+        }
+    } else {
+        out += "ERROR unknown request\n";
+    }
+}
+
+QueryServer::QueryServer(const ChainPublisher& chain, int threadCount)
+    : chain(chain),
+      threadCount(threadCount > 0 ? threadCount : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))),
+      wakeFd(-1) {}
+
+QueryServer::~QueryServer() {
+    stop();
+    for (int fd : listeners) {
+        ::close(fd);
+    }
+    if (!unixPath.empty()) {
+        ::unlink(unixPath.c_str());
+    }
+}
+
+bool QueryServer::listenUnix(const std::string& path) {
+    sockaddr_un address;
+    std::memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    ::unlink(path.c_str()); // Left behind by a run that did not shut down cleanly
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        closeKeepingErrno(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    unixPath = path;
+    return true;
+}
+
+bool QueryServer::listenTcp(uint16_t port) {
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+    int reuse = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || ::listen(fd, SOMAXCONN) < 0) {
+        closeKeepingErrno(fd);
+        return false;
+    }
+    listeners.push_back(fd);
+    return true;
+}
+
+bool QueryServer::start() {
+    if (listeners.empty() || !workers.empty()) {
+        return false;
+    }
+    wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd < 0) {
+        return false;
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        workers.emplace_back([this] { serve(); });
+    }
+    return true;
+}
+
+void QueryServer::stop() {
+    if (workers.empty()) {
+        return;
+    }
+    // Never read, so the eventfd stays readable and wakes every worker
+    uint64_t one = 1;
+    ssize_t ignored = ::write(wakeFd, &one, sizeof(one));
+    (void)ignored;
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    workers.clear();
+    ::close(wakeFd);
+    wakeFd = -1;
+}
+
+std::string QueryServer::answer(const ChainSnapshot& snapshot, const std::string& request) const {
+    std::string out;
+    appendAnswer(out, snapshot, request);
+    return out;
+}
+
+void QueryServer::serve() {
+    static Metrics::Counter& served = Metrics::instance().counter("queries_total", "Requests answered by the query server");
+    static Metrics::Gauge& open = Metrics::instance().gauge("query_connections", "Open query server connections");
+    static Metrics::Histogram& latency = Metrics::instance().histogram(
+        "query_seconds", "Time to answer one request from a chain snapshot",
+        {0.000001, 0.0000025, 0.000005, 0.00001, 0.000025, 0.00005, 0.0001, 0.00025, 0.0005, 0.001, 0.01, 0.1});
+
+    int epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll < 0) {
+        return;
+    }
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = wakeFd;
+    ::epoll_ctl(epoll, EPOLL_CTL_ADD, wakeFd, &event);
+    for (int fd : listeners) {
+        event.events = EPOLLIN | EPOLLEXCLUSIVE;
+        event.data.fd = fd;
+        ::epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+    }
+
+    std::unordered_map<int, Connection> connections;
+    auto closeConnection = [&](int fd) {
+        ::close(fd);
+        connections.erase(fd);
+        open.add(-1);
+    };
+
+    epoll_event events[MAX_EVENTS];
+    bool running = true;
+    while (running) {
+        int ready = ::epoll_wait(epoll, events, MAX_EVENTS, -1);
+        if (ready < 0 && errno == EINTR) {
+            continue;
+        } else if (ready < 0) {
+            break;
+        }
+        std::shared_ptr<const ChainSnapshot> snapshot; // One snapshot for everything answered in this wakeup
+        for (int i = 0; i < ready; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakeFd) {
+                running = false;
+                break;
+            }
+            if (std::find(listeners.begin(), listeners.end(), fd) != listeners.end()) {
+                int client;
+                while ((client = ::accept4(fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+                    Connection& connection = connections[client];
+                    connection.events = EPOLLIN;
+                    event.events = connection.events;
+                    event.data.fd = client;
+                    ::epoll_ctl(epoll, EPOLL_CTL_ADD, client, &event);
+                    open.add(1);
+                }
+                continue;
+            }
+
+            auto found = connections.find(fd);
+            if (found == connections.end()) {
+                continue;
+            }
+            Connection& connection = found->second;
+            bool healthy = true;
+            if ((events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection.closing) {
+                healthy = receive(fd, connection);
+            }
+
+            // Answer until the input holds no complete line or the output is full and the
+            // socket takes no more of it; a flush that makes room lets answering go on
+            bool lineLeft;
+            do {
+                size_t start = 0, newline;
+                while (healthy && connection.output.size() - connection.written < MAX_PENDING_OUTPUT &&
+                       (newline = connection.input.find('\n', start)) != std::string::npos) {
+                    if (!snapshot) {
+                        snapshot = chain.current();
+                    }
+                    auto begin = std::chrono::steady_clock::now();
+                    appendAnswer(connection.output, *snapshot, connection.input.substr(start, newline - start));
+                    latency.observe(std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count());
+                    served.add();
+                    start = newline + 1;
+                }
+                connection.input.erase(0, start);
+                lineLeft = connection.input.find('\n') != std::string::npos;
+                if (connection.input.size() > MAX_REQUEST_BYTES && !lineLeft) {
+                    connection.output += "ERROR request too long\n";
+                    connection.input.clear();
+                    connection.closing = true;
+                }
+                healthy = healthy && flush(fd, connection);
+            } while (healthy && lineLeft && connection.output.size() - connection.written < MAX_PENDING_OUTPUT);
+
+            // A half-closed connection stays open until every request it sent is answered
+            size_t pending = connection.output.size() - connection.written;
+            if (!healthy || (connection.closing && pending == 0 && !lineLeft)) {
+                closeConnection(fd);
+                continue;
+            }
+            uint32_t wanted = 0;
+            if (pending > 0) {
+                wanted |= EPOLLOUT;
+            }
+            if (!connection.closing && pending < MAX_PENDING_OUTPUT) {
+                wanted |= EPOLLIN;
+            }
+            if (wanted != connection.events) {
+                connection.events = wanted;
+                event.events = wanted;
+                event.data.fd = fd;
+                ::epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+            }
+        }
+    }
+
+    for (const auto& entry : connections) {
+        ::close(entry.first);
+    }
+    open.add(-static_cast<int64_t>(connections.size()));
+    ::close(epoll);
+}
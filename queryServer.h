@@ -0,0 +1,64 @@
+#ifndef QUERYSERVER_H
+#define QUERYSERVER_H
+
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include "chainSnapshot.h"
+
+// Line-based query service over a Unix domain socket and/or a loopback TCP port.
+//
+// Each request is one line and gets exactly one response line, in order, so clients may
+// pipeline. Hashes and keys are 64 hex characters:
+//
+//   HEIGHT                      OK height=<blocks>
+//   BLOCK <id or merkle root>   OK block height=.. id=.. previous=.. merkle=.. timestamp=.. nonce=.. extra_nonce=.. transactions=..
+//   BLOCKAT <height>            same as BLOCK
+//   TX <transaction id>         OK tx id=.. sender=.. receiver=.. amount=.. height=.. position=.. block=..
+//   TXAT <height> <position>    same as TX
+//   USER <name>                 OK user name=.. key=.. balance=..
+//   BALANCE <public key>        OK balance key=.. balance=..
+//   HISTORY <public key>        OK history key=.. transactions=<n> ids=<id>,<id>,...
+//
+// Anything that does not resolve gets "NOTFOUND", malformed requests "ERROR <reason>".
+// BLOCK and TX are looked up in the snapshot's ChainIndex view, which the publisher
+// always has, and HISTORY in its AddressIndex view; a publisher without an AddressIndex
+// answers HISTORY with "ERROR address index unavailable".
+//
+// Every worker thread runs its own epoll loop over non-blocking sockets; the listening
+// sockets are registered with all of them (EPOLLEXCLUSIVE), so accepted connections are
+// spread over the workers and each connection stays on one. Requests read in one wakeup
+// are answered from the same ChainSnapshot, taken from the publisher without waiting on
+// the miner, together with the index views published with it, so every answer matches
+// that snapshot. Responses are buffered per connection and flushed as the socket allows.
+class QueryServer {
+public:
+    // `chain` must outlive the server
+    explicit QueryServer(const ChainPublisher& chain, int threadCount = 0);
+    ~QueryServer();
+
+    QueryServer(const QueryServer&) = delete;
+    QueryServer& operator=(const QueryServer&) = delete;
+
+    bool listenUnix(const std::string& path); // Replaces a stale socket file at `path`
+    bool listenTcp(uint16_t port);            // 127.0.0.1 only
+    bool start();
+    void stop();
+
+    // Response line (with the trailing newline) for one request line
+    std::string answer(const ChainSnapshot& snapshot, const std::string& request) const;
+
+private:
+    const ChainPublisher& chain;
+    int threadCount;
+    std::vector<int> listeners;
+    std::string unixPath;
+    int wakeFd;
+    std::vector<std::thread> workers;
+
+    void serve();
+    void appendAnswer(std::string& out, const ChainSnapshot& snapshot, const std::string& request) const;
+};
+
+#endif // QUERYSERVER_H
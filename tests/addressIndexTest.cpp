@@ -0,0 +1,208 @@
+// addressIndexTest.cpp
+// Checks AddressIndex histories against a scan of every block. A chain of real
+// (difficulty 1) blocks is indexed in batches of uneven size. With postings disabled,
+// every account's history comes from the Bloom filters alone and must equal the scan, so
+// the filters have no false negatives. The rate at which they let through blocks without
+// a match, over accounts and addresses that are not on the chain, must stay near the
+// configured rate. With postings, busy accounts are promoted while the chain is indexed
+// and their histories must equal the scan too. Both must also hold after the index is
+// reopened from its files. Exits non-zero on any mismatch.
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "addressIndex.h"
+#include "block.h"
+#include "blockStore.h"
+#include "hash.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+const uint64_t SEED = 1313;
+const size_t MAX_REPORTED = 10;
+const size_t USERS = 400;
+const size_t BLOCKS = 300;
+const size_t TRANSACTIONS_PER_BLOCK = 20;
+const size_t ABSENT_ADDRESSES = 200;
+const size_t HOT_THRESHOLD = 32;
+// The observed rate is measured over more than 10^5 filtered blocks, so its noise is
+// far below this allowance
+const double RATE_TOLERANCE = 1.5;
+
+size_t failures = 0;
+
+void fail(const std::string& what) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << "\n";
+    }
+}
+
+// Appends blocks up to `endHeight`, TRANSACTIONS_PER_BLOCK transactions each
+void appendBlocks(BlockStore& store, const std::vector<Transaction>& pool, size_t endHeight) {
+    Digest previous = store.size() > 0 ? store.view(store.size() - 1).header().blockID : Digest();
+    for (size_t height = store.size(); height < endHeight; ++height) {
+        std::vector<Transaction> transactions(pool.begin() + height * TRANSACTIONS_PER_BLOCK,
+                                              pool.begin() + (height + 1) * TRANSACTIONS_PER_BLOCK);
+        Block block(previous, transactions, Block::CHAIN_DIFFICULTY);
+        block.mineBlock(1);
+        if (!store.append(block)) {
+            fail("append of block " + std::to_string(height));
+            return;
+        }
+        previous = block.getBlockID();
+    }
+}
+
+// The history a front-to-back scan of blocks [0, endHeight) finds
+std::vector<AddressIndex::TransactionRef> scanHistory(const BlockStore& store, const Digest& address, size_t endHeight) {
+    std::vector<AddressIndex::TransactionRef> refs;
+    for (size_t height = 0; height < endHeight; ++height) {
+        BlockView block = store.view(height);
+        for (size_t i = 0; i < block.transactionCount(); ++i) {
+            if (block.transaction(i).sender == address || block.transaction(i).receiver == address) {
+                refs.push_back(AddressIndex::TransactionRef{static_cast<uint32_t>(height), static_cast<uint32_t>(i)});
+            }
+        }
+    }
+    return refs;
+}
+
+bool sameHistory(const std::vector<AddressIndex::TransactionRef>& a, const std::vector<AddressIndex::TransactionRef>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].height != b[i].height || a[i].position != b[i].position) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Compares every account's history, in full and clipped, with the scan; returns how many
+// queries were answered from postings
+size_t checkHistories(const AddressIndex& index, const BlockStore& store, const std::vector<User>& users,
+                      const std::string& label) {
+    BlockSource blocks = [&store](size_t height) { return store.view(height); };
+    size_t fromPostings = 0;
+    for (const User& user : users) {
+        for (size_t endHeight : {store.size(), store.size() / 3}) {
+            AddressIndex::QueryStats queryStats;
+            std::vector<AddressIndex::TransactionRef> refs = index.history(user.getPublicKey(), endHeight, blocks,
+                                                                           &queryStats);
+            if (!sameHistory(refs, scanHistory(store, user.getPublicKey(), endHeight))) {
+                fail(label + ": history of " + user.getPublicKey().toHex() + " below " + std::to_string(endHeight));
+            }
+            fromPostings += queryStats.fromPostings;
+        }
+    }
+    return fromPostings;
+}
+
+// Filter-only index at `rate`: no false negatives, and false positives near the rate
+void checkFilters(AddressIndex& index, double rate, const std::string& path, const BlockStore& store,
+                  const std::vector<User>& users) {
+    std::string label = "rate " + std::to_string(rate);
+    if (checkHistories(index, store, users, label) != 0) {
+        fail(label + ": postings used with a threshold of 0");
+    }
+    BlockSource blocks = [&store](size_t height) { return store.view(height); };
+    for (size_t i = 0; i < ABSENT_ADDRESSES; ++i) {
+        if (!index.history(HashUtils::hash("not an account " + std::to_string(i)), store.size(), blocks).empty()) {
+            fail(label + ": history for an address that is not on the chain");
+        }
+    }
+
+    AddressIndex::Stats stats = index.stats();
+    std::cout << label << ": observed false-positive rate " << stats.observedFalsePositiveRate << ", expected "
+              << stats.expectedFalsePositiveRate << "\n";
+    if (stats.observedFalsePositiveRate > rate * RATE_TOLERANCE ||
+        stats.observedFalsePositiveRate > stats.expectedFalsePositiveRate * RATE_TOLERANCE ||
+        stats.observedFalsePositiveRate < stats.expectedFalsePositiveRate / RATE_TOLERANCE) {
+        fail(label + ": observed false-positive rate " + std::to_string(stats.observedFalsePositiveRate));
+    }
+
+    index.close();
+    AddressIndex reopened(rate, 0);
+    if (!reopened.open(path, store) || reopened.blockCount() != store.size()) {
+        fail(label + ": reopen");
+    }
+    checkHistories(reopened, store, users, label + " reopened");
+    reopened.close();
+}
+
+} // namespace
+
+int main() {
+    char directory[] = "/tmp/address_index_test.XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0) {
+        std::cout << "could not create a scratch directory\n";
+        return 1;
+    }
+    std::vector<User> users = WorkloadGenerator(SEED).generateUsers(USERS);
+    std::vector<Transaction> pool;
+    WorkloadGenerator(SEED).generateTransactions(users, BLOCKS * TRANSACTIONS_PER_BLOCK,
+                                                 [&](std::vector<Transaction>& chunk) {
+                                                     pool.insert(pool.end(), chunk.begin(), chunk.end());
+                                                 });
+
+    BlockStore store;
+    store.setSyncWrites(false);
+    if (!store.open("blockchain.dat")) {
+        std::cout << "could not open blockchain.dat\n";
+        return 1;
+    }
+    const double rates[] = {0.01, 0.05};
+    const std::string paths[] = {"addresses.1", "addresses.5", "addresses.hot"};
+    AddressIndex filtered[] = {AddressIndex(rates[0], 0), AddressIndex(rates[1], 0)};
+    AddressIndex hot(0.01, HOT_THRESHOLD);
+    AddressIndex* indexes[] = {&filtered[0], &filtered[1], &hot};
+
+    // Opened over the empty store and caught up in uneven batches, as the miner does, so
+    // accounts are promoted across batches
+    BlockSource blocks = [&store](size_t height) { return store.view(height); };
+    for (size_t i = 0; i < 3; ++i) {
+        indexes[i]->setSyncWrites(false);
+        if (!indexes[i]->open(paths[i], store)) {
+            fail(paths[i] + ": open");
+        }
+    }
+    for (size_t end = 0, batch = 1; end < BLOCKS; batch = batch % 11 + 1) {
+        end = std::min(BLOCKS, end + batch * 2);
+        appendBlocks(store, pool, end);
+        for (size_t i = 0; i < 3; ++i) {
+            if (!indexes[i]->catchUp(blocks, store.size())) {
+                fail(paths[i] + ": catch up to " + std::to_string(store.size()));
+            }
+        }
+    }
+
+    for (size_t i = 0; i < 2; ++i) {
+        checkFilters(filtered[i], rates[i], paths[i], store, users);
+    }
+
+    // Postings: busy accounts are answered exactly, the others still through the filters
+    size_t fromPostings = checkHistories(hot, store, users, "postings");
+    AddressIndex::Stats stats = hot.stats();
+    if (stats.hotAddresses == 0 || fromPostings == 0) {
+        fail("postings: no account was promoted");
+    }
+    if (stats.hotAddresses == users.size()) {
+        fail("postings: every account was promoted");
+    }
+    hot.close();
+    AddressIndex reopened(0.01, HOT_THRESHOLD);
+    if (!reopened.open(paths[2], store) || reopened.blockCount() != store.size()) {
+        fail("postings: reopen");
+    }
+    checkHistories(reopened, store, users, "postings reopened");
+    reopened.close();
+
+    std::cout << store.size() << " blocks, " << users.size() << " accounts, " << stats.hotAddresses
+              << " promoted, " << failures << " mismatches\n";
+    std::system((std::string("rm -rf ") + directory).c_str());
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,205 @@
+// chainIndexTest.cpp
+// Checks ChainIndex lookups against a scan of the store. A chain of real (difficulty 1)
+// blocks, some of them empty so their Merkle roots repeat, is indexed in batches of
+// uneven size, so runs are written and merged. Every block ID, Merkle root and
+// transaction ID must resolve to its first height (and position), and keys that are not
+// on the chain must not resolve. This holds after catching up, after reopening the
+// persisted runs, after a rebuild from the store when the run list is damaged or
+// missing, and for an index kept in memory. Exits non-zero on any mismatch.
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include "block.h"
+#include "blockStore.h"
+#include "chainIndex.h"
+#include "hash.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+const uint64_t SEED = 1212;
+const size_t MAX_REPORTED = 10;
+const size_t BLOCKS = 240;
+const size_t MORE_BLOCKS = 60;
+const size_t TRANSACTIONS_PER_BLOCK = 25;
+const char* const INDEX_PATH = "blockchain.lookup";
+
+size_t failures = 0;
+
+void fail(const std::string& what) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << "\n";
+    }
+}
+
+// Appends `count` mined blocks, every seventh one empty
+void appendBlocks(BlockStore& store, const std::vector<Transaction>& pool, size_t& next, size_t count) {
+    Digest previous = store.size() > 0 ? store.view(store.size() - 1).header().blockID : Digest();
+    for (size_t i = 0; i < count; ++i) {
+        std::vector<Transaction> transactions;
+        if (store.size() % 7 != 3) {
+            for (size_t t = 0; t < TRANSACTIONS_PER_BLOCK; ++t) {
+                transactions.push_back(pool[next++ % pool.size()]);
+            }
+        }
+        Block block(previous, transactions, Block::CHAIN_DIFFICULTY);
+        block.mineBlock(1);
+        if (!store.append(block)) {
+            fail("append of block " + std::to_string(store.size()));
+            return;
+        }
+        previous = block.getBlockID();
+    }
+}
+
+struct Location {
+    uint32_t height;
+    uint32_t position;
+};
+
+// Lookups answer with the first occurrence, as a front-to-back scan would
+void check(const ChainIndex::View& view, const BlockStore& store, size_t endHeight, const std::string& label) {
+    std::unordered_map<Digest, uint32_t, DigestHasher> blocks, roots;
+    std::unordered_map<Digest, Location, DigestHasher> transactions;
+    size_t transactionCount = 0;
+    for (size_t height = 0; height < endHeight; ++height) {
+        BlockView block = store.view(height);
+        uint32_t h = static_cast<uint32_t>(height);
+        blocks.emplace(block.header().blockID, h);
+        roots.emplace(block.header().merkleRoot, h);
+        for (size_t t = 0; t < block.transactionCount(); ++t) {
+            transactions.emplace(block.transaction(t).transactionID, Location{h, static_cast<uint32_t>(t)});
+        }
+        transactionCount += block.transactionCount();
+    }
+
+    if (view.blockCount() != endHeight) {
+        fail(label + ": " + std::to_string(view.blockCount()) + " blocks indexed, expected " +
+             std::to_string(endHeight));
+    }
+    if (view.transactionCount() != transactionCount) {
+        fail(label + ": transaction count");
+    }
+    for (const auto& block : blocks) {
+        if (view.findBlock(block.first) != block.second) {
+            fail(label + ": block " + block.first.toHex());
+        }
+    }
+    for (const auto& root : roots) {
+        if (view.findBlockByMerkleRoot(root.first) != root.second) {
+            fail(label + ": Merkle root " + root.first.toHex());
+        }
+    }
+    for (const auto& transaction : transactions) {
+        ChainIndex::TransactionLocation location;
+        if (!view.findTransaction(transaction.first, location) || location.height != transaction.second.height ||
+            location.position != transaction.second.position) {
+            fail(label + ": transaction " + transaction.first.toHex());
+        }
+    }
+    for (int i = 0; i < 100; ++i) {
+        Digest absent = HashUtils::hash("not on the chain " + std::to_string(i));
+        ChainIndex::TransactionLocation location;
+        if (view.findBlock(absent) != ChainIndex::NOT_FOUND ||
+            view.findBlockByMerkleRoot(absent) != ChainIndex::NOT_FOUND || view.findTransaction(absent, location)) {
+            fail(label + ": absent key " + absent.toHex() + " found");
+        }
+    }
+}
+
+// Opens the persisted index over `store`; `rebuild` says whether it must be regenerated
+void reopen(const BlockStore& store, bool rebuild, const std::string& label) {
+    ChainIndex index;
+    index.setSyncWrites(false);
+    if (!index.open(INDEX_PATH, store)) {
+        fail(label + ": open");
+    }
+    if (index.wasRebuilt() != rebuild) {
+        fail(label + (rebuild ? ": kept a damaged index" : ": rebuilt an intact index"));
+    }
+    check(index.view(), store, store.size(), label);
+    index.close();
+}
+
+} // namespace
+
+int main() {
+    char directory[] = "/tmp/chain_index_test.XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0) {
+        std::cout << "could not create a scratch directory\n";
+        return 1;
+    }
+    std::vector<User> users = WorkloadGenerator(SEED).generateUsers(50);
+    std::vector<Transaction> pool;
+    WorkloadGenerator(SEED).generateTransactions(users, (BLOCKS + MORE_BLOCKS) * TRANSACTIONS_PER_BLOCK,
+                                                 [&](std::vector<Transaction>& chunk) {
+                                                     pool.insert(pool.end(), chunk.begin(), chunk.end());
+                                                 });
+    size_t next = 0;
+
+    BlockStore store;
+    store.setSyncWrites(false);
+    if (!store.open("blockchain.dat")) {
+        std::cout << "could not open blockchain.dat\n";
+        return 1;
+    }
+
+    // Built up in uneven batches, so runs of different sizes are written and merged
+    {
+        ChainIndex index(2);
+        index.setSyncWrites(false);
+        if (!index.open(INDEX_PATH, store)) {
+            fail("open on an empty store");
+        }
+        for (size_t batch = 1; store.size() < BLOCKS; batch = batch % 13 + 1) {
+            appendBlocks(store, pool, next, std::min(batch * 3, BLOCKS - store.size()));
+            ChainIndex::View before = index.view();
+            size_t indexedBefore = before.blockCount();
+            if (!index.catchUp(store)) {
+                fail("catch up to " + std::to_string(store.size()));
+            }
+            // An older view keeps answering for the blocks it was taken at
+            check(before, store, indexedBefore, "view at " + std::to_string(indexedBefore) + " blocks");
+        }
+        check(index.view(), store, store.size(), "after catching up");
+        index.close();
+    }
+
+    reopen(store, false, "after reopening");
+
+    // Blocks stored while the index was closed are indexed by the next open
+    appendBlocks(store, pool, next, MORE_BLOCKS);
+    reopen(store, false, "after reopening behind the store");
+    reopen(store, false, "after a second reopen");
+
+    {
+        std::ofstream damaged(INDEX_PATH, std::ios::binary | std::ios::trunc);
+        damaged << "not a run list";
+    }
+    reopen(store, true, "after a rebuild from a damaged list");
+    std::remove(INDEX_PATH);
+    reopen(store, true, "after a rebuild from a missing list");
+    reopen(store, false, "after reopening a rebuilt index");
+
+    // Without a path the index lives in memory and is fed through a BlockSource
+    ChainIndex memory(1);
+    BlockSource blocks = [&store](size_t height) { return store.view(height); };
+    for (size_t end = 0; end < store.size();) {
+        end = std::min(store.size(), end + 37);
+        if (!memory.catchUp(blocks, end)) {
+            fail("in-memory catch up to " + std::to_string(end));
+        }
+    }
+    check(memory.view(), store, store.size(), "in memory");
+
+    std::cout << store.size() << " blocks, " << next << " transactions, " << failures << " mismatches\n";
+    IndexRuns::removeFiles(INDEX_PATH);
+    std::system((std::string("rm -rf ") + directory).c_str());
+    return failures == 0 ? 0 : 1;
+}
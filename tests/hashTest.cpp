@@ -0,0 +1,146 @@
+// hashTest.cpp
+// Differential check of the packed hash engine against the original string based
+// algorithm: HashUtils::hash, incremental HashState updates, processHashBatch and the
+// difficulty checks, with the batch kernels run both as selected (AVX2 where the CPU has
+// it) and forced to the portable scalar kernel. Exits non-zero on the first mismatches.
+#include <iostream>
+#include <algorithm>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+#include "hash.h"
+
+namespace {
+
+const int MAX_DIFFICULTY_BITS = 12;
+const size_t RANDOM_INPUTS = 1500;
+const size_t MAX_REPORTED = 10;
+
+size_t failures = 0;
+
+void fail(const std::string& what, const std::string& input) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << " for input of length " << input.size() << ": \"" << input.substr(0, 80)
+                  << (input.size() > 80 ? "...\"" : "\"") << "\n";
+    }
+}
+
+// Random text over the characters the algorithm treats specially: upper case, '!',
+// digits, spaces (word boundaries) and the rest of printable ASCII
+std::string randomInput(std::mt19937_64& random, size_t length) {
+    static const std::string special = "AZaz09 !!  Xx";
+    std::string input(length, ' ');
+    for (char& c : input) {
+        c = (random() % 4 == 0) ? special[random() % special.size()] : static_cast<char>(32 + random() % 95);
+    }
+    return input;
+}
+
+std::vector<std::string> makeInputs() {
+    std::mt19937_64 random(20240601);
+    std::vector<std::string> inputs = {"", "a", "!", "A", " ", "0", "blockchain", std::string(64, 'a')};
+    // Lengths around the 64-character head, the 64-character tail window and word boundaries
+    for (size_t length : {1, 2, 7, 8, 9, 31, 32, 33, 62, 63, 64, 65, 66, 99, 100, 101, 127, 128, 129,
+                          191, 192, 193, 255, 256, 257, 1000, 1023, 1024, 1025, 4096}) {
+        inputs.push_back(randomInput(random, length));
+        inputs.push_back(std::string(length, 'x'));
+    }
+    for (size_t i = 0; i < RANDOM_INPUTS; ++i) {
+        inputs.push_back(randomInput(random, random() % 300));
+    }
+    // Header-shaped inputs, where the difficulty checks actually pass now and then
+    std::string prefix(64, '0');
+    for (uint64_t nonce = 0; nonce < 300; ++nonce) {
+        inputs.push_back(prefix + "1760000000" + prefix + std::to_string(nonce) + "1");
+    }
+    return inputs;
+}
+
+void checkKernel(const std::vector<std::string>& inputs, const std::vector<Digest>& expected) {
+    const std::string kernel = HashUtils::batchKernelName();
+    std::vector<Digest> batch = HashUtils::processHashBatch(inputs);
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (batch[i] != expected[i]) {
+            fail(kernel + " processHashBatch", inputs[i]);
+        }
+    }
+
+    // Odd batch sizes leave some lanes empty
+    for (size_t count = 1; count <= 17; ++count) {
+        std::vector<HashState> states(count);
+        std::vector<Digest> digests(count);
+        for (size_t k = 0; k < count; ++k) {
+            states[k].update(inputs[count * 7 + k]);
+        }
+        HashUtils::processHashBatch(states.data(), count, digests.data());
+        for (size_t k = 0; k < count; ++k) {
+            if (digests[k] != expected[count * 7 + k]) {
+                fail(kernel + " processHashBatch of " + std::to_string(count), inputs[count * 7 + k]);
+            }
+        }
+    }
+
+    std::vector<HashState> states(inputs.size());
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        states[i].update(inputs[i]);
+    }
+    std::unique_ptr<bool[]> results(new bool[inputs.size()]);
+    for (int bits = 0; bits <= MAX_DIFFICULTY_BITS; ++bits) {
+        HashUtils::meetsDifficultyBatch(states.data(), states.size(), bits, results.get());
+        for (size_t i = 0; i < inputs.size(); ++i) {
+            if (results[i] != (expected[i].leadingZeroBits() >= bits)) {
+                fail(kernel + " meetsDifficultyBatch at " + std::to_string(bits) + " bits", inputs[i]);
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main() {
+    std::vector<std::string> inputs = makeInputs();
+    std::vector<Digest> expected;
+    expected.reserve(inputs.size());
+    for (const auto& input : inputs) {
+        expected.push_back(Digest::fromHex(HashUtils::processHashInputReference(input)));
+        if (expected.back().toHex() != HashUtils::processHashInputReference(input)) {
+            fail("reference digest round trip", input);
+        }
+    }
+
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        const std::string& input = inputs[i];
+        if (HashUtils::hash(input) != expected[i] || HashUtils::processHashInput(input) != expected[i].toHex()) {
+            fail("hash", input);
+        }
+        // The same input fed in uneven pieces
+        HashState state;
+        for (size_t at = 0, piece = 1; at < input.size(); at += piece, piece = piece * 3 % 17 + 1) {
+            state.update(input.data() + at, std::min(piece, input.size() - at));
+        }
+        if (state.finalize() != expected[i]) {
+            fail("incremental HashState", input);
+        }
+        for (int bits = 0; bits <= MAX_DIFFICULTY_BITS; ++bits) {
+            if (state.meetsDifficulty(bits) != (expected[i].leadingZeroBits() >= bits)) {
+                fail("meetsDifficulty at " + std::to_string(bits) + " bits", input);
+            }
+        }
+    }
+
+    std::string kernels = HashUtils::batchKernelName();
+    checkKernel(inputs, expected);
+    HashUtils::setScalarBatchKernel(true);
+    kernels += kernels == HashUtils::batchKernelName() ? "" : std::string(" and ") + HashUtils::batchKernelName();
+    checkKernel(inputs, expected);
+    HashUtils::setScalarBatchKernel(false);
+
+    size_t passing = 0;
+    for (const auto& digest : expected) {
+        passing += digest.leadingZeroBits() >= 4;
+    }
+    std::cout << inputs.size() << " inputs (" << passing << " with 4+ leading zero bits), " << kernels
+              << " batch kernels, " << failures << " mismatches\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,131 @@
+// merkleTest.cpp
+// Checks the flat-buffer MerkleTree against a plain level-by-level fold over hashPair,
+// for leaf counts around every power of two and past the size where levels are built
+// in parallel, and verifies an inclusion proof for every leaf. Exits non-zero on any
+// mismatch. Proofs are not checked against the wrong leaf: the pair hash is not collision
+// resistant, so a few of those would verify anyway.
+// MerkleAccumulator must give the tree's root after every append, both from empty and
+// when picked up from an already built tree.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "merkleRootHash.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+const uint64_t SEED = 20240606;
+const size_t MAX_REPORTED = 10;
+
+size_t failures = 0;
+
+void fail(const std::string& what, size_t leaves) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << " with " << leaves << " leaves\n";
+    }
+}
+
+std::vector<Digest> randomLeaves(size_t count) {
+    CounterRng rng(SEED, count);
+    std::vector<Digest> leaves(count);
+    for (auto& leaf : leaves) {
+        for (size_t i = 0; i < leaf.bytes.size(); i += 8) {
+            uint64_t word = rng.next();
+            for (size_t k = 0; k < 8; ++k) {
+                leaf.bytes[i + k] = static_cast<uint8_t>(word >> (8 * k));
+            }
+        }
+    }
+    return leaves;
+}
+
+// The original algorithm: pair up each level, an odd last node with itself
+Digest referenceRoot(std::vector<Digest> level) {
+    if (level.empty()) {
+        return MerkleTree::emptyRoot();
+    }
+    while (level.size() > 1) {
+        std::vector<Digest> parents;
+        for (size_t i = 0; i < level.size(); i += 2) {
+            parents.push_back(MerkleTree::hashPair(level[i], i + 1 < level.size() ? level[i + 1] : level[i]));
+        }
+        level.swap(parents);
+    }
+    return level[0];
+}
+
+std::vector<size_t> leafCounts() {
+    std::vector<size_t> counts;
+    for (size_t count = 0; count <= 70; ++count) {
+        counts.push_back(count);
+    }
+    // Levels with PARALLEL_PAIRS (512) or more pairs are hashed on several threads
+    for (size_t count : {127, 128, 129, 1023, 1024, 1025, 1027, 4099}) {
+        counts.push_back(count);
+    }
+    return counts;
+}
+
+} // namespace
+
+// Roots of every prefix of `leaves`, from the accumulator and from a fresh tree
+void checkAccumulator(const std::vector<Digest>& leaves) {
+    MerkleAccumulator accumulator;
+    if (accumulator.root() != MerkleTree::emptyRoot()) {
+        fail("empty accumulator root", 0);
+    }
+    for (size_t count = 1; count <= leaves.size(); ++count) {
+        accumulator.append(leaves[count - 1]);
+        std::vector<Digest> prefix(leaves.begin(), leaves.begin() + count);
+        if (accumulator.root() != referenceRoot(prefix) || accumulator.size() != count) {
+            fail("accumulator root", count);
+        }
+    }
+}
+
+// A template that starts from a built tree and keeps growing
+void checkAccumulatorFromTree(const std::vector<Digest>& leaves, size_t built) {
+    MerkleAccumulator accumulator = MerkleAccumulator::fromTree(
+        MerkleTree(std::vector<Digest>(leaves.begin(), leaves.begin() + built)));
+    for (size_t count = built; count <= leaves.size(); ++count) {
+        if (count > built) {
+            accumulator.append(leaves[count - 1]);
+        }
+        if (accumulator.root() != MerkleTree(std::vector<Digest>(leaves.begin(), leaves.begin() + count)).root()) {
+            fail("accumulator from a tree of " + std::to_string(built) + " leaves", count);
+        }
+    }
+}
+
+int main() {
+    size_t proofs = 0;
+    for (size_t count : leafCounts()) {
+        std::vector<Digest> leaves = randomLeaves(count);
+        MerkleTree tree(leaves);
+        Digest root = referenceRoot(leaves);
+        if (tree.root() != root || tree.size() != count) {
+            fail("root", count);
+            continue;
+        }
+        for (size_t i = 0; i < count; ++i) {
+            MerkleTree::Proof proof = tree.proof(i);
+            ++proofs;
+            if (!MerkleTree::verifyProof(root, leaves[i], proof) || proof.size() + 1 != tree.levelCount()) {
+                fail("proof of leaf " + std::to_string(i), count);
+            }
+        }
+        if (!tree.proof(count).empty()) {
+            fail("proof past the last leaf", count);
+        }
+    }
+
+    std::vector<Digest> leaves = randomLeaves(300);
+    checkAccumulator(leaves);
+    for (size_t built : {0, 1, 2, 3, 7, 8, 33, 64, 100}) {
+        checkAccumulatorFromTree(std::vector<Digest>(leaves.begin(), leaves.begin() + 140), built);
+    }
+
+    std::cout << leafCounts().size() << " tree sizes, " << proofs << " proofs, " << leaves.size()
+              << " accumulator appends, " << failures << " mismatches\n";
+    return failures == 0 ? 0 : 1;
+}
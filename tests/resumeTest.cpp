@@ -0,0 +1,92 @@
+// resumeTest.cpp
+// Mines one seed's workload into a fresh store, then resumes the same run twice the way
+// main does (generate the workload, verify the stored chain, open the chain index, mine
+// what is left). Every transaction ID on the final chain must be unique and the chain
+// must still verify.
+#include <iostream>
+#include <cstdlib>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <unistd.h>
+#include "mainFunctions.h"
+
+namespace {
+
+const uint64_t SEED = 42;
+const int USERS = 60;
+const int TRANSACTIONS = 2000;
+const int RUNS = 3;
+
+// One run of main's mining mode against blockchain.dat in the current directory
+bool mineRun(int run) {
+    WorkloadGenerator generator(SEED);
+    std::vector<User> users = generateUsers(USERS, generator);
+    // Drawn from the initial balances, as in main, so every run streams the same workload
+    const std::vector<User> createdUsers = users;
+    TransactionSource transactions = [&](const WorkloadGenerator::TransactionConsumer& consumer) {
+        generateTransactions(TRANSACTIONS, createdUsers, generator, consumer);
+    };
+    BlockStore store;
+    if (!store.open("blockchain.dat")) {
+        std::cout << "run " << run << ": could not open blockchain.dat\n";
+        return false;
+    }
+    AccountSnapshots snapshots("accounts", 10);
+    if (store.size() > 0 && !verifyStoredChain(store, users, "blockchain.checkpoint", &snapshots)) {
+        std::cout << "run " << run << ": stored chain did not verify\n";
+        return false;
+    }
+    ChainIndex chainIndex;
+    if (!chainIndex.open("blockchain.lookup", store)) {
+        std::cout << "run " << run << ": could not open blockchain.lookup\n";
+        return false;
+    }
+    snapshots.start();
+    mineBlockchain(transactions, users, 100, &store, &chainIndex, nullptr, &snapshots, nullptr, nullptr,
+                   "blockchain.checkpoint");
+    snapshots.stop();
+    chainIndex.close();
+    return true;
+}
+
+} // namespace
+
+int main() {
+    char directory[] = "/tmp/resume_test.XXXXXX";
+    if (mkdtemp(directory) == nullptr || chdir(directory) != 0) {
+        std::cout << "could not create a scratch directory\n";
+        return 1;
+    }
+
+    for (int run = 0; run < RUNS; ++run) {
+        if (!mineRun(run)) {
+            return 1;
+        }
+    }
+
+    BlockStore store;
+    if (!store.open("blockchain.dat")) {
+        std::cout << "could not reopen blockchain.dat\n";
+        return 1;
+    }
+    std::unordered_set<Digest, DigestHasher> seen;
+    size_t transactions = 0, duplicates = 0;
+    for (size_t height = 0; height < store.size(); ++height) {
+        BlockView block = store.view(height);
+        for (size_t t = 0; t < block.transactionCount(); ++t) {
+            ++transactions;
+            duplicates += !seen.insert(block.transaction(t).transactionID).second;
+        }
+    }
+    WorkloadGenerator generator(SEED);
+    std::vector<User> users = generateUsers(USERS, generator);
+    // A checkpoint of its own, so the whole chain is checked rather than the blocks after
+    // the miner's last checkpoint
+    bool valid = verifyStoredChain(store, users, "final.checkpoint");
+
+    std::cout << RUNS << " runs, " << store.size() << " blocks, " << transactions << " transactions, " << duplicates
+              << " duplicate IDs, chain " << (valid ? "verifies" : "does not verify") << "\n";
+    std::system((std::string("rm -rf ") + directory).c_str());
+    return duplicates == 0 && valid ? 0 : 1;
+}
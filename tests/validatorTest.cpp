@@ -0,0 +1,132 @@
+// validatorTest.cpp
+// Checks BlockValidator against the serial loop it replaces: IDs re-derived one by one
+// with HashUtils::hash, then every transaction applied in block order. Blocks come from
+// the workload generator over few and many accounts, so waves range from long conflict
+// chains to wide independent sets. They are salted with forged IDs, unknown accounts and
+// overdrafts. Accepted flags, rejection counts and every final balance must match the
+// serial pass at each thread count. Exits non-zero on any mismatch.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "blockValidator.h"
+#include "hash.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+const uint64_t SEED = 1010;
+const size_t MAX_REPORTED = 10;
+
+size_t failures = 0;
+
+void fail(const std::string& what) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << "\n";
+    }
+}
+
+std::vector<Transaction> makeBlock(const std::vector<User>& users, size_t count) {
+    std::vector<Transaction> transactions;
+    WorkloadGenerator(SEED).generateTransactions(users, count, [&](std::vector<Transaction>& chunk) {
+        transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+    });
+    CounterRng rng(SEED, users.size());
+    Digest stranger = HashUtils::hash("not an account");
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        const Transaction& t = transactions[i];
+        switch (rng.below(20)) {
+        case 0: // Forged ID
+            transactions[i] = Transaction(HashUtils::hash(std::to_string(i)), t.getSenderPublicKey(),
+                                          t.getReceiverPublicKey(), t.getAmount());
+            break;
+        case 1: // Unknown sender, with a matching ID
+            transactions[i] = Transaction(HashUtils::hash(stranger.toHex() + t.getReceiverPublicKey().toHex() +
+                                                          std::to_string(t.getAmount())),
+                                          stranger, t.getReceiverPublicKey(), t.getAmount());
+            break;
+        case 2: // More than anyone holds
+            transactions[i] = Transaction(HashUtils::hash(t.getSenderPublicKey().toHex() +
+                                                          t.getReceiverPublicKey().toHex() + "100000000"),
+                                          t.getSenderPublicKey(), t.getReceiverPublicKey(), 100000000);
+            break;
+        default:
+            break;
+        }
+    }
+    return transactions;
+}
+
+// The original validation: one transaction after another
+BlockValidator::Result serialApply(const std::vector<Transaction>& transactions, AccountState& accounts) {
+    BlockValidator::Result result;
+    result.accepted.assign(transactions.size(), 0);
+    for (size_t i = 0; i < transactions.size(); ++i) {
+        const Transaction& t = transactions[i];
+        std::string input = t.getSenderPublicKey().toHex() + t.getReceiverPublicKey().toHex() +
+                            std::to_string(t.getAmount());
+        if (HashUtils::hash(input) != t.getTransactionID()) {
+            result.invalidIds++;
+            continue;
+        }
+        int64_t sender = accounts.findAccount(t.getSenderPublicKey());
+        int64_t receiver = accounts.findAccount(t.getReceiverPublicKey());
+        if (sender == AccountState::NOT_FOUND || receiver == AccountState::NOT_FOUND) {
+            result.unknownAccounts++;
+            continue;
+        }
+        if (accounts.getBalance(sender) < t.getAmount()) {
+            result.insufficientBalance++;
+            continue;
+        }
+        accounts.updateBalance(sender, -t.getAmount());
+        accounts.updateBalance(receiver, t.getAmount());
+        result.accepted[i] = 1;
+    }
+    return result;
+}
+
+void compare(size_t users, int threads, const BlockValidator::Result& expected, const AccountState& expectedAccounts,
+             const BlockValidator::Result& actual, const AccountState& actualAccounts) {
+    std::string run = std::to_string(users) + " users, " + std::to_string(threads) + " threads: ";
+    if (actual.accepted != expected.accepted) {
+        fail(run + "accepted transactions");
+    }
+    if (actual.invalidIds != expected.invalidIds || actual.unknownAccounts != expected.unknownAccounts ||
+        actual.insufficientBalance != expected.insufficientBalance) {
+        fail(run + "rejection counts");
+    }
+    if (actualAccounts.getBalances() != expectedAccounts.getBalances()) {
+        fail(run + "balances");
+    }
+}
+
+} // namespace
+
+int main() {
+    size_t blocks = 0, waves = 0;
+    for (size_t userCount : {2, 5, 40, 3000}) {
+        std::vector<User> users = WorkloadGenerator(SEED).generateUsers(userCount);
+        std::vector<Transaction> transactions = makeBlock(users, 5000);
+
+        AccountState expectedAccounts = AccountState::fromUsers(users);
+        BlockValidator::Result expected = serialApply(transactions, expectedAccounts);
+
+        for (int threads : {1, 2, 8}) {
+            BlockValidator validator(threads);
+            AccountState accounts = AccountState::fromUsers(users);
+            std::vector<char> idValid = validator.verifyTransactionIds(transactions);
+            BlockValidator::Result result = validator.applyTransactions(transactions, accounts, &idValid);
+            compare(userCount, threads, expected, expectedAccounts, result, accounts);
+
+            Block block(Digest(), transactions, 1);
+            AccountState blockAccounts = AccountState::fromUsers(users);
+            compare(userCount, threads, expected, expectedAccounts, validator.validateBlock(block, blockAccounts),
+                    blockAccounts);
+            ++blocks;
+            waves += result.waves;
+        }
+    }
+
+    std::cout << blocks << " blocks validated in " << waves << " waves, " << failures << " mismatches\n";
+    return failures == 0 ? 0 : 1;
+}
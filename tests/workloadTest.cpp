@@ -0,0 +1,107 @@
+// workloadTest.cpp
+// The workload for a seed must not depend on how it is produced: users and transactions
+// generated at several thread counts and chunk sizes are compared field by field with a
+// single-threaded run in one chunk. Every transaction ID must also be the hash of its
+// sender, receiver and amount. Exits non-zero on any mismatch.
+#include <iostream>
+#include <string>
+#include <vector>
+#include "hash.h"
+#include "workloadGenerator.h"
+
+namespace {
+
+const uint64_t SEED = 1414;
+const size_t USERS = 500;
+const size_t TRANSACTIONS = 20000;
+const size_t MAX_REPORTED = 10;
+
+size_t failures = 0;
+
+void fail(const std::string& what) {
+    if (++failures <= MAX_REPORTED) {
+        std::cout << "MISMATCH " << what << "\n";
+    }
+}
+
+bool sameUsers(const std::vector<User>& a, const std::vector<User>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].getName() != b[i].getName() || a[i].getPublicKey() != b[i].getPublicKey() ||
+            a[i].getBalance() != b[i].getBalance()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sameTransactions(const std::vector<Transaction>& a, const std::vector<Transaction>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i].getTransactionID() != b[i].getTransactionID() ||
+            a[i].getSenderPublicKey() != b[i].getSenderPublicKey() ||
+            a[i].getReceiverPublicKey() != b[i].getReceiverPublicKey() || a[i].getAmount() != b[i].getAmount()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::vector<Transaction> generate(const WorkloadGenerator& generator, const std::vector<User>& users, size_t chunkSize,
+                                  size_t& chunks) {
+    std::vector<Transaction> transactions;
+    chunks = 0;
+    generator.generateTransactions(users, TRANSACTIONS, [&](std::vector<Transaction>& chunk) {
+        transactions.insert(transactions.end(), chunk.begin(), chunk.end());
+        ++chunks;
+    }, chunkSize);
+    return transactions;
+}
+
+} // namespace
+
+int main() {
+    WorkloadGenerator reference(SEED, 1);
+    std::vector<User> users = reference.generateUsers(USERS);
+    size_t chunks = 0;
+    std::vector<Transaction> transactions = generate(reference, users, TRANSACTIONS, chunks);
+
+    if (transactions.size() != TRANSACTIONS) {
+        fail("transaction count");
+    }
+    for (const auto& t : transactions) {
+        std::string input = t.getSenderPublicKey().toHex() + t.getReceiverPublicKey().toHex() +
+                            std::to_string(t.getAmount());
+        if (HashUtils::hash(input) != t.getTransactionID() || t.getSenderPublicKey() == t.getReceiverPublicKey()) {
+            fail("transaction " + t.getTransactionID().toHex());
+        }
+    }
+
+    size_t runs = 0;
+    for (int threads : {1, 2, 3, 8}) {
+        WorkloadGenerator generator(SEED, threads);
+        if (!sameUsers(generator.generateUsers(USERS), users)) {
+            fail("users at " + std::to_string(threads) + " threads");
+        }
+        for (size_t chunkSize : {size_t(8), size_t(777), size_t(4096), WorkloadGenerator::DEFAULT_CHUNK}) {
+            size_t expectedChunks = (TRANSACTIONS + chunkSize - 1) / chunkSize;
+            if (!sameTransactions(generate(generator, users, chunkSize, chunks), transactions) ||
+                chunks != expectedChunks) {
+                fail("transactions at " + std::to_string(threads) + " threads in chunks of " +
+                     std::to_string(chunkSize));
+            }
+            ++runs;
+        }
+    }
+    if (sameUsers(WorkloadGenerator(SEED + 1).generateUsers(USERS), users)) {
+        fail("another seed gave the same users");
+    }
+
+    std::cout << runs << " runs of " << TRANSACTIONS << " transactions over " << USERS << " users, " << failures
+              << " mismatches\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -1,25 +1,32 @@
 #ifndef TRANSACTION_H
 #define TRANSACTION_H
 
-#include <string>
+#include <type_traits>
+#include "digest.h"
 
+// IDs and keys are held as 32-byte digests; hex is only produced when printing or
+// hashing. The class is trivially copyable, so vectors of transactions are one
+// contiguous allocation and can be copied with memcpy.
 class Transaction {
 private:
-    std::string transactionID;
-    std::string senderPublicKey;
-    std::string receiverPublicKey;
+    Digest transactionID;
+    Digest senderPublicKey;
+    Digest receiverPublicKey;
     int amount;
 
 public:
-    Transaction(const std::string& transactionID, const std::string& senderPublicKey,
-                const std::string& receiverPublicKey, int amount);
-    std::string getTransactionID() const;
-    std::string getSenderPublicKey() const;
-    std::string getReceiverPublicKey() const;
+    Transaction() : amount(0) {}
+    Transaction(const Digest& transactionID, const Digest& senderPublicKey,
+                const Digest& receiverPublicKey, int amount);
+    const Digest& getTransactionID() const { return transactionID; }
+    const Digest& getSenderPublicKey() const { return senderPublicKey; }
+    const Digest& getReceiverPublicKey() const { return receiverPublicKey; }
      bool operator==(const Transaction& other) const {
         return this->getTransactionID() == other.getTransactionID();
     }
     int getAmount() const;
 };
 
+static_assert(std::is_trivially_copyable<Transaction>::value, "Transaction must stay trivially copyable");
+
 #endif // TRANSACTION_H
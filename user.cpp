@@ -1,9 +1,9 @@
 #include "user.h"
 
-User::User(const std::string& name, const std::string& publicKey, int balance)
+User::User(const std::string& name, const Digest& publicKey, int64_t balance)
     : name(name), publicKey(publicKey), balance(balance) {}
 
-std::string User::getName() const { return name; }
-std::string User::getPublicKey() const { return publicKey; }
-int User::getBalance() const { return balance; }
-void User::updateBalance(int amount) { balance += amount; }
\ No newline at end of file
+const std::string& User::getName() const { return name; }
+const Digest& User::getPublicKey() const { return publicKey; }
+int64_t User::getBalance() const { return balance; }
+void User::updateBalance(int64_t amount) { balance += amount; }
@@ -2,20 +2,22 @@
 #define USER_H
 
 #include <string>
+#include <cstdint>
+#include "digest.h"
 
 class User {
 private:
     std::string name;
-    std::string publicKey;
-    int balance;
+    Digest publicKey;
+    int64_t balance; // Same width as AccountState balances, so copying them back never narrows
 
 public:
-    User(const std::string& name, const std::string& publicKey, int balance);
+    User(const std::string& name, const Digest& publicKey, int64_t balance);
 
-    std::string getName() const;
-    std::string getPublicKey() const;
-    int getBalance() const;
-    void updateBalance(int amount); // This method should exist
+    const std::string& getName() const;
+    const Digest& getPublicKey() const;
+    int64_t getBalance() const;
+    void updateBalance(int64_t amount); // This method should exist
 };
 
 #endif // USER_H
@@ -0,0 +1,99 @@
+#include "workloadGenerator.h"
+#include "hash.h"
+#include <algorithm>
+#include <string>
+#include <limits>
+#include <omp.h>
+
+namespace {
+
+// Inputs handed to the multi-buffer hash at a time
+const size_t HASH_BATCH = 8;
+
+} // namespace
+
+WorkloadGenerator::WorkloadGenerator(uint64_t seed, int threadCount)
+    : seed(seed), threadCount(threadCount > 0 ? threadCount : omp_get_max_threads()) {}
+
+std::vector<User> WorkloadGenerator::generateUsers(size_t userNumber) const {
+    std::vector<User> users(userNumber, User("", Digest(), 0));
+    long batches = static_cast<long>((userNumber + HASH_BATCH - 1) / HASH_BATCH);
+
+    #pragma omp parallel for schedule(static) num_threads(threadCount)
+    for (long b = 0; b < batches; ++b) {
+        size_t first = static_cast<size_t>(b) * HASH_BATCH;
+        size_t count = std::min(HASH_BATCH, userNumber - first);
+        std::string names[HASH_BATCH];
+        HashState states[HASH_BATCH];
+        Digest keys[HASH_BATCH];
+        for (size_t k = 0; k < count; ++k) {
+            names[k] = "User" + std::to_string(first + k + 1);
+            states[k] = HashState();
+            states[k].update(names[k]);
+        }
+        HashUtils::processHashBatch(states, count, keys);
+        for (size_t k = 0; k < count; ++k) {
+            CounterRng rng(seed, USER_STREAM | (first + k));
+            int balance = static_cast<int>(rng.below(1000000)) + 100; // Random initial balance
+            users[first + k] = User(names[k], keys[k], balance);
+        }
+    }
+    return users;
+}
+
+void WorkloadGenerator::generateTransactions(const std::vector<User>& users, size_t transactionNumber,
+                                             const TransactionConsumer& consumer, size_t chunkSize) const {
+    // Transaction IDs hash the hex form of both keys, so each key is formatted once here
+    std::vector<std::string> keys(users.size());
+    std::vector<int64_t> balances(users.size());
+    std::vector<size_t> senders; // Users that can send (balance of at least 100)
+    for (size_t i = 0; i < users.size(); ++i) {
+        keys[i] = users[i].getPublicKey().toHex();
+        balances[i] = users[i].getBalance();
+        if (balances[i] >= 100) {
+            senders.push_back(i);
+        }
+    }
+    if (senders.empty() || users.size() < 2) {
+        return;
+    }
+    chunkSize = std::max<size_t>(chunkSize, HASH_BATCH);
+
+    std::vector<Transaction> chunk;
+    for (size_t base = 0; base < transactionNumber; base += chunkSize) {
+        size_t count = std::min(chunkSize, transactionNumber - base);
+        chunk.assign(count, Transaction());
+        long batches = static_cast<long>((count + HASH_BATCH - 1) / HASH_BATCH);
+
+        #pragma omp parallel for schedule(static) num_threads(threadCount)
+        for (long b = 0; b < batches; ++b) {
+            size_t first = static_cast<size_t>(b) * HASH_BATCH;
+            size_t lanes = std::min(HASH_BATCH, count - first);
+            size_t sender[HASH_BATCH], receiver[HASH_BATCH];
+            int amount[HASH_BATCH];
+            HashState states[HASH_BATCH];
+            Digest ids[HASH_BATCH];
+            for (size_t k = 0; k < lanes; ++k) {
+                CounterRng rng(seed, TRANSACTION_STREAM | (base + first + k));
+                sender[k] = senders[rng.below(senders.size())];
+                receiver[k] = rng.below(users.size() - 1);
+                if (receiver[k] >= sender[k]) {
+                    receiver[k]++; // Anyone but the sender
+                }
+                // Amounts stay ints, so very rich senders are capped at INT_MAX per transaction
+                int64_t limit = std::min<int64_t>(balances[sender[k]] - 1, std::numeric_limits<int>::max());
+                amount[k] = static_cast<int>(rng.below(static_cast<uint64_t>(limit))) + 1;
+                states[k] = HashState();
+                states[k].update(keys[sender[k]]);
+                states[k].update(keys[receiver[k]]);
+                states[k].update(std::to_string(amount[k]));
+            }
+            HashUtils::processHashBatch(states, lanes, ids);
+            for (size_t k = 0; k < lanes; ++k) {
+                chunk[first + k] = Transaction(ids[k], users[sender[k]].getPublicKey(),
+                                               users[receiver[k]].getPublicKey(), amount[k]);
+            }
+        }
+        consumer(chunk);
+    }
+}
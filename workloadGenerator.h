@@ -0,0 +1,72 @@
+#ifndef WORKLOADGENERATOR_H
+#define WORKLOADGENERATOR_H
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+#include "user.h"
+#include "transactions.h"
+
+// Counter-based random numbers: every value is a pure function of (seed, stream,
+// counter), run through the splitmix64 finalizer. Each generated item owns a stream, so
+// items can be produced in any order on any thread and still come out the same.
+class CounterRng {
+public:
+    CounterRng(uint64_t seed, uint64_t stream) : key(mix(seed ^ mix(stream + GOLDEN))), counter(0) {}
+
+    uint64_t next() { return mix(key + (++counter) * GOLDEN); }
+
+    // Uniform in [0, bound) by multiply-shift; the bias is below bound / 2^64
+    uint64_t below(uint64_t bound) {
+        return static_cast<uint64_t>((static_cast<unsigned __int128>(next()) * bound) >> 64);
+    }
+
+private:
+    static const uint64_t GOLDEN = 0x9E3779B97F4A7C15ULL;
+
+    uint64_t key;
+    uint64_t counter;
+
+    static uint64_t mix(uint64_t x) {
+        x ^= x >> 30;
+        x *= 0xBF58476D1CE4E5B9ULL;
+        x ^= x >> 27;
+        x *= 0x94D049BB133111EBULL;
+        x ^= x >> 31;
+        return x;
+    }
+};
+
+// Seeded, reproducible users and transactions.
+//
+// User i and transaction i draw only from their own CounterRng stream, so the output
+// for a seed does not depend on the thread count or on the chunk size. Transactions are
+// produced chunk by chunk: the chunk's fields are drawn in parallel, its IDs hashed in
+// parallel 8-lane batches, and the chunk handed to the consumer before the next one is
+// built, so memory stays bounded by the chunk size.
+class WorkloadGenerator {
+public:
+    typedef std::function<void(std::vector<Transaction>& chunk)> TransactionConsumer;
+
+    static const size_t DEFAULT_CHUNK = 65536;
+
+    explicit WorkloadGenerator(uint64_t seed, int threadCount = 0); // 0 uses all available OpenMP threads
+
+    std::vector<User> generateUsers(size_t userNumber) const;
+
+    // Senders are drawn from users with a balance of at least 100, receivers from everyone
+    // else; the amount is in [1, sender balance - 1]
+    void generateTransactions(const std::vector<User>& users, size_t transactionNumber,
+                              const TransactionConsumer& consumer, size_t chunkSize = DEFAULT_CHUNK) const;
+
+    uint64_t getSeed() const { return seed; }
+
+private:
+    static const uint64_t USER_STREAM = 1ULL << 62;
+    static const uint64_t TRANSACTION_STREAM = 2ULL << 62;
+
+    uint64_t seed;
+    int threadCount;
+};
+
+#endif // WORKLOADGENERATOR_H